@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <cstring>
 
@@ -6,6 +7,7 @@
 #include "kickcat/Prints.h"
 #include "kickcat/SocketNull.h"
 #include "kickcat/Gateway.h"
+#include "kickcat/Scheduler.h"
 
 #ifdef __linux__
     #include "kickcat/OS/Linux/Socket.h"
@@ -102,6 +104,27 @@ int main(int argc, char* argv[])
     Gateway gateway(socket, std::bind(&Bus::addGatewayMessage, &bus, _1, _2, _3));
 
     auto callback_error = [](DatagramState const&){ THROW_ERROR("something bad happened"); };
+
+    // mailboxes are checked then exchanged on alternate cycles: one datagram per slave for each operation
+    int32_t const checks_budget = 2 * static_cast<int32_t>(bus.slaves().size()) * datagram_size(1);
+    int32_t messages_budget = 0;
+    for (auto const& slave : bus.slaves())
+    {
+        messages_budget += datagram_size(slave.mailbox.recv_size) + datagram_size(slave.mailbox.send_size);
+    }
+
+    Scheduler scheduler(bus, std::max(checks_budget, messages_budget));
+    scheduler.addTask(2, checks_budget, [&bus](Scheduler::Error const& error)
+    {
+        bus.sendMailboxesReadChecks(error);
+        bus.sendMailboxesWriteChecks(error);
+    });
+    scheduler.addTask(2, messages_budget, [&bus](Scheduler::Error const& error)
+    {
+        bus.sendReadMessages(error);
+        bus.sendWriteMessages(error);
+    }, 1);
+
     constexpr int64_t LOOP_NUMBER = 12 * 3600 * 1000; // 12h
     for (int64_t i = 0; i < LOOP_NUMBER; ++i)
     {
@@ -109,19 +132,7 @@ int main(int argc, char* argv[])
 
         try
         {
-            if (i % 2)
-            {
-                bus.sendMailboxesReadChecks(callback_error);
-                bus.sendMailboxesWriteChecks(callback_error);
-            }
-            else
-            {
-                bus.sendReadMessages(callback_error);
-                bus.sendWriteMessages(callback_error);
-            }
-            bus.finalizeDatagrams();
-
-            bus.processAwaitingFrames();
+            scheduler.cycle(callback_error);
         }
         catch (std::exception const& e)
         {
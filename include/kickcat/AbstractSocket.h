@@ -21,6 +21,9 @@ namespace kickcat
         virtual void close() noexcept = 0;
         virtual int32_t read(uint8_t* frame, int32_t frame_size) = 0;
         virtual int32_t write(uint8_t const* frame, int32_t frame_size) = 0;
+
+        /// \return a file descriptor that becomes readable when a frame is received, -1 if the socket has none
+        virtual int fd() const { return -1; }
     };
 }
 
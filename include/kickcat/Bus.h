@@ -7,10 +7,12 @@
 #include <vector>
 #include <functional>
 
+#include "Diagnostics.h"
 #include "Error.h"
 #include "Frame.h"
 #include "Link.h"
 #include "Slave.h"
+#include "TripleBuffer.h"
 
 namespace kickcat
 {
@@ -26,6 +28,15 @@ namespace kickcat
         void configureWaitLatency(nanoseconds tiny, nanoseconds big)
         { tiny_wait = tiny; big_wait = big; }
 
+        // Define how blocking mailbox calls (i.e. readSDO()/writeSDO()) wait for their answer
+        enum class MessageWaitMode
+        {
+            POLLING,        // check then exchange all slaves mailboxes in separate round trips, sleep tiny_wait between each loop
+            EVENT_DRIVEN    // write, read and check the slave mailbox in one frame, retry at once while the slave is answering
+                            // and back off (up to tiny_wait) only while the mailbox stays empty
+        };
+        void configureMessageWait(MessageWaitMode mode) { message_wait_mode_ = mode; }
+
         // set the bus from an unknown state to PREOP state
         // 0ms disables the watchdog
         void init(nanoseconds watchdog = 100ms);
@@ -46,7 +57,39 @@ namespace kickcat
         // background_task may be used to keep updated PDO while waiting for a particular state.
         void waitForState(State request, nanoseconds timeout, std::function<void()> background_task = [](){});
 
+        // Define how createMapping() lays out the process image
+        enum class MappingLayout
+        {
+            BYTE_ALIGNED,   // every slave mapping starts on a byte, client buffer holds inputs then outputs of each slave
+            BIT_PACKED      // slaves with less than 8 bits share bytes (FMMU bit granularity). Client buffer mirrors the frames:
+                            // inputs image then outputs image (2x the frames size). Use Slave::PIMapping bit accessors.
+        };
+        void configureMappingLayout(MappingLayout layout) { mapping_layout_ = layout; }
+
+        // Define how createMapping() distributes the slaves mappings in the frames of each addressing group
+        enum class FramePacking
+        {
+            IN_ORDER,       // slaves fill the frames in bus order, a slave that does not fit starts a new frame
+            FIRST_FIT       // biggest slaves first, each one in the first frame with enough room: minimize frames count and padding
+        };
+        enum class ProcessDataAreas
+        {
+            SHARED,         // inputs and outputs of a slave overlap in one area exchanged with LRW (smallest frames)
+            SPLIT           // inputs and outputs in distinct areas exchanged with LRD and LWR
+        };
+        void configureFramePacking(FramePacking packing, ProcessDataAreas areas = ProcessDataAreas::SHARED)
+        { frame_packing_ = packing; process_data_areas_ = areas; }
+
+        /// \return predicted wire time of the cyclic frames (process data and drift compensation), valid after createMapping()
+        nanoseconds predictedWireTime() const;
+
+        /// \brief   Validate a cycle time before commissioning (cf. estimateCycleTime())
+        /// \param   acyclic   data size of the acyclic datagrams sent each cycle on top of the cyclic ones (i.e. mailboxes checks)
+        CycleTimeEstimate estimateCycleTime(nanoseconds cycle, std::vector<uint16_t> const& acyclic = {}, CycleTimeModel const& model = {});
+
         // create the mapping between slaves PI and client buffer
+        // each addressing group (cf. Slave::group) gets its own logical address range and frames
+        // each latency priority (cf. Slave::priority) gets its own frames, highest priority first
         // if OK, set the bus to SAFE_OP state
         void createMapping(uint8_t* iomap);
 
@@ -60,6 +103,35 @@ namespace kickcat
         void sendLogicalRead(std::function<void(DatagramState const&)> const& error);
         void sendLogicalWrite(std::function<void(DatagramState const&)> const& error);
         void sendLogicalReadWrite(std::function<void(DatagramState const&)> const& error);
+
+        // Exchange the process data of one addressing group only (cf. Slave::group): groups may be exchanged at different rates.
+        void sendLogicalRead     (int32_t group, std::function<void(DatagramState const&)> const& error);
+        void sendLogicalWrite    (int32_t group, std::function<void(DatagramState const&)> const& error);
+        void sendLogicalReadWrite(int32_t group, std::function<void(DatagramState const&)> const& error);
+
+        /// \brief   Call a handler as soon as the inputs of a slave are received
+        /// \details The handler runs while the frames are processed (processDataRead/ReadWrite(), processAwaitingFrames()),
+        ///          right after the frame holding the slave inputs is decoded with a valid working counter: slaves of the first
+        ///          frames of a multi-frame cycle are serviced before the last frame is received. With redundancy, it runs
+        ///          once both copies of the frame are in. It shall be short. An exception it throws is held until the frames
+        ///          are processed, then rethrown by the method processing them. An empty handler removes it.
+        void setInputsHandler(Slave& slave, std::function<void(Slave&)> handler);
+
+        /// \brief   Stage the outputs of an addressing group (to call after createMapping())
+        /// \details A control thread writes the outputs of the group in stagedOutputs(), then publishes them all at once
+        ///          with commitOutputs(), without lock. The cycle picks the last commit up when it sends the outputs of the
+        ///          group: the outputs written in one control step always go out in the same cycle. From then on, each
+        ///          new commit overwrites the client buffer outputs of the group.
+        void stageOutputs(int32_t group);
+
+        /// \return staging area of the slave outputs (same layout as Slave::output.data, bit_offset included),
+        ///         valid until the next commitOutputs() of its group. To use from the control thread only.
+        uint8_t* stagedOutputs(Slave& slave);
+
+        /// \brief  Publish the staged outputs of a group, picked up by the next cycle
+        /// \return generation of the published outputs
+        uint64_t commitOutputs(int32_t group);
+
         void sendMailboxesReadChecks (std::function<void(DatagramState const&)> const& error);  // Fetch in  mailboxes states (full/empty) of compatible slaves
         void sendMailboxesWriteChecks(std::function<void(DatagramState const&)> const& error);  // Fetch out mailboxes states (full/empty) of compatible slaves
         void sendNop(std::function<void(DatagramState const&)> const& error);                   // Send a NOP datagram
@@ -72,6 +144,21 @@ namespace kickcat
 
         // helpers around start/finalize operations
         void finalizeDatagrams(); // send a frame if there is awaiting datagram inside
+        int32_t frameFreeSpace() const { return link_->freeSpace(Link::Domain::CYCLIC); } // bytes left in the process data frame being built
+
+        /// \brief   Add the datagrams of every domain in the process data frames for the lifetime of the scope
+        /// \details Acyclic helpers (mailboxes, diagnostics) then fill the space left in the cyclic frames, domains
+        ///          configured or not (cf. Scheduler).
+        class CyclicFramesScope
+        {
+        public:
+            CyclicFramesScope(Bus& bus)
+                : merge_{*bus.link_, Link::Domain::CYCLIC}
+            { }
+
+        private:
+            Link::MergeScope merge_;
+        };
         void processDataRead(std::function<void(DatagramState const&)> const& error);
         void processDataWrite(std::function<void(DatagramState const&)> const& error);
         void processDataReadWrite(std::function<void(DatagramState const&)> const& error);
@@ -92,6 +179,38 @@ namespace kickcat
         void readSDO (Slave& slave, uint16_t index, uint8_t subindex, Access CA, void* data, uint32_t* data_size, nanoseconds timeout = 1s);
         void writeSDO(Slave& slave, uint16_t index, uint8_t subindex, bool CA,   void* data, uint32_t  data_size, nanoseconds timeout = 1s);
 
+        // Streaming SDO access: the object is consumed/provided chunk by chunk through the callback instead of one contiguous buffer.
+        // Objects bigger than the mailbox are transferred with segments: timeout applies to the whole transfer.
+        void readSDO (Slave& slave, uint16_t index, uint8_t subindex, bool CA, SDOReader const& reader, nanoseconds timeout = 1s);
+        void writeSDO(Slave& slave, uint16_t index, uint8_t subindex, bool CA, uint32_t size, SDOWriter const& writer, nanoseconds timeout = 1s);
+
+        /// \brief   Asynchronous SDO access: the request is queued in the slave mailbox and the call returns immediately.
+        /// \details The request is processed by the cyclic loop (checkMailboxes()/processMessages() or their send* counterparts)
+        ///          and the callback is called from it when the SDO is finalized: check message status() to know the result.
+        ///          Without answer after timeout, the loop (processMessages() or the send*Messages() helpers) finalizes the SDO
+        ///          with a TIMEOUT status.
+        ///          data and data_size shall stay valid until the callback is called. Complete access cannot be emulated.
+        /// \return  A handle on the message
+        std::shared_ptr<AbstractMessage> readSDOAsync (Slave& slave, uint16_t index, uint8_t subindex, Access CA, void* data, uint32_t* data_size,
+                                                       std::function<void(AbstractMessage const&)> const& callback, nanoseconds timeout = 1s);
+        std::shared_ptr<AbstractMessage> writeSDOAsync(Slave& slave, uint16_t index, uint8_t subindex, bool CA,   void* data, uint32_t* data_size,
+                                                       std::function<void(AbstractMessage const&)> const& callback, nanoseconds timeout = 1s);
+
+        /// \brief   File access over EtherCAT: the file is streamed from/to the client callbacks, packets fill the whole mailbox.
+        /// \details Asynchronous versions enable to transfer files to several slaves in parallel: see waitForMessages().
+        ///          Timeout applies to the whole transfer.
+        void readFoE (Slave& slave, std::string_view filename, uint32_t password, FoEReader const& reader, nanoseconds timeout = 60s);
+        void writeFoE(Slave& slave, std::string_view filename, uint32_t password, uint32_t size, FoEWriter const& writer, nanoseconds timeout = 60s);
+        std::shared_ptr<AbstractMessage> readFoEAsync (Slave& slave, std::string_view filename, uint32_t password, FoEReader const& reader,
+                                                       std::function<void(AbstractMessage const&)> const& callback);
+        std::shared_ptr<AbstractMessage> writeFoEAsync(Slave& slave, std::string_view filename, uint32_t password, uint32_t size, FoEWriter const& writer,
+                                                       std::function<void(AbstractMessage const&)> const& callback);
+
+        /// \brief   Process the mailboxes of all slaves until every message is finalized
+        /// \details Messages of different slaves are exchanged in the same frames: it is the way to run transfers in parallel.
+        ///          Check each message status() to know the result.
+        void waitForMessages(std::vector<std::shared_ptr<AbstractMessage>> const& messages, nanoseconds timeout);
+
         /// \brief  Add a gateway message to the bus
         /// \param  raw_message         A raw EtherCAT mailbox message
         /// \param  raw_message_size    Size of the mailbox message (shall be less or equal of the actual storage size)
@@ -101,6 +220,28 @@ namespace kickcat
 
         void clearErrorCounters();
 
+        /// \brief   Initialize the distributed clocks (to call after init())
+        /// \details Latch the ports receive times, compute the propagation delays from the topology, write the system time
+        ///          offsets and delays, then run the static drift compensation: the reference clock (first DC slave) system
+        ///          time is distributed to the other slaves drift_frames times.
+        void initDistributedClocks(int32_t drift_frames = 15000);
+
+        /// \brief   Configure and start SYNC0/SYNC1 signals of a DC slave
+        /// \param   sync0_cycle SYNC0 period
+        /// \param   sync1_cycle Delay of SYNC1 pulses after SYNC0 ones, 0 to disable SYNC1
+        /// \param   shift       Shift of the SYNC0 pulses from the cycle start
+        void configureSync(Slave& slave, nanoseconds sync0_cycle, nanoseconds sync1_cycle = 0ns, nanoseconds shift = 0ns);
+
+        /// \return the reference clock slave, nullptr if distributed clocks are not initialized
+        Slave* dcReference() { return dc_reference_; }
+
+        /// \brief   Distribute the reference clock system time to the other slaves (runtime drift compensation)
+        /// \details Once distributed clocks are initialized, processDataRead/Write/ReadWrite() add it in the cyclic frame.
+        void sendDriftCompensation(std::function<void(DatagramState const&)> const& error);
+
+        /// \return the reference clock system time read by the last drift compensation
+        uint64_t dcSystemTime() const { return dc_system_time_; }
+
 
     protected: // for unit testing
 
@@ -123,16 +264,41 @@ namespace kickcat
 
         // mapping helpers
         void detectMapping();
-        void readMappedPDO(Slave& slave, uint16_t index);
         void configureFMMUs();
 
+        // Non blocking upload of every entries of an object (subindex 0 excluded).
+        // It enables to browse several slaves at once with one SDO in flight per slave (i.e. detectMapping()).
+        // Complete access is used if the slave supports it, otherwise it is emulated subindex per subindex.
+        struct ObjectUpload
+        {
+            Slave* slave;
+            uint16_t index;
+            bool complete_access;
+            uint32_t entries;                       // number of entries of the object (subindex 0 value)
+            uint8_t subindex;                       // subindex of the SDO in flight
+            uint8_t data[512];                      // entries read so far
+            uint32_t size;                          // size of the entries read so far
+            uint32_t chunk_size;                    // client data size of the SDO in flight
+            std::shared_ptr<AbstractMessage> sdo;   // SDO in flight
+            nanoseconds since;                      // start time of the SDO in flight
+        };
+        void startObjectUpload(ObjectUpload& upload, Slave& slave, uint16_t index, bool complete_access);
+        /// \return true if the upload is done, false if it is still running
+        bool processObjectUpload(ObjectUpload& upload, nanoseconds timeout);
+
         // Slave SII eeprom helpers
         void fetchEeprom();
         bool areEepromReady();
         void readEeprom(uint16_t address, std::vector<Slave*> const& slaves, std::function<void(Slave&, uint32_t word)> apply);
 
         // mailbox helpers
-        void waitForMessage(std::shared_ptr<AbstractMessage> message, nanoseconds timeout);
+        void waitForMessage(Slave& slave, std::shared_ptr<AbstractMessage> message, nanoseconds timeout);
+        void checkMessagesTimeouts(); // finalize the messages past their deadline
+
+        /// \brief   Exchange messages with one slave in a single frame: write next message, read the answer, check the mailbox state
+        /// \details A write on a full mailbox or a read on an empty one is ignored by the slave (working counter is not incremented)
+        /// \return  true if something was exchanged or if the slave has another message to read, false otherwise
+        bool exchangeMessages(Slave& slave, std::function<void(DatagramState const&)> const& error);
 
         std::shared_ptr<Link> link_;
         std::vector<Slave> slaves_;
@@ -152,13 +318,55 @@ namespace kickcat
         {
             uint32_t address;               // logical address
             int32_t size;                   // frame size
+            int32_t group;                  // addressing group of the slaves in this frame
+            int32_t priority;               // latency priority of the slaves in this frame
             std::vector<blockIO> inputs;    // slave to master
             std::vector<blockIO> outputs;
         };
         std::vector<PIFrame> pi_frames_; // PI frame description
 
+        // lay out the mappings of the slaves of a group and a priority in new frames starting at next_frame logical address
+        void layoutFrames(int32_t group, int32_t priority, uint32_t& next_frame, bool map_inputs, bool map_outputs);
+
+        // data size of the datagrams sent each cycle by processDataReadWrite()
+        std::vector<uint16_t> cyclicDatagrams() const;
+
+        struct OutputStage
+        {
+            int32_t group;
+            std::vector<std::size_t> frames;        // index in pi_frames_ of the frames holding outputs of the group
+            std::vector<uint32_t> offsets;          // offset of each of these frames in the staging buffers
+            std::unique_ptr<TripleBuffer> buffer;
+        };
+        std::vector<OutputStage> output_stages_;
+        OutputStage& outputStage(int32_t group);
+        void pickStagedOutputs(OutputStage& stage); // copy the last committed outputs of a group in the client buffer
+        void pickStagedOutputs(int32_t group);
+
+        // copy the inputs of a received frame in the client buffer, then call the inputs handlers of its slaves
+        void readInputs(PIFrame const& pi_frame, uint8_t const* data);
+        std::vector<std::function<void(Slave&)>> inputs_handlers_; // per slave, in slaves_ order
+        std::exception_ptr inputs_handler_error_;                   // first exception thrown by an inputs handler
+        void rethrowInputsHandlerError();
+
+        // send the frame being built when moving to a lower priority PI frame (priority: the one of the previous PI frame)
+        void finalizeHigherPriority(PIFrame const& pi_frame, int32_t& priority);
+
+        void sendLogicalRead     (PIFrame const& pi_frame, std::function<void(DatagramState const&)> const& error);
+        void sendLogicalWrite    (PIFrame const& pi_frame, std::function<void(DatagramState const&)> const& error);
+        void sendLogicalReadWrite(PIFrame const& pi_frame, std::function<void(DatagramState const&)> const& error);
+
+        static constexpr nanoseconds OBJECT_UPLOAD_TIMEOUT = 1s; // per SDO of an object upload (i.e. detectMapping())
+
         nanoseconds tiny_wait{200us};
         nanoseconds big_wait{10ms};
+        MessageWaitMode message_wait_mode_{MessageWaitMode::POLLING};
+        MappingLayout mapping_layout_{MappingLayout::BYTE_ALIGNED};
+        FramePacking frame_packing_{FramePacking::IN_ORDER};
+        ProcessDataAreas process_data_areas_{ProcessDataAreas::SHARED};
+
+        Slave* dc_reference_{nullptr};  // reference clock, first DC slave
+        uint64_t dc_system_time_{0};
     };
 }
 
@@ -0,0 +1,51 @@
+#ifndef KICKCAT_DC_H
+#define KICKCAT_DC_H
+
+#include <cstdint>
+
+#include "Time.h"
+
+namespace kickcat
+{
+    // EtherCAT system time starts on 2000-01-01, master time (since_epoch()) on 1970-01-01
+    constexpr nanoseconds DC_EPOCH_OFFSET = 946684800s;
+
+    /// \brief   Steer the master cycle on the distributed clocks reference
+    /// \details PI controller that keeps the cyclic frames reaching the reference slave a fixed time before SYNC0:
+    ///          feed it every cycle with the reference system time carried back by the drift compensation datagram
+    ///          (see Bus::sendDriftCompensation()) and add the returned correction to the next master wake-up period.
+    class MasterClockSteering
+    {
+    public:
+        /// \param cycle    Master cycle (shall be the SYNC0 cycle)
+        /// \param shift    SYNC0 shift used to configure the slaves (see Bus::configureSync())
+        /// \param lead     Requested time between the frame arrival on the reference slave and the next SYNC0 pulse
+        MasterClockSteering(nanoseconds cycle, nanoseconds shift, nanoseconds lead, double kp = 0.1, double ki = 0.005);
+
+        /// \param  reference_time  Reference slave system time when the frame went through it (EtherCAT epoch)
+        /// \param  master_time     Master time of the same cycle (i.e. since_epoch() when the frame was processed, 1970 epoch)
+        /// \return correction to add to the next cycle period
+        nanoseconds update(uint64_t reference_time, nanoseconds master_time);
+
+        nanoseconds offset() const     { return nanoseconds(offset_); }            // last master to DC time offset (both on the EtherCAT epoch)
+        nanoseconds jitter() const;                                                // standard deviation of the offset variation per cycle
+        nanoseconds phaseError() const { return nanoseconds(phase_error_); }       // last frame arrival error, positive if late
+
+    private:
+        int64_t cycle_;
+        int64_t shift_;
+        int64_t lead_;
+        double kp_;
+        double ki_;
+
+        double integral_{0};
+        int64_t phase_error_{0};
+
+        int64_t offset_{0};
+        double variation_mean_{0};
+        double variation_variance_{0};
+        int64_t samples_{0};
+    };
+}
+
+#endif
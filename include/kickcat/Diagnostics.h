@@ -1,6 +1,7 @@
 #ifndef KICKCAT_DIAGNOSTICS_H
 #define KICKCAT_DIAGNOSTICS_H
 
+#include "Frame.h"
 #include "Slave.h"
 
 #include <unordered_map>
@@ -11,6 +12,35 @@ namespace kickcat
     /// \brief return the topology of discovered network - To be called after bus.getDLStatus()
     /// \return [key, value] pair : [slave adress, parent address] (the only slave that is its own parent is linked to the master) 
     std::unordered_map<uint16_t, uint16_t> getTopology(std::vector<Slave>& slaves);
+
+    /// \brief   Compute the propagation delay of each DC slave from the first one (the reference clock)
+    /// \details Based on the topology and on the ports receive times latched in slave.dc. The frame goes through ports in
+    ///          0 -> 3 -> 1 -> 2 order: the time spent by a parent in the branch of a child minus the time spent inside the
+    ///          child branch is twice the delay between them. Slaves without DC latch nothing: they get the delay of
+    ///          their parent, and the DC slaves behind them are measured from the closest DC ancestor.
+    void computePropagationDelays(std::vector<Slave>& slaves);
+
+    struct CycleTimeModel
+    {
+        nanoseconds port_delay{500ns};      // time for a frame to go through one slave port (processing or forwarding)
+        nanoseconds cable_delay{50ns};      // propagation time of one link (~10m)
+        nanoseconds master_overhead{50us};  // time kept free each cycle for the master (wake-up jitter, processing)
+    };
+
+    struct CycleTimeEstimate
+    {
+        WireUsage wire;             // frames sent each cycle
+        nanoseconds propagation;    // time for a frame to go through every slave and come back
+        nanoseconds minimum_cycle;  // wire time + propagation + master overhead
+        nanoseconds headroom;       // cycle - minimum cycle: negative if the cycle is not feasible
+    };
+
+    /// \brief   Predict the time needed to exchange the datagrams of a cycle - To be called after bus.getDLStatus()
+    /// \details Frames are sent back to back: the last one is received after the wire time of all of them plus the time
+    ///          to go through the bus. A frame goes through each slave once per open port and through each link twice.
+    /// \param   datagrams_data_size   data size of each datagram sent in a cycle (cyclic and acyclic ones)
+    CycleTimeEstimate estimateCycleTime(std::vector<uint16_t> const& datagrams_data_size, std::vector<Slave>& slaves,
+                                        nanoseconds cycle, CycleTimeModel const& model = {});
 }
 
 #endif
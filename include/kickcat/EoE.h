@@ -0,0 +1,49 @@
+#ifndef KICKCAT_EOE_H
+#define KICKCAT_EOE_H
+
+#include <memory>
+
+#include "AbstractSocket.h"
+#include "Mailbox.h"
+
+namespace kickcat
+{
+    /// \brief   Bridge Ethernet frames between a local network interface (i.e. a TAP device) and the EoE service of a slave
+    /// \details Frames read on the interface are queued in the slave mailbox within a bandwidth budget. They are sent by the
+    ///          cyclic mailbox processing (i.e. Bus::sendWriteMessages()): at most one fragment per slave and per cycle,
+    ///          in the frames already used by the cyclic exchange, so the tunnel never delays it.
+    ///          Frames received from the slave are written back on the interface as soon as they are reassembled.
+    class EoEBridge
+    {
+    public:
+        /// \param interface    Local network interface. Its read() shall not block (i.e. TapSocket with a null timeout)
+        /// \param mailbox      Mailbox of the EoE slave. It shall outlive the bridge.
+        EoEBridge(std::shared_ptr<AbstractSocket> interface, Mailbox& mailbox);
+        ~EoEBridge();
+
+        /// \brief   Bytes of Ethernet frames that may be queued in the slave mailbox per process() call (i.e. per cycle)
+        /// \details Unused budget is kept up to one maximal Ethernet frame: a frame bigger than the budget is delayed, not dropped.
+        void setBandwidthBudget(int32_t bytes_per_cycle) { budget_ = bytes_per_cycle; }
+
+        /// \brief Queue the frames waiting on the local interface in the slave mailbox (non blocking, to call once per cycle)
+        void process();
+
+        int32_t framesSent() const     { return frames_sent_;     }
+        int32_t framesReceived() const { return frames_received_; }
+
+    private:
+        std::shared_ptr<AbstractSocket> interface_;
+        Mailbox& mailbox_;
+
+        int32_t budget_{ETH_MAX_SIZE};
+        int32_t credit_{0};
+
+        EthernetFrame pending_;         // frame read on the interface, waiting for budget
+        int32_t pending_size_{0};
+
+        int32_t frames_sent_{0};
+        int32_t frames_received_{0};
+    };
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define KICKAT_FRAME_H
 
 #include <memory>
+#include <vector>
 
 #include "protocol.h"
 
@@ -22,8 +23,10 @@ namespace kickcat
 
         /// \brief Add a datagram in the frame
         /// \warning Doesn't check anything - max datagram nor max size!
+        /// \param irq IRQ field of the datagram header, echoed back by the slaves ORed with their unmasked ECAT event requests
         /// \return true if full after adding datagram, false otherwise
-        void addDatagram(uint8_t index, enum Command command, uint32_t address, void const* data, uint16_t data_size);
+        void addDatagram(uint8_t index, enum Command command, uint32_t address, void const* data, uint16_t data_size,
+                         uint16_t irq = 0);
 
         /// \brief   Reset the internal datagram pointers to beginning of the frame and be ready to read/write a new frame.
         /// \details This context is used to iterate through the datagrams in the frame.
@@ -74,6 +77,18 @@ namespace kickcat
         bool is_datagram_available_{false};
     };
 
+    struct WireUsage
+    {
+        int32_t frames;     // Ethernet frames
+        int32_t bytes;      // bytes on the wire, preamble and inter frame gap included
+        nanoseconds time;   // time to transmit them
+    };
+
+    /// \brief   Wire usage of datagrams sent in a row
+    /// \details Datagrams are packed in frames like Link does: up to the MTU and MAX_ETHERCAT_DATAGRAMS per frame.
+    /// \param   datagrams_data_size   data size of each datagram (headers excluded)
+    WireUsage computeWireUsage(std::vector<uint16_t> const& datagrams_data_size);
+
     int32_t readFrame(std::shared_ptr<AbstractSocket> socket, Frame& frame);
     int32_t writeFrame(std::shared_ptr<AbstractSocket> socket, Frame& frame, MAC const& src);
 }
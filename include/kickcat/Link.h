@@ -2,8 +2,10 @@
 #define KICKCAT_LINK_H
 
 #include <array>
+#include <deque>
 #include <memory>
 #include <functional>
+#include <vector>
 
 #include "KickCAT.h"
 #include "Frame.h"
@@ -12,6 +14,26 @@ namespace kickcat
 {
     class AbstractSocket;
 
+    /// \brief Round trip time estimator, as done for TCP retransmission timeout (RFC 6298)
+    /// \details The smoothed RTT and its mean deviation are exponentially weighted moving averages (gains of 1/8 and 1/4):
+    ///          the timeout is the smoothed RTT plus four times the deviation.
+    class RttEstimator
+    {
+    public:
+        void update(nanoseconds rtt);
+
+        nanoseconds srtt() const    { return srtt_; }
+        nanoseconds rttvar() const  { return rttvar_; }
+        nanoseconds timeout() const { return srtt_ + 4 * rttvar_; }
+        int64_t samples() const     { return samples_; }
+
+    private:
+        nanoseconds srtt_{0};
+        nanoseconds rttvar_{0};
+        int64_t samples_{0};
+    };
+
+
     class Link
     {
     public:
@@ -24,8 +46,15 @@ namespace kickcat
                        std::function<void(void)> const& redundancyActivatedCallback,
                        MAC const src_nominal = PRIMARY_IF_MAC,
                        MAC const src_redundancy = SECONDARY_IF_MAC);
+
+        /// \brief   Single interface link (no redundancy)
+        /// \details Frames are written and read on the nominal interface only: there is no second socket nor merge to handle.
+        Link(std::shared_ptr<AbstractSocket> socket_nominal, MAC const src_nominal = PRIMARY_IF_MAC);
         ~Link() = default;
 
+        /// \return true if the link was built with a redundancy interface
+        bool isRedundant() const { return is_redundant_; }
+
         /// \brief   Helper for trivial access (i.e. most of the init bus frames)
         ///
         /// \details Since this method is only used for non real time operation, the redundancy mechanism used is slower
@@ -43,50 +72,245 @@ namespace kickcat
             addDatagram(command, address, &data, sizeof(data), process, error);
         }
 
+        /// Independent transaction domains. Each domain has its own share of the 256 datagram indexes, its own frames and
+        /// is finalized, processed and timed out on its own: a slow mailbox exchange or a lost diagnostic frame never
+        /// delays nor fails the process data. Until configureDomains() is called, every domain uses the same shared space.
+        enum class Domain
+        {
+            CYCLIC,         // process data
+            MAILBOX,        // mailbox polling and messages
+            DIAGNOSTICS,    // error counters, link status
+            USER            // everything else (default)
+        };
+        static constexpr int32_t DOMAINS = 4;
+
+        /// \brief   Split the index space between the domains
+        /// \param   sizes   indexes of each domain, in Domain order (at least 2 per domain, 256 at most in total)
+        /// \details Shall be called while no datagram is in flight.
+        void configureDomains(std::array<int32_t, DOMAINS> const& sizes);
+
+        /// \brief Domain used by the next calls to addDatagram(), finalizeDatagrams(), processDatagrams(), poll(), completeBy() and freeSpace()
+        void setDomain(Domain domain) { domain_ = domain; }
+        Domain domain() const { return domain_; }
+
+        /// \brief Select a domain for the lifetime of the scope, then restore the previous one
+        class DomainScope
+        {
+        public:
+            DomainScope(Link& link, Domain domain)
+                : link_{link}
+                , previous_{link.domain()}
+            {
+                link_.setDomain(domain);
+            }
+            ~DomainScope()
+            {
+                link_.setDomain(previous_);
+            }
+
+        private:
+            Link& link_;
+            Domain previous_;
+        };
+
+        /// \brief   Route the datagrams of every domain to the frames of one domain for the lifetime of the scope
+        /// \details They share its indexes, transaction and timeout: i.e. acyclic datagrams fill the space left in the
+        ///          process data frames instead of opening frames of their own. The domain shall have enough indexes.
+        class MergeScope
+        {
+        public:
+            MergeScope(Link& link, Domain into)
+                : link_{link}
+                , previous_{link.domain_context_}
+            {
+                link_.domain_context_.fill(previous_[static_cast<int32_t>(into)]);
+            }
+            ~MergeScope()
+            {
+                link_.domain_context_ = previous_;
+            }
+
+        private:
+            Link& link_;
+            std::array<int32_t, DOMAINS> previous_;
+        };
+
         void finalizeDatagrams();
+
+        /// \brief Send the pending datagrams of every domain
+        void finalizeAllDatagrams();
+
+        /// \brief Process the datagrams of every domain (cyclic first), see processDatagrams()
+        void processAllDatagrams();
+
+        /// \brief Send pending datagrams, wait for their answers (each read is bounded by the timeout) and call the callbacks.
         void processDatagrams();
 
+        /// \brief   Non blocking progress: send pending datagrams if needed, then consume the frames already received.
+        /// \details The callbacks are called once every frame of the transaction is back. No datagram may be added
+        ///          until then.
+        /// \return  true when the transaction is complete (and the callbacks called), false if frames are still awaited
+        bool poll();
+
+        /// \brief   Wait for the current transaction until the deadline, then call the callbacks.
+        /// \details Datagrams still missing at the deadline are declared lost.
+        /// \return  true if every frame came back before the deadline
+        bool completeBy(nanoseconds deadline);
+
+        /// \return file descriptors to monitor (i.e. with epoll) to know when poll() has something to consume
+        std::vector<int> fds() const;
+
+        /// \return bytes that can still be added (datagram headers included) before the current frame is sent
+        int32_t freeSpace() const { return current().frame.freeSpace(); }
+        int32_t freeSpace(Domain domain) const { return contexts_[domain_context_[static_cast<int32_t>(domain)]].frame.freeSpace(); }
+
         void setTimeout(nanoseconds const& timeout) {timeout_ = timeout;};
 
+        /// Traffic classes with their own round trip time estimation
+        enum class TrafficClass
+        {
+            CYCLIC,     // transactions carrying process data (logical commands)
+            MAILBOX,    // other transactions: mailbox, state and diagnostic accesses
+            INIT        // writeThenRead() accesses used to bring the bus up
+        };
+
+        /// \brief   Derive read timeouts from the measured round trip time of each traffic class
+        /// \details The timeout given to setTimeout() is used until the first frame of a class has been measured,
+        ///          then the estimator timeout clamped in [min_timeout, max_timeout]. Reads are then bounded from the send
+        ///          time of the frames. When a transaction loses frames, the timeout of its class is doubled (up to
+        ///          max_timeout) until a frame of this class is measured again.
+        void enableAdaptiveTimeout(nanoseconds min_timeout, nanoseconds max_timeout);
+        void disableAdaptiveTimeout() { adaptive_timeout_ = false; }
+
+        /// \return the read timeout currently used for a traffic class
+        nanoseconds timeout(TrafficClass traffic) const;
+        RttEstimator const& rtt(TrafficClass traffic) const { return rtt_[static_cast<int32_t>(traffic)]; }
+
+        /// Reception statistics of the link.
+        /// With a closed ring, frames sent on one interface come back on the other one. When the ring is broken,
+        /// each side only reaches the slaves before the cut: the ratio of working counters collected on each side
+        /// locates the cut, and datagrams received on one side only tell which interface is isolated.
+        struct Statistics
+        {
+            int64_t frames_nominal{0};              // frames read on the nominal interface
+            int64_t frames_redundancy{0};           // frames read on the redundancy interface
+            int64_t frames_late{0};                 // late frames of a previous transaction, dropped
+            int64_t datagrams_merged{0};            // datagrams received on both interfaces
+            int64_t datagrams_nominal_only{0};      // datagrams received on the nominal interface only
+            int64_t datagrams_redundancy_only{0};   // datagrams received on the redundancy interface only
+            int64_t datagrams_lost{0};              // datagrams received on none of the interfaces
+            int64_t datagrams_mismatch{0};          // copies that could not be merged (duplicated or corrupted)
+        };
+        Statistics const& statistics() const { return statistics_; }
+
         void checkRedundancyNeeded();
     friend class LinkTest;
 
 
     private:
-        uint8_t index_queue_{0};
-        uint8_t index_head_{0};
-        uint8_t sent_frame_{0};
 
         struct Callbacks
         {
             DatagramState status{DatagramState::LOST};
             std::function<DatagramState(DatagramHeader const*, uint8_t const* data, uint16_t wkc)> process; // Shall not throw exception.
             std::function<void(DatagramState const& state)> error; // May throw exception.
+            uint32_t generation{0};     // transaction the datagram was sent in (its 16 low bits are sent in the IRQ field)
+            enum Command command{Command::NOP};
+            uint16_t size{0};
         };
         std::array<Callbacks, 256> callbacks_{};
 
 
-        void read() ;
-        void sendFrame() ;
-        bool isDatagramAvailable() ;
-        std::tuple<DatagramHeader const*, uint8_t*, uint16_t> nextDatagram() ;
-        void addDatagramToFrame(uint8_t index, enum Command command, uint32_t address, void const* data, uint16_t data_size) ;
-        void resetFrameContext() ;
+        enum class Side : uint8_t
+        {
+            NONE,
+            NOMINAL,
+            REDUNDANCY,
+            BOTH
+        };
+        enum class ReadStatus
+        {
+            NOTHING,    // no frame (timeout or error)
+            LATE,       // frame of a previous transaction, dropped
+            OTHER,      // frame of another domain, stored for it
+            CURRENT     // frame of the current transaction, stored
+        };
+
+        struct DomainContext
+        {
+            uint8_t first{0};           // indexes of the domain: [first, first + size[
+            int32_t size{256};
+            uint8_t queue{0};           // first datagram of the current transaction
+            uint8_t head{0};            // next index to use
+            uint32_t generation{1};     // current transaction, incremented when it ends
+
+            Frame frame{};              // frame being built
+            uint8_t sent_frame{0};      // frames sent since the beginning of the transaction
+            TrafficClass traffic{TrafficClass::MAILBOX};
+            nanoseconds sent_at{0ns};   // send time of the last frame (adaptive timeout only)
+
+            int32_t pending_frames{0};  // frames sent in the current transaction
+            std::array<int32_t, 3> received_frames{};  // frames of the current transaction received, per Side
+            std::deque<Frame> rx_frames{};     // frames of the current transaction, reused between cycles (stable addresses)
+            std::size_t rx_used{0};            // frames of rx_frames holding the current transaction
+            bool is_transaction_open{false};
+
+            uint8_t next(uint8_t index, int32_t n = 1) const; // index n datagrams after (or before if negative) in the domain
+        };
+
+        DomainContext& current() { return contexts_[domain_context_[static_cast<int32_t>(domain_)]]; }
+        DomainContext const& current() const { return contexts_[domain_context_[static_cast<int32_t>(domain_)]]; }
+        template<typename F> void forEachDomain(F apply); // apply on each distinct domain context, cyclic first
+
+        void beginTransaction(DomainContext& context);  // send pending datagrams and start to track their frames
+        void endTransaction(DomainContext& context);    // process the datagrams left, call the error callbacks
+        void parseFrame(Frame& frame, Side side, bool dispatch); // match by index and merge, process complete datagrams if dispatch
+        void processDatagram(uint8_t index);            // call the process callback of a received datagram
+        ReadStatus readSide(DomainContext& context, Side side, nanoseconds timeout);
+        bool isWaitingFor(DomainContext const& context, Side side) const; // true if frames are still awaited on this side
+        bool isCurrent(DatagramHeader const* header) const; // true if the datagram answers one of the current transaction
+        void sampleRtt(TrafficClass traffic, Frame& frame); // measure the round trip time of a received frame
+        void checkReadFrame(Frame& frame, int32_t written); // check a frame read back by writeThenRead()
+        void sendFrame(DomainContext& context);
+        void sendFrame() { sendFrame(current()); }
 
         std::function<void(void)> redundancyActivatedCallback_;
 
         std::shared_ptr<AbstractSocket> socket_nominal_;
         std::shared_ptr<AbstractSocket> socket_redundancy_;
 
-        Frame frame_nominal_{};
         MAC src_nominal_;
 
-        Frame frame_redundancy_{};
         MAC src_redundancy_;
 
+        struct Received
+        {
+            DatagramHeader const* header{nullptr};
+            uint8_t* data{nullptr};
+            uint16_t wkc{0};
+            Side side{Side::NONE};
+            bool processed{false};
+        };
+        std::array<Received, 256> received_{};
+
+        std::array<DomainContext, DOMAINS> contexts_{};
+        std::array<int32_t, DOMAINS> domain_context_{};     // context of each domain
+        std::array<uint8_t, 256> index_context_{};          // context owning each index
+        int32_t contexts_count_{1};
+        Domain domain_{Domain::USER};
+        Statistics statistics_{};
+
         bool is_redundancy_activated_{false};
+        bool is_redundant_{true};
 
         nanoseconds timeout_{2ms};
+
+        bool adaptive_timeout_{false};
+        nanoseconds min_timeout_{0ns};
+        nanoseconds max_timeout_{0ns};
+        std::array<RttEstimator, 3> rtt_{};
+        std::array<nanoseconds, 256> sent_at_{};        // send time of frames, indexed by their first datagram
+        std::array<nanoseconds, 3> backoff_{};          // timeout doubled after a loss, until the next measure (0: none)
     };
 }
 
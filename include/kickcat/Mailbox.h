@@ -1,11 +1,15 @@
 #ifndef KICKCAT_MAILBOX_H
 #define KICKCAT_MAILBOX_H
 
-#include <queue>
-#include <list>
+#include <deque>
+#include <array>
+#include <vector>
 #include <memory>
+#include <functional>
+#include <string_view>
 
 #include "protocol.h"
+#include "Time.h"
 
 namespace kickcat
 {
@@ -21,19 +25,101 @@ namespace kickcat
     {
         constexpr uint32_t SUCCESS                      = 0x000;
         constexpr uint32_t RUNNING                      = 0x001;
+        constexpr uint32_t TIMEOUT                      = 0x002;
+        constexpr uint32_t CANCELLED                    = 0x003;
 
         constexpr uint32_t COE_WRONG_SERVICE            = 0x101;
         constexpr uint32_t COE_UNKNOWN_SERVICE          = 0x102;
         constexpr uint32_t COE_CLIENT_BUFFER_TOO_SMALL  = 0x103;
         constexpr uint32_t COE_SEGMENT_BAD_TOGGLE_BIT   = 0x103;
+
+        constexpr uint32_t FOE_WRONG_SERVICE            = 0x201;
+        constexpr uint32_t FOE_WRONG_PACKET_NUMBER      = 0x202;
+        constexpr uint32_t FOE_CLIENT_BUFFER_TOO_SMALL  = 0x203;
     }
 
+    /// \brief Streaming SDO download: fill chunk with size bytes of the object, starting at offset
+    using SDOWriter = std::function<void(uint8_t* chunk, uint32_t offset, uint32_t size)>;
+
+    /// \brief  Streaming SDO upload: consume size bytes of the object (complete_size bytes long), starting at offset
+    /// \return false to stop the transfer (i.e. client buffer too small)
+    using SDOReader = std::function<bool(uint8_t const* chunk, uint32_t offset, uint32_t size, uint32_t complete_size)>;
+
+    /// \brief Streaming FoE write: fill chunk with size bytes of the file, starting at offset
+    using FoEWriter = std::function<void(uint8_t* chunk, uint32_t offset, uint32_t size)>;
+
+    /// \brief  Streaming FoE read: consume size bytes of the file, starting at offset (file size is unknown until the last packet)
+    /// \return false to stop the transfer (i.e. client buffer too small)
+    using FoEReader = std::function<bool(uint8_t const* chunk, uint32_t offset, uint32_t size)>;
+
+    /// \brief   Preallocated storage for messages data
+    /// \details Buffers are recycled from one message to another instead of being allocated for each message.
+    ///          The pool is shared by the messages so it outlives the mailbox if a client keeps a message handle.
+    ///          Message objects themselves are recycled too, through MessageAllocator.
+    class MessagePool
+    {
+    public:
+        MessagePool(uint16_t buffer_size, int32_t preallocated);
+        ~MessagePool();
+        MessagePool(MessagePool const&) = delete;
+        MessagePool& operator=(MessagePool const&) = delete;
+
+        /// \return a zeroed buffer of buffer_size() bytes - allocated only if the pool is exhausted
+        std::vector<uint8_t> acquire();
+        void release(std::vector<uint8_t>&& buffer);
+
+        /// \return storage for an object of size bytes - allocated only if the pool is exhausted or if the object is too big
+        void* allocateObject(std::size_t size);
+        void releaseObject(void* object, std::size_t size);
+
+        uint16_t bufferSize() const { return buffer_size_; }
+        int32_t available() const   { return static_cast<int32_t>(buffers_.size()); }
+
+    private:
+        static constexpr std::size_t OBJECT_BLOCK_SIZE = 512; // enough for any message and its shared_ptr control block
+
+        uint16_t buffer_size_;
+        std::vector<std::vector<uint8_t>> buffers_;
+        std::vector<void*> objects_;    // free object blocks
+    };
+
+    /// \brief Allocator taking messages (and their shared_ptr control block) from a MessagePool, for std::allocate_shared()
+    template<typename T>
+    class MessageAllocator
+    {
+    public:
+        using value_type = T;
+
+        MessageAllocator(std::shared_ptr<MessagePool> const& pool)
+            : pool_{pool}
+        { }
+
+        template<typename U>
+        MessageAllocator(MessageAllocator<U> const& other)
+            : pool_{other.pool()}
+        { }
+
+        T* allocate(std::size_t n)               { return static_cast<T*>(pool_->allocateObject(n * sizeof(T))); }
+        void deallocate(T* object, std::size_t n) { pool_->releaseObject(object, n * sizeof(T)); }
+
+        std::shared_ptr<MessagePool> const& pool() const { return pool_; }
+
+        template<typename U>
+        bool operator==(MessageAllocator<U> const& other) const { return pool_ == other.pool(); }
+        template<typename U>
+        bool operator!=(MessageAllocator<U> const& other) const { return pool_ != other.pool(); }
+
+    private:
+        std::shared_ptr<MessagePool> pool_; // the allocator copy kept by a control block keeps the pool alive
+    };
+
     class AbstractMessage
     {
     public:
         /// \param mailbox_size Size of the mailbox the message is targeted to (required to adapt internal buffer)
-        AbstractMessage(uint16_t mailbox_size);
-        virtual ~AbstractMessage() = default;
+        /// \param pool         Optional storage to take the message buffer from (and to give it back on destruction)
+        AbstractMessage(uint16_t mailbox_size, std::shared_ptr<MessagePool> const& pool = nullptr);
+        virtual ~AbstractMessage();
 
         // set message counter (aka session handle)
         void setCounter(uint8_t counter) { header_->count = counter & 0x7; }
@@ -44,6 +130,10 @@ namespace kickcat
         /// \return CONTINUE if the message is related and operation requiered another loop (message shall be push again in sending queue)
         virtual ProcessingResult process(uint8_t const* received) = 0;
 
+        /// \brief  Called once the message is written in the slave mailbox
+        /// \return true if an answer is expected, false if the message is finalized by the write itself (i.e. FoE last ACK)
+        virtual bool sent() { return true; }
+
         /// Handle address field. Address meaning depends on context (0 for local processing, slave address for gateway processing)
         void setAddress(uint16_t address) { header_->address = address; }
         uint16_t address() const { return header_->address; }
@@ -55,10 +145,48 @@ namespace kickcat
         uint8_t const* data() const { return data_.data(); }
         size_t size() const         { return data_.size(); }
 
+        /// \brief   Set a callback to be notified when the message is finalized
+        /// \details The callback is called from the mailbox reception path (i.e. Bus::processMessages()) once the status is
+        ///          not RUNNING anymore: it enables asynchronous processing driven by the cyclic loop.
+        void setCallback(std::function<void(AbstractMessage const&)> const& callback) { callback_ = callback; }
+
+        /// \brief Notify the client (if any) that the message is finalized
+        void notify() const
+        {
+            if (callback_)
+            {
+                callback_(*this);
+            }
+        }
+
+        /// \brief   Deadline after which the message is finalized with a TIMEOUT status by Mailbox::checkTimeouts()
+        /// \details 0 (default) for no deadline: blocking calls handle the timeout themselves.
+        void setDeadline(nanoseconds deadline) { deadline_ = deadline; }
+        nanoseconds deadline() const { return deadline_; }
+
+        /// \brief Key of the exchange the message waits an answer for (see Mailbox::receive())
+        void setSession(uint32_t session) { session_ = session; }
+        uint32_t session() const { return session_; }
+
+        /// \brief Finalize the message without waiting for its answer anymore
+        void cancel(uint32_t status)
+        {
+            status_ = status;
+            notify();
+        }
+
     protected:
         std::vector<uint8_t> data_;     // data of the message (send and gateway rec)
         mailbox::Header* header_;       // pointer on the mailbox header in data
         uint32_t status_;               // message current status
+        std::function<void(AbstractMessage const&)> callback_{}; // completion callback (optional)
+        std::shared_ptr<MessagePool> pool_; // data_ storage owner (optional)
+        nanoseconds deadline_{0ns};     // no deadline if 0
+        uint32_t session_{0};
+
+    private:
+        friend class PendingMessages;
+        std::shared_ptr<AbstractMessage> next_pending_{}; // next message waiting for the same session
     };
 
 
@@ -67,7 +195,8 @@ namespace kickcat
     class GatewayMessage : public AbstractMessage
     {
     public:
-        GatewayMessage(uint16_t mailbox_size, uint8_t const* raw_message, uint16_t gateway_index);
+        GatewayMessage(uint16_t mailbox_size, uint8_t const* raw_message, uint16_t gateway_index,
+                       std::shared_ptr<MessagePool> const& pool = nullptr);
         virtual ~GatewayMessage() = default;
 
         ProcessingResult process(uint8_t const* received) override;
@@ -79,6 +208,95 @@ namespace kickcat
     };
 
 
+    /// \brief   Messages sent and waiting for an answer, keyed by dispatch queue and session (see Mailbox::receive())
+    /// \details Preallocated open addressing table of FIFOs chained through the messages themselves: waiting for an answer
+    ///          or looking one up neither allocates nor walks the messages of other sessions.
+    class PendingMessages
+    {
+    public:
+        static constexpr int32_t CAPACITY_BITS = 6;
+        static constexpr int32_t CAPACITY = 1 << CAPACITY_BITS; // sessions waiting at once (one slot is always kept free)
+        static constexpr int32_t QUEUES = 17;   // dispatch queues (Mailbox::DISPATCH_QUEUES)
+
+        /// \brief Queue a message behind the ones waiting for the same session (message->session())
+        void push(int32_t queue, std::shared_ptr<AbstractMessage> const& message);
+
+        /// \return the oldest message waiting for this session, nullptr if none
+        std::shared_ptr<AbstractMessage> front(int32_t queue, uint32_t session) const;
+
+        /// \brief Remove the oldest message waiting for this session
+        void pop(int32_t queue, uint32_t session);
+
+        /// \brief Remove the messages matching the predicate, appended to removed
+        template<typename F>
+        void removeIf(F const& predicate, std::vector<std::shared_ptr<AbstractMessage>>& removed);
+
+        bool empty(int32_t queue) const   { return count_.at(queue) == 0; }
+        int32_t size(int32_t queue) const { return count_.at(queue); }
+        bool empty() const                { return used_ == 0; }
+        void clear();
+
+    private:
+        static constexpr int32_t MASK = CAPACITY - 1;
+
+        struct Slot
+        {
+            uint64_t key;                               // dispatch queue and session
+            std::shared_ptr<AbstractMessage> head;      // nullptr if the slot is free
+            AbstractMessage* tail;
+        };
+
+        static uint64_t key(int32_t queue, uint32_t session) { return (static_cast<uint64_t>(queue) << 32) | session; }
+        static int32_t home(uint64_t key); // preferred slot of a key
+        int32_t find(uint64_t key) const;  // slot of a key, -1 if not waiting
+        void erase(int32_t slot);          // free a slot, moving back the following ones of the probe sequence
+
+        std::array<Slot, CAPACITY> slots_{};
+        std::array<int32_t, QUEUES> count_{};
+        int32_t used_{0};
+    };
+
+    template<typename F>
+    void PendingMessages::removeIf(F const& predicate, std::vector<std::shared_ptr<AbstractMessage>>& removed)
+    {
+        int32_t i = 0;
+        while (i < CAPACITY)
+        {
+            Slot& slot = slots_[i];
+            if (slot.head == nullptr)
+            {
+                ++i;
+                continue;
+            }
+
+            // unlink the matching messages of the session, keeping the order of the other ones
+            int32_t const queue = static_cast<int32_t>(slot.key >> 32);
+            std::shared_ptr<AbstractMessage>* link = &slot.head;
+            slot.tail = nullptr;
+            while (*link != nullptr)
+            {
+                if (predicate(*link))
+                {
+                    std::shared_ptr<AbstractMessage> message = std::move(*link);
+                    *link = std::move(message->next_pending_);
+                    removed.push_back(std::move(message));
+                    --count_[queue];
+                    continue;
+                }
+                slot.tail = link->get();
+                link = &(*link)->next_pending_;
+            }
+
+            if (slot.head == nullptr)
+            {
+                erase(i); // a following slot may move here: check it again
+                continue;
+            }
+            ++i;
+        }
+    }
+
+
     struct Mailbox
     {
         uint16_t recv_offset;
@@ -96,30 +314,121 @@ namespace kickcat
 
         // messages factory
         std::shared_ptr<AbstractMessage> createSDO(uint16_t index, uint8_t subindex, bool CA, uint8_t request, void* data, uint32_t* data_size);
+        std::shared_ptr<AbstractMessage> createSDODownload(uint16_t index, uint8_t subindex, bool CA, uint32_t size, SDOWriter const& writer);
+        std::shared_ptr<AbstractMessage> createSDOUpload  (uint16_t index, uint8_t subindex, bool CA, SDOReader const& reader);
+        std::shared_ptr<AbstractMessage> createFoERead (std::string_view filename, uint32_t password, FoEReader const& reader);
+        std::shared_ptr<AbstractMessage> createFoEWrite(std::string_view filename, uint32_t password, uint32_t size, FoEWriter const& writer);
+        /// \brief   Queue an Ethernet frame for the slave EoE service: it is split in fragments that fill the mailbox
+        /// \details Fragments are queued apart from the other messages and only sent when no other message is waiting:
+        ///          a big frame does not delay SDO/FoE transfers.
+        /// \return  A handle on the last fragment: the frame is sent when it is finalized
+        std::shared_ptr<AbstractMessage> createEoE(uint8_t const* frame, int32_t frame_size);
         std::shared_ptr<GatewayMessage>  createGatewayMessage(uint8_t const* raw_message, int32_t raw_message_size, uint16_t gateway_index);
 
+        /// \return true if a message (or an EoE fragment) is waiting to be sent
+        bool hasMessageToSend() const { return (not to_send.empty()) or (not to_send_eoe.empty()); }
+
+        /// \brief   Next message to write in the slave mailbox
+        /// \details The choice holds until send(): a message queued in between does not replace the one being written.
+        std::shared_ptr<AbstractMessage> const& nextToSend();
+
         // helper to get next message to send and transfer it to reception callbacks if required
         std::shared_ptr<AbstractMessage> send();
 
+        /// \brief   Dispatch a received message to the message waiting for it
+        /// \details CoE emergencies are not requested by the master: they are directly stored in emergencies.
+        ///          Other messages are only matched against the messages of the same dispatch queue, by session (see session()).
+        /// \return  true if the message was processed, false otherwise
         bool receive(uint8_t const* raw_message);
-        std::queue<std::shared_ptr<AbstractMessage>> to_send;     // message waiting to be sent
-        std::list <std::shared_ptr<AbstractMessage>> to_process;  // message already sent, waiting for an answer
+
+        /// \brief Finalize with a TIMEOUT status the messages (sent or not) past their deadline: they are removed from the queues
+        void checkTimeouts(nanoseconds now);
+
+        /// \brief Finalize a message (sent or not) with the given status: it is removed from the queues and its answer ignored
+        void cancel(std::shared_ptr<AbstractMessage> const& message, uint32_t status = MessageStatus::CANCELLED);
+
+        // Dispatch queues: one per mailbox protocol type, plus one for gateway messages
+        // Note: the mailbox counter cannot be used as a key since slaves do not echo it in their answers
+        static constexpr int32_t GATEWAY_QUEUE = 16;
+        static constexpr int32_t DISPATCH_QUEUES = GATEWAY_QUEUE + 1;
+        static_assert(DISPATCH_QUEUES == PendingMessages::QUEUES, "one pending messages queue per dispatch queue");
+        static int32_t dispatchQueue(mailbox::Header const* header);
+
+        /// \brief   Session of a request or of an answer: an answer is dispatched to the message waiting with the same session
+        /// \details Gateway messages: the gateway index. SDO (except segments): index and subindex.
+        ///          Other messages (i.e. SDO segments, FoE) have ANY_SESSION: answers without a waiting session go to them.
+        static constexpr uint32_t ANY_SESSION = UINT32_MAX;
+        static uint32_t session(uint8_t const* raw_message, bool answer);
+
+        std::deque<std::shared_ptr<AbstractMessage>> to_send;     // message waiting to be sent
+        std::deque<std::shared_ptr<AbstractMessage>> to_send_eoe; // EoE fragments waiting to be sent, after to_send
+        PendingMessages to_process; // message already sent, waiting for an answer
 
         uint8_t nextCounter();
 
         std::vector<mailbox::Emergency> emergencies;
+
+        // EoE frames are not requested by the master: received fragments are reassembled then complete frames are forwarded here
+        std::function<void(uint8_t const* frame, int32_t frame_size)> eoe_handler{};
+
     private:
+        bool receiveEoE(uint8_t const* raw_message);
+        struct EoEReassembly
+        {
+            EthernetFrame frame;
+            int32_t size;               // data received so far
+            uint8_t frame_number;
+            uint8_t next_fragment;
+            bool in_progress;
+        };
+        EoEReassembly eoe_rx_{};
+        uint8_t eoe_frame_number_{0};
+
+        std::deque<std::shared_ptr<AbstractMessage>>* next_queue_{nullptr}; // queue of nextToSend(), until send()
+
+        template<typename F>
+        void cancelIf(F const& predicate, uint32_t status); // remove the matching messages from the queues, then finalize them
+
+        static constexpr int32_t PREALLOCATED_MESSAGES = 4;
+        std::shared_ptr<MessagePool> const& pool(); // messages storage, (re)created on mailbox size change
+
+        template<typename T, typename... Args>
+        std::shared_ptr<T> createMessage(Args&&... args)
+        {
+            std::shared_ptr<MessagePool> const& storage = pool();
+            return std::allocate_shared<T>(MessageAllocator<T>{storage}, recv_size, std::forward<Args>(args)..., storage);
+        }
+        std::shared_ptr<MessagePool> pool_{};
     };
 
     class SDOMessage : public AbstractMessage
     {
     public:
-        SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, uint8_t request, void* data, uint32_t* data_size);
+        SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, uint8_t request, void* data, uint32_t* data_size,
+                   std::shared_ptr<MessagePool> const& pool = nullptr);
+
+        /// \brief   Streaming constructors: data is provided/consumed chunk by chunk through the callback
+        /// \details Objects bigger than the mailbox are transferred with segments that fill the whole mailbox
+        SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, uint32_t size, SDOWriter const& writer,
+                   std::shared_ptr<MessagePool> const& pool = nullptr);
+        SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, SDOReader const& reader,
+                   std::shared_ptr<MessagePool> const& pool = nullptr);
         virtual ~SDOMessage() = default;
 
         ProcessingResult process(uint8_t const* received) override;
 
     protected:
+        static constexpr uint32_t SEGMENT_HEADER_SIZE = 3;  // CoE header + SDO command byte
+        static constexpr uint32_t MIN_SEGMENT_SIZE    = 7;  // smaller segments are padded
+
+        SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, uint8_t request, std::shared_ptr<MessagePool> const& pool);
+        void prepareDownload();
+        void prepareDownloadSegment();
+
+        /// \brief forward a chunk of the uploaded object to the client
+        /// \return false if the client refused it (status is updated)
+        bool consume(uint8_t const* chunk, uint32_t size);
+
         ProcessingResult processUpload           (mailbox::Header const* header, mailbox::ServiceData const* coe, uint8_t const* payload);
         ProcessingResult processUploadSegmented  (mailbox::Header const* header, mailbox::ServiceData const* coe, uint8_t const* payload);
         ProcessingResult processDownload         (mailbox::Header const* header, mailbox::ServiceData const* coe, uint8_t const* payload);
@@ -127,20 +436,69 @@ namespace kickcat
 
         mailbox::ServiceData* coe_;
         uint8_t* payload_;
-        uint8_t* client_data_;
-        uint32_t* client_data_size_;
+
+        SDOWriter writer_{};
+        SDOReader reader_{};
+        uint32_t complete_size_{0};     // size of the whole object
+        uint32_t offset_{0};            // size of the object already transferred
     };
 
-    class EmergencyMessage : public AbstractMessage
+
+    /// \brief   File access over EtherCAT (ETG 1000.6)
+    /// \details FoE is a stop and wait protocol: each data packet fills the whole mailbox and shall be acknowledged
+    ///          before the next one. Slaves are independent so transfers to several slaves can run in parallel.
+    class FoEMessage : public AbstractMessage
     {
     public:
-        EmergencyMessage(Mailbox& mailbox);
-        virtual ~EmergencyMessage() = default;
+        /// \brief Read a file from the slave
+        /// \param slave_mailbox_size  Size of the slave to master mailbox: a shorter data packet is the last one
+        FoEMessage(uint16_t mailbox_size, uint16_t slave_mailbox_size, std::string_view filename, uint32_t password,
+                   FoEReader const& reader, std::shared_ptr<MessagePool> const& pool = nullptr);
+
+        /// \brief Write a file of size bytes to the slave
+        FoEMessage(uint16_t mailbox_size, std::string_view filename, uint32_t password, uint32_t size,
+                   FoEWriter const& writer, std::shared_ptr<MessagePool> const& pool = nullptr);
+        virtual ~FoEMessage() = default;
 
         ProcessingResult process(uint8_t const* received) override;
+        bool sent() override;
 
-    private:
-        Mailbox& mailbox_;
+    protected:
+        FoEMessage(uint16_t mailbox_size, uint8_t opcode, std::string_view filename, uint32_t password, std::shared_ptr<MessagePool> const& pool);
+        ProcessingResult processRead (mailbox::Header const* header, FoE::Header const* foe, uint8_t const* payload);
+        ProcessingResult processWrite(FoE::Header const* foe);
+        void prepareAck();
+        void prepareData();
+
+        FoE::Header* foe_;
+        uint8_t* payload_;
+
+        FoEReader reader_{};
+        FoEWriter writer_{};
+        uint32_t max_packet_size_;      // data size of a full packet
+        uint32_t size_{0};              // file size (write)
+        uint32_t offset_{0};            // size of the file already transferred
+        uint32_t packet_{0};            // last packet number sent (write) or received (read)
+        bool last_packet_{false};       // the last packet was sent (write) or received (read)
+    };
+
+
+    /// \brief   One fragment of an Ethernet frame sent to the EoE service of a slave (ETG 1000.6)
+    /// \details The slave does not answer to fragments: the message is finalized once written in the slave mailbox.
+    class EoEMessage : public AbstractMessage
+    {
+    public:
+        /// \param offset           Offset of the fragment in the frame
+        /// \param fragment_size    Size of the fragment, shall be a multiple of EoE::FRAGMENT_BLOCK_SIZE except for the last one
+        EoEMessage(uint16_t mailbox_size, uint8_t const* frame, int32_t frame_size, int32_t offset, int32_t fragment_size,
+                   uint8_t frame_number, uint8_t fragment_number, std::shared_ptr<MessagePool> const& pool = nullptr);
+        virtual ~EoEMessage() = default;
+
+        ProcessingResult process(uint8_t const*) override { return ProcessingResult::NOOP; }
+        bool sent() override;
+
+        /// \return the biggest fragment size (multiple of EoE::FRAGMENT_BLOCK_SIZE) that a mailbox can hold
+        static int32_t maxFragmentSize(uint16_t mailbox_size);
     };
 }
 
@@ -0,0 +1,93 @@
+#ifndef KICKAT_LINUX_BUS_MANAGER_H
+#define KICKAT_LINUX_BUS_MANAGER_H
+
+#include <array>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "kickcat/Bus.h"
+
+namespace kickcat
+{
+    /// \brief   Run several independent EtherCAT segments (one Link/Bus per NIC) in parallel, each one in its own real time thread
+    /// \details Segment threads are pinned on their own core and wake up on a common timebase: cycles of all the segments start
+    ///          at the same time (plus an optional per segment phase). After each cycle, the segment process image is copied in
+    ///          a snapshot tagged with the cycle number, so the images of all the segments can be read for the same cycle.
+    ///          Buses shall be initialized (init(), createMapping(), ...) before start().
+    class BusManager
+    {
+    public:
+        struct Segment
+        {
+            std::shared_ptr<AbstractSocket> nominal;
+            std::shared_ptr<AbstractSocket> redundancy;     // SocketNull if not used
+            int cpu{-1};                                    // core to pin the segment thread on, -1 to let the OS choose
+            int priority{0};                                // SCHED_FIFO priority, 0 to keep the default scheduler
+            nanoseconds phase{0ns};                         // offset of the segment cycles on the common timebase
+            std::function<void(Bus& bus, int64_t cycle)> cycle; // one cycle of the segment (i.e. processDataReadWrite())
+        };
+
+        BusManager(nanoseconds cycle);
+        ~BusManager();
+
+        /// \return the segment index
+        int32_t addSegment(Segment const& segment);
+        Bus& bus(int32_t segment) { return segments_.at(segment)->bus; }
+
+        /// \brief Process image to snapshot after each cycle of a segment (i.e. the createMapping() buffer)
+        void setImage(int32_t segment, uint8_t const* image, int32_t size);
+
+        void start();
+        void stop();
+
+        /// \brief  Copy the process images of all the segments for the same cycle (the most recent one available)
+        /// \return the cycle of the snapshot, -1 if there is no common cycle yet
+        int64_t snapshot(std::vector<std::vector<uint8_t>>& images);
+
+        int64_t cycles(int32_t segment) const   { return segments_.at(segment)->cycles;   }
+        int64_t overruns(int32_t segment) const { return segments_.at(segment)->overruns; } // cycles started more than a cycle late
+        int64_t errors(int32_t segment) const   { return segments_.at(segment)->errors;   } // cycles that threw
+
+    private:
+        static constexpr int32_t SNAPSHOTS = 4; // per segment: the common cycle is found as long as segments are less than 4 cycles apart
+
+        struct Snapshot
+        {
+            int64_t cycle{-1};
+            std::vector<uint8_t> data;
+        };
+
+        struct SegmentContext
+        {
+            SegmentContext(Segment const& segment);
+
+            Segment config;
+            std::shared_ptr<Link> link;
+            Bus bus;
+            std::thread thread;
+
+            uint8_t const* image{nullptr};
+            int32_t image_size{0};
+            std::mutex mutex;                       // protect snapshots: the segment thread never waits on it
+            std::array<Snapshot, SNAPSHOTS> snapshots;
+
+            std::atomic<int64_t> cycles{0};
+            std::atomic<int64_t> overruns{0};
+            std::atomic<int64_t> errors{0};
+        };
+
+        void configure(SegmentContext const& segment);  // apply CPU affinity and priority to the calling thread
+        void run(SegmentContext& segment, std::promise<void>& started);
+
+        nanoseconds cycle_;
+        nanoseconds start_time_{0ns};
+        std::atomic<bool> running_{false};
+        std::vector<std::unique_ptr<SegmentContext>> segments_;
+    };
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef KICKAT_LINUX_RX_THREAD_SOCKET_H
+#define KICKAT_LINUX_RX_THREAD_SOCKET_H
+
+#include <array>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include "kickcat/AbstractSocket.h"
+#include "kickcat/SpscRing.h"
+#include "kickcat/protocol.h"
+
+namespace kickcat
+{
+    /// \brief   Receive frames of a socket from a dedicated thread
+    /// \details The receive thread (optionally pinned and real time) reads the wrapped socket into a preallocated ring
+    ///          and timestamps each frame. read() only pops received frames, and waits on an eventfd when the ring is
+    ///          empty: receive syscalls and polling sleeps are taken off the thread that runs the bus, and the socket
+    ///          queue is drained even when this thread is busy. write() goes straight to the wrapped socket.
+    ///          Usage: wrap the sockets given to the Link (the wrapped socket may already be opened, then call start()).
+    class RxThreadSocket : public AbstractSocket
+    {
+    public:
+        /// \param socket       socket to read from: its read() shall be usable while another thread writes
+        /// \param cpu          core to pin the receive thread on, -1 to let the OS choose
+        /// \param priority     SCHED_FIFO priority of the receive thread, 0 to keep the default scheduler
+        /// \param capacity     frames stored in the ring, shall be a power of two
+        RxThreadSocket(std::shared_ptr<AbstractSocket> socket, int cpu = -1, int priority = 0, std::size_t capacity = 64);
+        virtual ~RxThreadSocket();
+
+        /// \brief Open the wrapped socket and start the receive thread
+        void open(std::string const& interface) override;
+        void setTimeout(nanoseconds timeout) override;
+        void close() noexcept override;
+        int32_t read(uint8_t* frame, int32_t frame_size) override;
+        int32_t write(uint8_t const* frame, int32_t frame_size) override;
+
+        /// \return an eventfd readable when frames are waiting in the ring
+        int fd() const override { return event_fd_; }
+
+        /// \brief Start the receive thread on an already opened socket
+        void start();
+        void stop() noexcept;
+
+        /// \return reception time (as seen by the receive thread) of the last frame returned by read()
+        nanoseconds timestamp() const { return timestamp_; }
+
+        /// \return frames dropped because the ring was full
+        int64_t overflows() const { return overflows_; }
+
+    private:
+        struct Slot
+        {
+            std::array<uint8_t, ETH_MAX_SIZE> data;
+            int32_t size;
+            nanoseconds timestamp;
+        };
+
+        void configure();   // apply CPU affinity and priority to the calling thread
+        void run(std::promise<void>& started);
+        void signal();
+
+        std::shared_ptr<AbstractSocket> socket_;
+        int cpu_;
+        int priority_;
+        SpscRing<Slot> ring_;
+
+        int event_fd_{-1};
+        std::thread thread_;
+        std::atomic<bool> running_{false};
+        std::atomic<int64_t> overflows_{0};
+
+        nanoseconds timeout_{0ns};
+        nanoseconds timestamp_{0ns};
+    };
+}
+
+#endif
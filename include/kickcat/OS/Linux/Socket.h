@@ -19,6 +19,7 @@ namespace kickcat
         void close() noexcept override;
         int32_t read(uint8_t* frame, int32_t frame_size) override;
         int32_t write(uint8_t const* frame, int32_t frame_size) override;
+        int fd() const override { return fd_; }
 
     private:
         int fd_{-1};
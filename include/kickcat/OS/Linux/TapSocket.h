@@ -0,0 +1,33 @@
+#ifndef KICKAT_LINUX_TAP_SOCKET_H
+#define KICKAT_LINUX_TAP_SOCKET_H
+
+#include "kickcat/AbstractSocket.h"
+
+namespace kickcat
+{
+    /// \brief   Linux TAP device: a virtual Ethernet interface to exchange frames with the local network stack (i.e. for EoE)
+    /// \details open() creates the interface if it does not exist yet (CAP_NET_ADMIN required).
+    ///          The default null timeout makes read() non blocking.
+    class TapSocket : public AbstractSocket
+    {
+    public:
+        TapSocket() = default;
+        virtual ~TapSocket()
+        {
+            close();
+        }
+
+        void open(std::string const& interface) override;
+        void setTimeout(nanoseconds timeout) override;
+        void close() noexcept override;
+        int32_t read(uint8_t* frame, int32_t frame_size) override;
+        int32_t write(uint8_t const* frame, int32_t frame_size) override;
+        int fd() const override { return fd_; }
+
+    private:
+        int fd_{-1};
+        nanoseconds timeout_{0ns};
+    };
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef KICKCAT_SCHEDULER_H
+#define KICKCAT_SCHEDULER_H
+
+#include <functional>
+#include <vector>
+
+#include "Bus.h"
+
+namespace kickcat
+{
+    /// \brief   Declarative multi-rate cyclic scheduler
+    /// \details Process data of each addressing group is exchanged at its own rate. Acyclic tasks (mailboxes, error counters,
+    ///          user datagrams) are registered with a rate and the worst case size of the datagrams they add: every cycle,
+    ///          the most urgent ones fill the space left in the cyclic frames, within the acyclic budget.
+    ///          A task that fits in one frame never opens a new one: the frame count stays constant and the wire time bounded.
+    ///          Bigger tasks (i.e. mailboxes of many slaves) are only bounded by the acyclic budget.
+    ///          Whatever the domain the tasks write to, their datagrams go in the process data frames: with configured
+    ///          domains (Link::configureDomains()), the cyclic domain needs indexes for them too.
+    class Scheduler
+    {
+    public:
+        using Error = std::function<void(DatagramState const&)>;
+        using Task  = std::function<void(Error const& error)>;
+
+        /// \param acyclic_budget   Bytes of acyclic datagrams (headers included) allowed per cycle
+        Scheduler(Bus& bus, int32_t acyclic_budget = MAX_ETHERCAT_PAYLOAD_SIZE);
+
+        /// \brief Exchange (LRW) the process data of an addressing group every period cycles
+        void addProcessData(int32_t group, int32_t period = 1);
+
+        /// \brief Register an acyclic task to run at most every period cycles
+        /// \param budget   Worst case bytes of the datagrams added by the task (cf. datagram_size())
+        /// \param offset   Cycles before the first run: tasks of a same period with distinct offsets run on distinct cycles
+        void addTask(int32_t period, int32_t budget, Task const& task, int32_t offset = 0);
+
+        /// \brief Add the datagrams of the current cycle then process the frames
+        void cycle(Error const& error);
+
+        int64_t cycles() const { return cycle_; }
+
+    private:
+        void addDatagrams(Error const& error); // datagrams of the current cycle, in the process data frames
+
+        struct ProcessData
+        {
+            int32_t group;
+            int32_t period;
+        };
+
+        struct AcyclicTask
+        {
+            int32_t period;
+            int32_t budget;
+            Task task;
+            int64_t due;      // cycle from which the task may run again
+        };
+
+        Bus& bus_;
+        int32_t acyclic_budget_;
+        int64_t cycle_{0};
+
+        std::vector<ProcessData> process_data_;
+        std::vector<AcyclicTask> tasks_;
+        std::vector<AcyclicTask*> candidates_;
+    };
+}
+
+#endif
@@ -65,6 +65,14 @@ namespace kickcat
             int32_t bsize;          // size of the mapping (in bytes)
             int32_t sync_manager;   // associated Sync manager
             uint32_t address;       // logical address
+            uint8_t bit_offset;     // first bit of the mapping in data (not null only for bit packed mappings)
+
+            // Bit accessors, valid whatever the mapping layout (cf. Bus::MappingLayout).
+            // Bit packed mappings share bytes with other slaves: use them instead of a direct access to data.
+            bool getBit(int32_t bit) const;
+            void setBit(int32_t bit, bool value);
+            uint32_t getBits(int32_t bit, int32_t count) const;         // up to 32 bits, first bit is the LSB
+            void setBits(int32_t bit, int32_t count, uint32_t value);
         };
         // set it to true to let user define the mapping, false to autodetect it
         // If set to true, user shall set input and output mapping bsize and sync_manager members.
@@ -72,9 +80,27 @@ namespace kickcat
         PIMapping input;            // slave to master
         PIMapping output;
 
+        // Addressing group: slaves of a group are mapped in their own logical frames (to set before Bus::createMapping())
+        int32_t group{0};
+
+        // Latency priority: slaves with a higher priority are mapped in their own frames, sent first each cycle (to set
+        // before Bus::createMapping()). Use it for latency critical slaves, and keep bulk I/O to the default (0).
+        int32_t priority{0};
+
         ErrorCounters error_counters;
         int previous_errors_sum{0};
 
+        // Distributed clock state (cf. Bus::initDistributedClocks())
+        struct DC
+        {
+            bool supported;
+            uint32_t receive_time[4];   // ports receive time, latched by a write on reg::DC_TIME
+            uint64_t local_time;        // processing unit receive time of the same latch
+            int32_t  delay;             // propagation delay from the reference clock (ns)
+            int64_t  offset;            // system time offset (ns)
+        };
+        DC dc{};
+
     private:
         void parseStrings(uint8_t const* section_start);
         void parseFMMU(uint8_t const* section_start, uint16_t section_size);
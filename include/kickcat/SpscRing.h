@@ -0,0 +1,77 @@
+#ifndef KICKCAT_SPSC_RING_H
+#define KICKCAT_SPSC_RING_H
+
+#include <atomic>
+#include <vector>
+
+#include "Error.h"
+
+namespace kickcat
+{
+    /// \brief   Lock-free single producer / single consumer ring of preallocated elements
+    /// \details Elements are filled and consumed in place: the producer gets a free slot with produce(), fills it and
+    ///          publishes it with commit(); the consumer gets the oldest published slot with consume() and gives it
+    ///          back with release(). Nothing is allocated nor copied after construction.
+    template<typename T>
+    class SpscRing
+    {
+    public:
+        /// \param capacity number of elements, shall be a power of two
+        SpscRing(std::size_t capacity)
+            : elements_(capacity)
+            , mask_(capacity - 1)
+        {
+            if ((capacity == 0) or ((capacity & mask_) != 0))
+            {
+                THROW_ERROR("Ring capacity shall be a power of two");
+            }
+        }
+
+        /// \return a free slot to fill, nullptr if the ring is full
+        T* produce()
+        {
+            std::size_t head = head_.load(std::memory_order_relaxed);
+            if ((head - tail_.load(std::memory_order_acquire)) == elements_.size())
+            {
+                return nullptr;
+            }
+            return &elements_[head & mask_];
+        }
+
+        /// \brief Publish the slot returned by produce()
+        void commit()
+        {
+            head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /// \return the oldest published slot, nullptr if the ring is empty
+        T* consume()
+        {
+            std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == head_.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            return &elements_[tail & mask_];
+        }
+
+        /// \brief Give back the slot returned by consume()
+        void release()
+        {
+            tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        std::size_t size() const     { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+        std::size_t capacity() const { return elements_.size(); }
+
+    private:
+        std::vector<T> elements_;
+        std::size_t mask_;
+
+        // producer and consumer indexes on their own cache line to avoid false sharing
+        alignas(64) std::atomic<std::size_t> head_{0};
+        alignas(64) std::atomic<std::size_t> tail_{0};
+    };
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef KICKCAT_TRIPLE_BUFFER_H
+#define KICKCAT_TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace kickcat
+{
+    /// \brief   Lock-free single writer / single reader triple buffer
+    /// \details The writer fills back() and publishes it as a whole with commit(); the reader takes the last published
+    ///          buffer with acquire() and reads front(). Both sides never wait nor see a partially written buffer, and
+    ///          the reader always gets the most recent commit (intermediate ones may be skipped).
+    ///          The shared state packs the index of the published buffer with a generation counter incremented by
+    ///          each commit: the reader knows if something new was published since its last acquire().
+    class TripleBuffer
+    {
+    public:
+        /// \param size bytes of each buffer
+        /// \param init initial content of the buffers (size bytes), nullptr to zero them
+        TripleBuffer(std::size_t size, uint8_t const* init = nullptr)
+            : size_{size}
+        {
+            for (auto& buffer : buffers_)
+            {
+                buffer.resize(size, 0);
+                if (init != nullptr)
+                {
+                    std::memcpy(buffer.data(), init, size);
+                }
+            }
+        }
+
+        /// \return writer side buffer, holding the last committed content
+        uint8_t* back() { return buffers_[back_].data(); }
+
+        /// \brief Publish the back buffer
+        /// \return generation of the published content
+        uint64_t commit()
+        {
+            uint8_t const* committed = back();
+            ++written_;
+            uint64_t previous = state_.exchange(pack(back_, written_), std::memory_order_acq_rel);
+            back_ = index(previous);
+
+            // the next back buffer starts from the content just published, so partial updates are not lost
+            std::memcpy(back(), committed, size_);
+            return written_;
+        }
+
+        /// \brief Take the last published buffer if it was not already taken
+        /// \return true if front() changed
+        bool acquire()
+        {
+            uint64_t state = state_.load(std::memory_order_acquire);
+            while (generation(state) != read_)
+            {
+                // the writer may publish in between: only release our buffer if we take the one we saw
+                if (state_.compare_exchange_weak(state, pack(front_, generation(state)), std::memory_order_acq_rel))
+                {
+                    front_ = index(state);
+                    read_ = generation(state);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// \return reader side buffer
+        uint8_t const* front() const { return buffers_[front_].data(); }
+
+        /// \return generation of front(), 0 before the first commit
+        uint64_t generation() const { return read_; }
+
+        std::size_t size() const { return size_; }
+
+    private:
+        static uint64_t pack(uint8_t index, uint64_t generation) { return (generation << 2) | index; }
+        static uint8_t  index(uint64_t state)      { return static_cast<uint8_t>(state & 0x3); }
+        static uint64_t generation(uint64_t state) { return state >> 2; }
+
+        std::size_t size_;
+        std::array<std::vector<uint8_t>, 3> buffers_;
+
+        alignas(64) std::atomic<uint64_t> state_{pack(1, 0)};   // published buffer and its generation
+
+        alignas(64) uint8_t back_{0};   // writer side
+        uint64_t written_{0};
+
+        alignas(64) uint8_t front_{2};  // reader side
+        uint64_t read_{0};
+    };
+}
+
+#endif
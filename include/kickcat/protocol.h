@@ -46,6 +46,9 @@ namespace kickcat
 #endif
     constexpr int32_t  ETH_MAX_SIZE = sizeof(EthernetHeader) + ETH_MTU_SIZE + ETH_FCS_SIZE;
     constexpr int32_t  ETH_MIN_SIZE = 60; // Ethernet disallow sending less than 64 bytes (60 + FCS)
+    constexpr int32_t  ETH_PREAMBLE_SIZE = 8;   // preamble + start frame delimiter
+    constexpr int32_t  ETH_IFG_SIZE = 12;       // minimal inter frame gap
+    constexpr nanoseconds ETH_BYTE_TIME = 80ns; // 100 Mbit/s
 
     using EthernetFrame = std::array<uint8_t, ETH_MAX_SIZE>; // Definition of an Ethernet frame (maximal size)
 
@@ -177,12 +180,19 @@ namespace kickcat
         constexpr uint16_t SYNC_MANAGER_3  = SYNC_MANAGER + 8 * 3;
         constexpr uint16_t SM_STATS = 5;
 
-        constexpr uint16_t DC_TIME            = 0x900;
-        constexpr uint16_t DC_SYSTEM_TIME     = 0x910;
+        constexpr uint16_t DC_TIME            = 0x900; // 4x4 bytes, ports receive time
+        constexpr uint16_t DC_SYSTEM_TIME     = 0x910; // 8 bytes
+        constexpr uint16_t DC_RECEIVE_TIME_PU = 0x918; // 8 bytes, processing unit receive time
+        constexpr uint16_t DC_SYSTEM_OFFSET   = 0x920; // 8 bytes
+        constexpr uint16_t DC_SYSTEM_DELAY    = 0x928; // 4 bytes
+        constexpr uint16_t DC_SYSTEM_DIFF     = 0x92C; // 4 bytes
         constexpr uint16_t DC_SPEED_CNT_START = 0x930;
         constexpr uint16_t DC_TIME_FILTER     = 0x934;
         constexpr uint16_t DC_CYCLIC_CONTROL  = 0x980;
         constexpr uint16_t DC_SYNC_ACTIVATION = 0x981;
+        constexpr uint16_t DC_START_TIME      = 0x990; // 8 bytes
+        constexpr uint16_t DC_SYNC0_CYCLE     = 0x9A0; // 4 bytes
+        constexpr uint16_t DC_SYNC1_CYCLE     = 0x9A4; // 4 bytes
     }
 
     struct DLStatus
@@ -484,6 +494,58 @@ namespace kickcat
         }
     }
 
+    namespace FoE
+    {
+        namespace Opcode
+        {
+            constexpr uint8_t READ_REQUEST  = 0x01;
+            constexpr uint8_t WRITE_REQUEST = 0x02;
+            constexpr uint8_t DATA          = 0x03;
+            constexpr uint8_t ACK           = 0x04;
+            constexpr uint8_t ERROR         = 0x05;
+            constexpr uint8_t BUSY          = 0x06;
+        }
+
+        /// ETG 1000.6
+        struct Header
+        {
+            uint8_t  opcode;
+            uint8_t  reserved;
+            uint32_t data;      // password (read/write request), packet number (data/ack) or error code (error)
+        } __attribute__((__packed__));
+
+        char const* error_to_str(uint32_t error_code);
+    }
+
+    namespace EoE
+    {
+        namespace FrameType
+        {
+            constexpr uint8_t FRAGMENT              = 0x00;
+            constexpr uint8_t INIT_RESPONSE_TIME    = 0x01;
+            constexpr uint8_t SET_IP_REQUEST        = 0x02;
+            constexpr uint8_t SET_IP_RESPONSE       = 0x03;
+            constexpr uint8_t SET_FILTER_REQUEST    = 0x04;
+            constexpr uint8_t SET_FILTER_RESPONSE   = 0x05;
+        }
+
+        /// ETG 1000.6
+        struct Header
+        {
+            uint16_t type            : 4,
+                     port            : 4,
+                     last_fragment   : 1,
+                     time_appended   : 1,
+                     time_request    : 1,
+                     reserved        : 5;
+            uint16_t fragment_number : 6,
+                     offset          : 6,   // first fragment: complete frame size, others: fragment offset (both in 32 bytes blocks)
+                     frame_number    : 4;
+        } __attribute__((__packed__));
+
+        constexpr int32_t FRAGMENT_BLOCK_SIZE = 32; // fragment size, except the last one, shall be a multiple of this value
+    }
+
     // MAC addresses are not used by EtherCAT but set them helps the debug easier when following a network trace.
     constexpr MAC PRIMARY_IF_MAC   = { 0xCA, 0xDE, 0xCA, 0xDE, 0xDE, 0xFF };
     constexpr MAC SECONDARY_IF_MAC = { 0x03, 0x02, 0x02, 0x02, 0xFF, 0xFF };
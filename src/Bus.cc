@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cstring>
+#include <limits>
 
 #include "Bus.h"
 #include "AbstractSocket.h"
@@ -72,16 +74,6 @@ namespace kickcat
         auto error_callback = [](DatagramState const& state){ THROW_ERROR_DATAGRAM("init error while cleaning slaves mailboxes", state); };
         checkMailboxes(error_callback);
         processMessages(error_callback);
-
-        // create CoE emergency reception callback
-        for (auto& slave : slaves_)
-        {
-            if (slave.supported_mailbox & eeprom::MailboxProtocol::CoE)
-            {
-                auto emg = std::make_shared<EmergencyMessage>(slave.mailbox);
-                slave.mailbox.to_process.push_back(emg);
-            }
-        }
     }
 
 
@@ -194,6 +186,9 @@ namespace kickcat
         dc_param = 0x0c00;          // reset value
         broadcastWrite(reg::DC_TIME_FILTER, &dc_param, sizeof(dc_param));
 
+        // ECAT events are ORed in the datagrams IRQ field that tags the transactions: mask them all
+        broadcastWrite(reg::ECAT_EVENT_MASK,    param, 2);
+
         // PDIO watchdogs
         nanoseconds const precision = 100us;
         uint16_t const wdg_divider = computeWatchdogDivider(precision);
@@ -283,58 +278,134 @@ namespace kickcat
             return bytes;
         };
 
-        // Determines PI sizes for each slave
-        for (auto& slave : slaves_)
+        // CoE slaves mapping is browsed through their object dictionary: one SDO is in flight per slave
+        // and all the slaves are processed at once to share the mailboxes round trips.
+        enum class Step
         {
-            if (slave.is_static_mapping)
+            SM_TYPES,       // reading SM communication types
+            SM_CHANNEL,     // reading PDOs assigned to current SM
+            PDO,            // reading entries of current PDO
+            DONE
+        };
+
+        struct Detection
+        {
+            Step step;
+            ObjectUpload upload;
+            uint8_t sm_types[sizeof(ObjectUpload::data)];
+            uint32_t sm_count;
+            uint32_t sm;                // current SM
+            uint16_t pdos[sizeof(ObjectUpload::data) / 2];
+            uint32_t pdo_count;
+            uint32_t pdo;               // current PDO
+            Slave::PIMapping* mapping;  // mapping of the current SM
+        };
+
+        // Go to the next SM/PDO to read
+        auto nextPDO = [&](Detection& detection)
+        {
+            Slave& slave = *detection.upload.slave;
+            bool complete_access = detection.upload.complete_access;
+
+            if (detection.pdo < detection.pdo_count)
             {
-                slave.input.size  = slave.input.bsize  * 8;
-                slave.output.size = slave.output.bsize * 8;
-                continue;
+                detection.step = Step::PDO;
+                startObjectUpload(detection.upload, slave, detection.pdos[detection.pdo], complete_access);
+                return;
             }
 
-            if (slave.supported_mailbox & eeprom::MailboxProtocol::CoE)
+            // current SM is done (if any): look for the next one
+            if (detection.mapping != nullptr)
             {
-                // Slave support CAN over EtherCAT -> use mailbox/SDO to get mapping size
-                uint8_t sm[512];
-                uint32_t sm_size = sizeof(sm);
-                readSDO(slave, CoE::SM_COM_TYPE, 1, Access::EMULATE_COMPLETE, sm, &sm_size);
+                detection.mapping->bsize = bits_to_bytes(detection.mapping->size);
+                detection.mapping = nullptr;
+                ++detection.sm;
+            }
 
-                for (uint32_t i = 0; i < sm_size; ++i)
+            for (; detection.sm < detection.sm_count; ++detection.sm)
+            {
+                //TODO we support only one input and one output per slave for now
+                uint8_t type = detection.sm_types[detection.sm];
+                if (type <= 2) // mailboxes
                 {
-                    //TODO we support only one input and one output per slave for now
-                    if (sm[i] <= 2) // mailboxes
-                    {
-                        continue;
-                    }
+                    continue;
+                }
 
-                    Slave::PIMapping* mapping = &slave.input;
-                    if (sm[i] == SyncManagerType::Output)
-                    {
-                        mapping = &slave.output;
-                    }
-                    mapping->sync_manager = i;
-                    mapping->size = 0;
+                detection.mapping = &slave.input;
+                if (type == SyncManagerType::Output)
+                {
+                    detection.mapping = &slave.output;
+                }
+                detection.mapping->sync_manager = static_cast<int32_t>(detection.sm);
+                detection.mapping->size = 0;
+
+                detection.step = Step::SM_CHANNEL;
+                startObjectUpload(detection.upload, slave, CoE::SM_CHANNEL + static_cast<uint16_t>(detection.sm), complete_access);
+                return;
+            }
 
-                    uint16_t mapped_index[128];
-                    uint32_t map_size = sizeof(mapped_index);
-                    readSDO(slave, CoE::SM_CHANNEL + static_cast<uint16_t>(i), 1, Access::EMULATE_COMPLETE, mapped_index, &map_size);
+            detection.step = Step::DONE;
+        };
 
-                    for (uint32_t j = 0; j < (map_size / 2); ++j)
+        auto process = [&](Detection& detection)
+        {
+            ObjectUpload const& upload = detection.upload;
+            switch (detection.step)
+            {
+                case Step::SM_TYPES:
+                {
+                    std::memcpy(detection.sm_types, upload.data, upload.size);
+                    detection.sm_count = upload.size;
+                    detection.sm = 0;
+                    detection.pdo = 0;
+                    detection.pdo_count = 0;
+                    detection.mapping = nullptr;
+                    break;
+                }
+                case Step::SM_CHANNEL:
+                {
+                    std::memcpy(detection.pdos, upload.data, upload.size);
+                    detection.pdo_count = upload.size / 2;
+                    detection.pdo = 0;
+                    break;
+                }
+                case Step::PDO:
+                {
+                    for (uint32_t k = 0; k < upload.size; k += 4)
                     {
-                        uint8_t object[512];
-                        uint32_t object_size = sizeof(object);
-                        readSDO(slave, mapped_index[j], 1, Access::EMULATE_COMPLETE, object, &object_size);
-
-                        for (uint32_t k = 0; k < object_size; k += 4)
-                        {
-                            mapping->size += object[k];
-                        }
+                        detection.mapping->size += upload.data[k];
                     }
-
-                    mapping->bsize = bits_to_bytes(mapping->size);
+                    ++detection.pdo;
+                    break;
+                }
+                default:
+                {
+                    return;
                 }
             }
+            nextPDO(detection);
+        };
+
+        // Determines PI sizes for each slave
+        std::vector<Detection> detections;
+        detections.reserve(slaves_.size()); // SDOs in flight point on detections data: it shall not be reallocated
+        for (auto& slave : slaves_)
+        {
+            if (slave.is_static_mapping)
+            {
+                slave.input.size  = slave.input.bsize  * 8;
+                slave.output.size = slave.output.bsize * 8;
+                continue;
+            }
+
+            if (slave.supported_mailbox & eeprom::MailboxProtocol::CoE)
+            {
+                // Slave support CAN over EtherCAT -> use mailbox/SDO to get mapping size
+                bool complete_access = (slave.sii.general != nullptr) and (slave.sii.general->SDO_complete_access);
+                detections.emplace_back();
+                detections.back().step = Step::SM_TYPES;
+                startObjectUpload(detections.back().upload, slave, CoE::SM_COM_TYPE, complete_access);
+            }
             else
             {
                 // unsupported mailbox: use SII to get the mapping size
@@ -356,6 +427,43 @@ namespace kickcat
                 mapping->bsize = bits_to_bytes(mapping->size);
             }
         }
+
+        auto error_callback = [](DatagramState const& state)
+        {
+            THROW_ERROR_DATAGRAM("error while checking mailboxes", state);
+        };
+
+        auto is_running = [](Detection const& detection) { return detection.step != Step::DONE; };
+        try
+        {
+            while (std::any_of(detections.begin(), detections.end(), is_running))
+            {
+                checkMailboxes(error_callback);
+                processMessages(error_callback);
+
+                for (auto& detection : detections)
+                {
+                    if (is_running(detection) and processObjectUpload(detection.upload, OBJECT_UPLOAD_TIMEOUT))
+                    {
+                        process(detection);
+                    }
+                }
+
+                sleep(tiny_wait);
+            }
+        }
+        catch (...)
+        {
+            // the uploads still in flight write in detections: withdraw them before it goes out of scope
+            for (auto& detection : detections)
+            {
+                if (is_running(detection) and (detection.upload.sdo->status() == MessageStatus::RUNNING))
+                {
+                    detection.upload.slave->mailbox.cancel(detection.upload.sdo);
+                }
+            }
+            throw;
+        }
     }
 
 
@@ -370,121 +478,638 @@ namespace kickcat
         // Second step: create 'block I/O' lists for read and write op
         // Note A: offset computing will overlap input and output in the frame (better density and compatibility, more works for master)
         // Note B: a frame cannot handle more than 1486 bytes
-        pi_frames_.resize(1);
-        pi_frames_[0].address = 0;
-        uint32_t address = 0;
+        // Note C: each addressing group starts on its own frame, so groups can be exchanged independently
+        // Note D: with split areas, inputs and outputs are laid out in distinct frames (exchanged with LRD and LWR)
+        // Note E: each latency priority starts on its own frame too, and frames are sent in logical address order: the
+        //         highest priority frames come first (then the groups in increasing order for a same priority)
+        std::vector<std::pair<int32_t, int32_t>> sets; // (priority, group) of the slaves
+        for (auto const& slave : slaves_)
+        {
+            std::pair<int32_t, int32_t> set{slave.priority, slave.group};
+            if (std::find(sets.begin(), sets.end(), set) == sets.end())
+            {
+                sets.push_back(set);
+            }
+        }
+        std::sort(sets.begin(), sets.end(), [](std::pair<int32_t, int32_t> const& lhs, std::pair<int32_t, int32_t> const& rhs)
+        {
+            if (lhs.first != rhs.first)
+            {
+                return lhs.first > rhs.first;
+            }
+            return lhs.second < rhs.second;
+        });
+
+        pi_frames_.clear();
+        output_stages_.clear();
+        uint32_t next_frame = 0;
+        for (auto const& [priority, group] : sets)
+        {
+            if (process_data_areas_ == ProcessDataAreas::SPLIT)
+            {
+                layoutFrames(group, priority, next_frame, true,  false);
+                layoutFrames(group, priority, next_frame, false, true);
+            }
+            else
+            {
+                layoutFrames(group, priority, next_frame, true, true);
+            }
+        }
+
+        // Third step: associate client buffer address to block IO and slaves
+        if (mapping_layout_ == MappingLayout::BIT_PACKED)
+        {
+            // Bytes are shared between slaves: client buffer mirrors the frames, inputs image first, outputs image second
+            int32_t image_size = 0;
+            for (auto const& frame : pi_frames_)
+            {
+                image_size += frame.size;
+            }
+
+            uint8_t* inputs  = iomap;
+            uint8_t* outputs = iomap + image_size;
+            for (auto& frame : pi_frames_)
+            {
+                for (auto& bio : frame.inputs)
+                {
+                    bio.iomap = inputs + bio.offset;
+                    bio.slave->input.data = bio.iomap;
+                }
+                for (auto& bio : frame.outputs)
+                {
+                    bio.iomap = outputs + bio.offset;
+                    bio.slave->output.data = bio.iomap;
+                }
+                inputs  += frame.size;
+                outputs += frame.size;
+            }
+        }
+        else
+        {
+            // Note: inputs are mapped first, outputs second
+            uint8_t* pos = iomap;
+            for (auto& frame : pi_frames_)
+            {
+                for (auto& bio : frame.inputs)
+                {
+                    bio.iomap = pos;
+                    bio.slave->input.data = pos;
+                    pos += bio.size;
+                }
+            }
+            for (auto& frame : pi_frames_)
+            {
+                for (auto& bio : frame.outputs)
+                {
+                    bio.iomap = pos;
+                    bio.slave->output.data = pos;
+                    pos += bio.size;
+                }
+            }
+        }
+
+        // Fourth step: program FMMUs and SyncManagers
+        configureFMMUs();
+    }
+
+
+    void Bus::layoutFrames(int32_t group, int32_t priority, uint32_t& next_frame, bool map_inputs, bool map_outputs)
+    {
+        struct Item
+        {
+            Slave* slave;
+            int32_t bits;   // biggest mapping in bits
+            int32_t bytes;  // biggest mapping in bytes
+            bool packed;    // shares bytes with other slaves (bit packed layout)
+        };
+
+        std::vector<Item> items;
         for (auto& slave : slaves_)
         {
-            // get the biggest one.
-            int32_t size = std::max(slave.input.bsize, slave.output.bsize);
-            if ((address + size) > (pi_frames_.size() * MAX_ETHERCAT_PAYLOAD_SIZE)) // do we overflow current frame ?
+            if ((slave.group != group) or (slave.priority != priority))
             {
-                pi_frames_.back().size = address - pi_frames_.back().address; // frame size = current address - frame address
+                continue;
+            }
 
-                // current size will overflow the frame at the current offset: set in on the next frame
-                address = static_cast<uint32_t>(pi_frames_.size()) * MAX_ETHERCAT_PAYLOAD_SIZE;
-                pi_frames_.push_back({address, 0, {}, {}});
+            Item item{&slave, 0, 0, false};
+            if (map_inputs)
+            {
+                item.bits  = std::max(item.bits,  slave.input.size);
+                item.bytes = std::max(item.bytes, slave.input.bsize);
+            }
+            if (map_outputs)
+            {
+                item.bits  = std::max(item.bits,  slave.output.size);
+                item.bytes = std::max(item.bytes, slave.output.bsize);
             }
+            if ((map_inputs != map_outputs) and (item.bytes == 0))
+            {
+                continue; // nothing to exchange in this area
+            }
+            item.packed = (mapping_layout_ == MappingLayout::BIT_PACKED) and (item.bits < 8);
+            items.push_back(item);
+        }
+        if (items.empty())
+        {
+            return;
+        }
 
-            // create block IO entries
-            pi_frames_.back().inputs.push_back ({nullptr, address - pi_frames_.back().address, slave.input.bsize,  &slave});
-            pi_frames_.back().outputs.push_back({nullptr, address - pi_frames_.back().address, slave.output.bsize, &slave});
+        if (frame_packing_ == FramePacking::FIRST_FIT)
+        {
+            // biggest first, bit packed slaves last and in bus order so they keep sharing bytes
+            std::stable_sort(items.begin(), items.end(), [](Item const& lhs, Item const& rhs)
+            {
+                if (lhs.packed != rhs.packed)
+                {
+                    return rhs.packed;
+                }
+                return lhs.bytes > rhs.bytes;
+            });
+        }
 
-            // save mapping offset (need to configure slave FMMU)
-            slave.input.address  = address;
-            slave.output.address = address;
+        struct Cursor
+        {
+            std::size_t frame;  // index in pi_frames_
+            uint32_t address;   // next free logical address
+            uint8_t bit;        // next free bit at address
+        };
+        std::vector<Cursor> cursors;
+        auto openFrame = [&]()
+        {
+            pi_frames_.push_back({next_frame, 0, group, priority, {}, {}});
+            cursors.push_back({pi_frames_.size() - 1, next_frame, 0});
+            next_frame += MAX_ETHERCAT_PAYLOAD_SIZE;
+        };
 
-            // update offset
-            address += size;
+        // place an item at the cursor if there is enough room left in the frame
+        auto place = [&](Cursor& cursor, Item const& item)
+        {
+            uint32_t address = cursor.address;
+            uint8_t bit = cursor.bit;
+            if ((bit != 0) and ((not item.packed) or ((bit + item.bits) > 8)))
+            {
+                // close the partially used byte
+                address += 1;
+                bit = 0;
+            }
+
+            PIFrame& frame = pi_frames_[cursor.frame];
+            if ((address + item.bytes) > (frame.address + MAX_ETHERCAT_PAYLOAD_SIZE))
+            {
+                return false;
+            }
+
+            // create block IO entries and save mapping offset (need to configure slave FMMU)
+            Slave& slave = *item.slave;
+            uint32_t offset = address - frame.address;
+            if (map_inputs)
+            {
+                frame.inputs.push_back({nullptr, offset, slave.input.bsize, &slave});
+                slave.input.address = address;
+                slave.input.bit_offset = bit;
+            }
+            if (map_outputs)
+            {
+                frame.outputs.push_back({nullptr, offset, slave.output.bsize, &slave});
+                slave.output.address = address;
+                slave.output.bit_offset = bit;
+            }
+
+            if (item.packed)
+            {
+                bit = static_cast<uint8_t>(bit + item.bits);
+                if (bit == 8)
+                {
+                    address += 1;
+                    bit = 0;
+                }
+            }
+            else
+            {
+                address += item.bytes;
+            }
+            cursor.address = address;
+            cursor.bit = bit;
+            return true;
+        };
+
+        openFrame();
+        for (auto const& item : items)
+        {
+            bool placed = false;
+            if (frame_packing_ == FramePacking::FIRST_FIT)
+            {
+                for (auto& cursor : cursors)
+                {
+                    placed = place(cursor, item);
+                    if (placed)
+                    {
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                placed = place(cursors.back(), item);
+            }
+
+            if (not placed)
+            {
+                // current size will overflow the frame(s): set in on a new frame
+                openFrame();
+                if (not place(cursors.back(), item))
+                {
+                    THROW_ERROR("Slave process data does not fit in a frame");
+                }
+            }
         }
 
-        // update last frame size
-        pi_frames_.back().size = address - pi_frames_.back().address;
+        for (auto const& cursor : cursors)
+        {
+            PIFrame& frame = pi_frames_[cursor.frame];
+            frame.size = static_cast<int32_t>(cursor.address - frame.address);
+            if (cursor.bit != 0)
+            {
+                frame.size += 1;
+            }
+        }
+    }
 
-        // Third step: associate client buffer address to block IO and slaves
-        // Note: inputs are mapped first, outputs second
-        uint8_t* pos = iomap;
-        for (auto& frame : pi_frames_)
+
+    std::vector<uint16_t> Bus::cyclicDatagrams() const
+    {
+        std::vector<uint16_t> datagrams;
+        if (dc_reference_ != nullptr)
+        {
+            datagrams.push_back(sizeof(dc_system_time_));
+        }
+        for (auto const& pi_frame : pi_frames_)
+        {
+            datagrams.push_back(static_cast<uint16_t>(pi_frame.size));
+        }
+        return datagrams;
+    }
+
+
+    nanoseconds Bus::predictedWireTime() const
+    {
+        return computeWireUsage(cyclicDatagrams()).time;
+    }
+
+
+    CycleTimeEstimate Bus::estimateCycleTime(nanoseconds cycle, std::vector<uint16_t> const& acyclic, CycleTimeModel const& model)
+    {
+        std::vector<uint16_t> datagrams = cyclicDatagrams();
+        datagrams.insert(datagrams.end(), acyclic.begin(), acyclic.end());
+        return kickcat::estimateCycleTime(datagrams, slaves_, cycle, model);
+    }
+
+
+    void Bus::setInputsHandler(Slave& slave, std::function<void(Slave&)> handler)
+    {
+        std::size_t position = static_cast<std::size_t>(&slave - slaves_.data());
+        if (position >= slaves_.size())
+        {
+            THROW_ERROR("Slave is not on this bus");
+        }
+        if (inputs_handlers_.size() < slaves_.size())
+        {
+            inputs_handlers_.resize(slaves_.size());
+        }
+        inputs_handlers_[position] = std::move(handler);
+    }
+
+
+    void Bus::stageOutputs(int32_t group)
+    {
+        for (auto const& stage : output_stages_)
         {
-            for (auto& bio : frame.inputs)
+            if (stage.group == group)
             {
-                bio.iomap = pos;
-                bio.slave->input.data = pos;
-                pos += bio.size;
+                return;
             }
         }
-        for (auto& frame : pi_frames_)
+
+        OutputStage stage;
+        stage.group = group;
+        uint32_t size = 0;
+        for (std::size_t i = 0; i < pi_frames_.size(); ++i)
         {
-            for (auto& bio : frame.outputs)
+            PIFrame const& pi_frame = pi_frames_[i];
+            if ((pi_frame.group == group) and (not pi_frame.outputs.empty()))
             {
-                bio.iomap = pos;
-                bio.slave->output.data = pos;
-                pos += bio.size;
+                stage.frames.push_back(i);
+                stage.offsets.push_back(size);
+                size += pi_frame.size;
             }
         }
+        if (stage.frames.empty())
+        {
+            THROW_ERROR("No outputs to stage in this group");
+        }
 
-        // Fourth step: program FMMUs and SyncManagers
-        configureFMMUs();
+        // start from the current outputs
+        std::vector<uint8_t> init(size, 0);
+        for (std::size_t i = 0; i < stage.frames.size(); ++i)
+        {
+            for (auto const& output : pi_frames_[stage.frames[i]].outputs)
+            {
+                std::memcpy(init.data() + stage.offsets[i] + output.offset, output.iomap, output.size);
+            }
+        }
+        stage.buffer = std::make_unique<TripleBuffer>(size, init.data());
+        output_stages_.push_back(std::move(stage));
     }
 
 
-    void Bus::sendLogicalRead(std::function<void(DatagramState const&)> const& error)
+    Bus::OutputStage& Bus::outputStage(int32_t group)
     {
-        for (auto const& pi_frame : pi_frames_)
+        for (auto& stage : output_stages_)
+        {
+            if (stage.group == group)
+            {
+                return stage;
+            }
+        }
+        THROW_ERROR("Outputs of this group are not staged");
+    }
+
+
+    uint8_t* Bus::stagedOutputs(Slave& slave)
+    {
+        OutputStage& stage = outputStage(slave.group);
+        for (std::size_t i = 0; i < stage.frames.size(); ++i)
         {
-            auto process = [pi_frame](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            for (auto const& output : pi_frames_[stage.frames[i]].outputs)
             {
-                if (wkc != pi_frame.inputs.size())
+                if (output.slave == &slave)
                 {
-                    DEBUG_PRINT("Invalid working counter\n");
-                    return DatagramState::INVALID_WKC;
+                    return stage.buffer->back() + stage.offsets[i] + output.offset;
                 }
+            }
+        }
+        THROW_ERROR("Slave has no staged outputs");
+    }
+
+
+    uint64_t Bus::commitOutputs(int32_t group)
+    {
+        return outputStage(group).buffer->commit();
+    }
+
+
+    void Bus::pickStagedOutputs(OutputStage& stage)
+    {
+        if (not stage.buffer->acquire())
+        {
+            return; // nothing new: the client buffer already holds the last commit
+        }
+
+        uint8_t const* staged = stage.buffer->front();
+        for (std::size_t i = 0; i < stage.frames.size(); ++i)
+        {
+            for (auto const& output : pi_frames_[stage.frames[i]].outputs)
+            {
+                std::memcpy(output.iomap, staged + stage.offsets[i] + output.offset, output.size);
+            }
+        }
+    }
+
+
+    void Bus::pickStagedOutputs(int32_t group)
+    {
+        for (auto& stage : output_stages_)
+        {
+            if (stage.group == group)
+            {
+                pickStagedOutputs(stage);
+            }
+        }
+    }
+
 
-                for (auto& input : pi_frame.inputs)
+    void Bus::readInputs(PIFrame const& pi_frame, uint8_t const* data)
+    {
+        for (auto const& input : pi_frame.inputs)
+        {
+            std::memcpy(input.iomap, data + input.offset, input.size);
+        }
+
+        // once the whole frame is copied: bit packed slaves share bytes
+        for (auto const& input : pi_frame.inputs)
+        {
+            std::size_t position = static_cast<std::size_t>(input.slave - slaves_.data());
+            if ((position < inputs_handlers_.size()) and inputs_handlers_[position])
+            {
+                // called from the link frame processing that shall not be interrupted: hold the error until it is done
+                try
                 {
-                    std::memcpy(input.iomap, data + input.offset, input.size);
+                    inputs_handlers_[position](*input.slave);
                 }
-                return DatagramState::OK;
-            };
+                catch (...)
+                {
+                    DEBUG_PRINT("Inputs handler of slave %d failed\n", input.slave->address);
+                    if (not inputs_handler_error_)
+                    {
+                        inputs_handler_error_ = std::current_exception();
+                    }
+                }
+            }
+        }
+    }
+
+
+    void Bus::rethrowInputsHandlerError()
+    {
+        if (inputs_handler_error_)
+        {
+            std::exception_ptr error = inputs_handler_error_;
+            inputs_handler_error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+
+    void Bus::sendLogicalRead(PIFrame const& pi_frame, std::function<void(DatagramState const&)> const& error)
+    {
+        Link::DomainScope scope{*link_, Link::Domain::CYCLIC};
+
+        if (pi_frame.inputs.empty())
+        {
+            return; // outputs area
+        }
+
+        auto process = [this, pi_frame](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+        {
+            if (wkc != pi_frame.inputs.size())
+            {
+                DEBUG_PRINT("Invalid working counter\n");
+                return DatagramState::INVALID_WKC;
+            }
+
+            readInputs(pi_frame, data);
+            return DatagramState::OK;
+        };
+
+        link_->addDatagram(Command::LRD, pi_frame.address, nullptr, static_cast<uint16_t>(pi_frame.size), process, error);
+    }
+
+
+    void Bus::sendLogicalWrite(PIFrame const& pi_frame, std::function<void(DatagramState const&)> const& error)
+    {
+        Link::DomainScope scope{*link_, Link::Domain::CYCLIC};
+
+        if (pi_frame.outputs.empty())
+        {
+            return; // inputs area
+        }
+
+        uint8_t buffer[MAX_ETHERCAT_PAYLOAD_SIZE];
+        for (auto const& output : pi_frame.outputs)
+        {
+            std::memcpy(buffer + output.offset, output.iomap, output.size);
+        }
+
+        auto process = [pi_frame](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+        {
+            if (wkc != pi_frame.outputs.size())
+            {
+                DEBUG_PRINT("Invalid working counter\n");
+                return DatagramState::INVALID_WKC;
+            }
+            return DatagramState::OK;
+        };
+        link_->addDatagram(Command::LWR, pi_frame.address, buffer, static_cast<uint16_t>(pi_frame.size), process, error);
+    }
+
+
+    void Bus::sendLogicalReadWrite(PIFrame const& pi_frame, std::function<void(DatagramState const&)> const& error)
+    {
+        Link::DomainScope scope{*link_, Link::Domain::CYCLIC};
+
+        // split areas
+        if (pi_frame.outputs.empty())
+        {
+            sendLogicalRead(pi_frame, error);
+            return;
+        }
+        if (pi_frame.inputs.empty())
+        {
+            sendLogicalWrite(pi_frame, error);
+            return;
+        }
+
+        uint8_t buffer[MAX_ETHERCAT_PAYLOAD_SIZE];
+        for (auto const& output : pi_frame.outputs)
+        {
+            std::memcpy(buffer + output.offset, output.iomap, output.size);
+        }
+
+        auto process = [this, pi_frame](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+        {
+            if (wkc != pi_frame.inputs.size())
+            {
+                DEBUG_PRINT("Invalid working counter\n");
+                return DatagramState::INVALID_WKC;
+            }
+
+            readInputs(pi_frame, data);
+            return DatagramState::OK;
+        };
+
+        link_->addDatagram(Command::LRW, pi_frame.address, buffer, static_cast<uint16_t>(pi_frame.size), process, error);
+    }
+
 
-            link_->addDatagram(Command::LRD, pi_frame.address, nullptr, static_cast<uint16_t>(pi_frame.size), process, error);
+    void Bus::finalizeHigherPriority(PIFrame const& pi_frame, int32_t& priority)
+    {
+        if (pi_frame.priority < priority)
+        {
+            // the higher priority frames are sent on their own, before the next ones are even built
+            Link::DomainScope scope{*link_, Link::Domain::CYCLIC};
+            link_->finalizeDatagrams();
+        }
+        priority = pi_frame.priority;
+    }
+
+
+    void Bus::sendLogicalRead(std::function<void(DatagramState const&)> const& error)
+    {
+        int32_t priority = std::numeric_limits<int32_t>::min();
+        for (auto const& pi_frame : pi_frames_)
+        {
+            finalizeHigherPriority(pi_frame, priority);
+            sendLogicalRead(pi_frame, error);
+        }
+    }
+
+
+    void Bus::sendLogicalRead(int32_t group, std::function<void(DatagramState const&)> const& error)
+    {
+        int32_t priority = std::numeric_limits<int32_t>::min();
+        for (auto const& pi_frame : pi_frames_)
+        {
+            if (pi_frame.group == group)
+            {
+                finalizeHigherPriority(pi_frame, priority);
+                sendLogicalRead(pi_frame, error);
+            }
         }
     }
 
 
     void Bus::processDataRead(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::CYCLIC};
+
+        if (dc_reference_ != nullptr)
+        {
+            sendDriftCompensation(error);
+        }
         sendLogicalRead(error);
         link_->processDatagrams();
+        rethrowInputsHandlerError();
     }
 
 
     void Bus::sendLogicalWrite(std::function<void(DatagramState const&)> const& error)
     {
+        for (auto& stage : output_stages_)
+        {
+            pickStagedOutputs(stage);
+        }
+        int32_t priority = std::numeric_limits<int32_t>::min();
         for (auto const& pi_frame : pi_frames_)
         {
-            uint8_t buffer[MAX_ETHERCAT_PAYLOAD_SIZE];
-            for (auto const& output : pi_frame.outputs)
-            {
-                std::memcpy(buffer + output.offset, output.iomap, output.size);
-            }
+            finalizeHigherPriority(pi_frame, priority);
+            sendLogicalWrite(pi_frame, error);
+        }
+    }
+
 
-            auto process = [pi_frame](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+    void Bus::sendLogicalWrite(int32_t group, std::function<void(DatagramState const&)> const& error)
+    {
+        pickStagedOutputs(group);
+        int32_t priority = std::numeric_limits<int32_t>::min();
+        for (auto const& pi_frame : pi_frames_)
+        {
+            if (pi_frame.group == group)
             {
-                if (wkc != pi_frame.outputs.size())
-                {
-                    DEBUG_PRINT("Invalid working counter\n");
-                    return DatagramState::INVALID_WKC;
-                }
-                return DatagramState::OK;
-            };
-            link_->addDatagram(Command::LWR, pi_frame.address, buffer, static_cast<uint16_t>(pi_frame.size), process, error);
+                finalizeHigherPriority(pi_frame, priority);
+                sendLogicalWrite(pi_frame, error);
+            }
         }
     }
 
 
     void Bus::processDataWrite(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::CYCLIC};
+
+        if (dc_reference_ != nullptr)
+        {
+            sendDriftCompensation(error);
+        }
         sendLogicalWrite(error);
         link_->processDatagrams();
     }
@@ -492,37 +1117,45 @@ namespace kickcat
 
     void Bus::sendLogicalReadWrite(std::function<void(DatagramState const&)> const& error)
     {
+        for (auto& stage : output_stages_)
+        {
+            pickStagedOutputs(stage);
+        }
+        int32_t priority = std::numeric_limits<int32_t>::min();
         for (auto const& pi_frame : pi_frames_)
         {
-            uint8_t buffer[MAX_ETHERCAT_PAYLOAD_SIZE];
-            for (auto const& output : pi_frame.outputs)
-            {
-                std::memcpy(buffer + output.offset, output.iomap, output.size);
-            }
-
-            auto process = [pi_frame](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
-            {
-                if (wkc != pi_frame.inputs.size())
-                {
-                    DEBUG_PRINT("Invalid working counter\n");
-                    return DatagramState::INVALID_WKC;
-                }
+            finalizeHigherPriority(pi_frame, priority);
+            sendLogicalReadWrite(pi_frame, error);
+        }
+    }
 
-                for (auto& input : pi_frame.inputs)
-                {
-                    std::memcpy(input.iomap, data + input.offset, input.size);
-                }
-                return DatagramState::OK;
-            };
 
-            link_->addDatagram(Command::LRW, pi_frame.address, buffer, static_cast<uint16_t>(pi_frame.size), process, error);
+    void Bus::sendLogicalReadWrite(int32_t group, std::function<void(DatagramState const&)> const& error)
+    {
+        pickStagedOutputs(group);
+        int32_t priority = std::numeric_limits<int32_t>::min();
+        for (auto const& pi_frame : pi_frames_)
+        {
+            if (pi_frame.group == group)
+            {
+                finalizeHigherPriority(pi_frame, priority);
+                sendLogicalReadWrite(pi_frame, error);
+            }
         }
     }
 
+
     void Bus::processDataReadWrite(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::CYCLIC};
+
+        if (dc_reference_ != nullptr)
+        {
+            sendDriftCompensation(error);
+        }
         sendLogicalReadWrite(error);
         link_->processDatagrams();
+        rethrowInputsHandlerError();
     }
 
 
@@ -582,6 +1215,13 @@ namespace kickcat
             fmmu.length             = static_cast<uint16_t>(mapping.bsize);
             fmmu.logical_start_bit  = 0;   // we map every bits
             fmmu.logical_stop_bit   = 0x7; // we map every bits
+            if ((mapping_layout_ == MappingLayout::BIT_PACKED) and (mapping.size < 8))
+            {
+                // map only the used bits: the rest of the logical byte belongs to other slaves
+                fmmu.length            = static_cast<uint16_t>((mapping.bit_offset + mapping.size + 7) / 8);
+                fmmu.logical_start_bit = mapping.bit_offset;
+                fmmu.logical_stop_bit  = static_cast<uint8_t>((mapping.bit_offset + mapping.size - 1) % 8);
+            }
             fmmu.physical_address   = sii_sm->start_adress;
             fmmu.physical_start_bit = 0;
             fmmu.activate           = 1;
@@ -766,6 +1406,8 @@ namespace kickcat
 
     void Bus::sendMailboxesReadChecks(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::MAILBOX};
+
         auto isFull = [](uint8_t state, uint16_t wkc, bool stable_value)
         {
             if (wkc != 1)
@@ -794,6 +1436,8 @@ namespace kickcat
 
     void Bus::sendMailboxesWriteChecks(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::MAILBOX};
+
         auto isFull = [](uint8_t state, uint16_t wkc, bool stable_value)
         {
             if (wkc != 1)
@@ -822,14 +1466,30 @@ namespace kickcat
 
     void Bus::checkMailboxes(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::MAILBOX};
+
         sendMailboxesWriteChecks(error);
         sendMailboxesReadChecks(error);
         link_->processDatagrams();
     }
 
 
+    void Bus::checkMessagesTimeouts()
+    {
+        // answers of the previous exchange are already processed: what is still running past its deadline has timed out
+        nanoseconds now = since_epoch();
+        for (auto& slave : slaves_)
+        {
+            slave.mailbox.checkTimeouts(now);
+        }
+    }
+
+
     void Bus::sendWriteMessages(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::MAILBOX};
+        checkMessagesTimeouts();
+
         auto process = [](DatagramHeader const*, uint8_t const*, uint16_t wkc)
         {
             if (wkc != 1)
@@ -842,7 +1502,7 @@ namespace kickcat
 
         for (auto& slave : slaves_)
         {
-            if ((slave.mailbox.can_write) and (not slave.mailbox.to_send.empty()))
+            if ((slave.mailbox.can_write) and (slave.mailbox.hasMessageToSend()))
             {
                 // send one waiting message
                 auto message = slave.mailbox.send();
@@ -854,6 +1514,9 @@ namespace kickcat
 
     void Bus::sendReadMessages(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::MAILBOX};
+        checkMessagesTimeouts();
+
         Frame frame;
         for (auto& slave : slaves_)
         {
@@ -885,6 +1548,8 @@ namespace kickcat
 
     void Bus::processMessages(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::MAILBOX};
+
         sendWriteMessages(error);
         sendReadMessages(error);
         link_->processDatagrams();
@@ -900,13 +1565,14 @@ namespace kickcat
 
     void Bus::processAwaitingFrames()
     {
-        link_->processDatagrams();
+        link_->processAllDatagrams();
+        rethrowInputsHandlerError();
     }
 
 
     void Bus::finalizeDatagrams()
     {
-        link_->finalizeDatagrams();
+        link_->finalizeAllDatagrams();
     }
 
 
@@ -945,6 +1611,8 @@ namespace kickcat
 
     void Bus::sendRefreshErrorCounters(std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::DIAGNOSTICS};
+
         for (auto& slave : slaves_)
         {
             auto process = [&slave](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
@@ -965,6 +1633,8 @@ namespace kickcat
 
     void Bus::sendGetDLStatus(Slave& slave, std::function<void(DatagramState const&)> const& error)
     {
+        Link::DomainScope scope{*link_, Link::Domain::DIAGNOSTICS};
+
         auto process = [&slave](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
         {
             if (wkc != 1)
@@ -1,22 +1,40 @@
+#include <algorithm>
 #include <cstring>
 
 #include "Bus.h"
 
 namespace kickcat
 {
-    void Bus::waitForMessage(std::shared_ptr<AbstractMessage> message, nanoseconds timeout)
+    void Bus::waitForMessage(Slave& slave, std::shared_ptr<AbstractMessage> message, nanoseconds timeout)
     {
         auto error_callback = [](DatagramState const& state)
         {
             THROW_ERROR_DATAGRAM("error while checking mailboxes", state);
         };
         nanoseconds now = since_epoch();
+        nanoseconds backoff = 0ns;
 
         while (message->status() == MessageStatus::RUNNING)
         {
-            checkMailboxes(error_callback);
-            processMessages(error_callback);
-            sleep(tiny_wait);
+            if (message_wait_mode_ == MessageWaitMode::EVENT_DRIVEN)
+            {
+                if (exchangeMessages(slave, error_callback))
+                {
+                    backoff = 0ns;
+                }
+                else
+                {
+                    // nothing to do: wait a bit more each time, up to tiny_wait
+                    backoff = std::clamp(backoff * 2, tiny_wait / 16, tiny_wait);
+                    sleep(backoff);
+                }
+            }
+            else
+            {
+                checkMailboxes(error_callback);
+                processMessages(error_callback);
+                sleep(tiny_wait);
+            }
 
             if (elapsed_time(now) > timeout)
             {
@@ -26,12 +44,74 @@ namespace kickcat
     }
 
 
+    bool Bus::exchangeMessages(Slave& slave, std::function<void(DatagramState const&)> const& error)
+    {
+        Link::DomainScope scope{*link_, Link::Domain::MAILBOX};
+
+        Mailbox& mailbox = slave.mailbox;
+        bool progress = false;
+
+        if (mailbox.hasMessageToSend())
+        {
+            auto process_write = [&mailbox, &progress](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+            {
+                if (wkc == 1)
+                {
+                    // message written: move it to the processing queue
+                    mailbox.send();
+                    progress = true;
+                }
+                // otherwise the mailbox is full: message will be written on next exchange
+                return DatagramState::OK;
+            };
+
+            auto const& message = mailbox.nextToSend();
+            link_->addDatagram(Command::FPWR, createAddress(slave.address, mailbox.recv_offset), message->data(),
+                               static_cast<uint16_t>(message->size()), process_write, error);
+        }
+
+        auto process_read = [&slave, &progress](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+        {
+            if (wkc != 1)
+            {
+                return DatagramState::OK; // mailbox was empty
+            }
+
+            progress = true;
+            if (not slave.mailbox.receive(data))
+            {
+                DEBUG_PRINT("Slave %d: receive a message but didn't process it\n", slave.address);
+                return DatagramState::NO_HANDLER;
+            }
+            return DatagramState::OK;
+        };
+        link_->addDatagram(Command::FPRD, createAddress(slave.address, mailbox.send_offset), nullptr, mailbox.send_size, process_read, error);
+
+        // check after the read: tell if another message is already waiting
+        auto process_check = [&mailbox, &progress](DatagramHeader const*, uint8_t const* state, uint16_t wkc)
+        {
+            if (wkc != 1)
+            {
+                DEBUG_PRINT("Invalid working counter\n");
+                return DatagramState::INVALID_WKC;
+            }
+            mailbox.can_read = ((*state & 0x08) == 0x08);
+            progress |= mailbox.can_read;
+            return DatagramState::OK;
+        };
+        link_->addDatagram(Command::FPRD, createAddress(slave.address, reg::SYNC_MANAGER_1 + reg::SM_STATS), nullptr, 1, process_check, error);
+
+        link_->processDatagrams();
+        return progress;
+    }
+
+
     void Bus::readSDO(Slave& slave, uint16_t index, uint8_t subindex, Access CA, void* data, uint32_t* data_size, nanoseconds timeout)
     {
         if ((CA == Access::PARTIAL) or (CA == Access::COMPLETE))
         {
             auto sdo = slave.mailbox.createSDO(index, subindex, CA, CoE::SDO::request::UPLOAD, data, data_size);
-            waitForMessage(sdo, timeout);
+            waitForMessage(slave, sdo, timeout);
             return;
         }
 
@@ -39,7 +119,7 @@ namespace kickcat
         int32_t object_size = 0;
         uint32_t size = sizeof(object_size);
         auto sdo = slave.mailbox.createSDO(index, 0, false, CoE::SDO::request::UPLOAD, &object_size, &size);
-        waitForMessage(sdo, timeout);
+        waitForMessage(slave, sdo, timeout);
 
         uint8_t* pos = reinterpret_cast<uint8_t*>(data);
         size = *data_size;
@@ -53,7 +133,7 @@ namespace kickcat
             }
 
             sdo = slave.mailbox.createSDO(index, i, false, CoE::SDO::request::UPLOAD, pos, &size);
-            waitForMessage(sdo, timeout);
+            waitForMessage(slave, sdo, timeout);
 
             if (sdo->status() != MessageStatus::SUCCESS)
             {
@@ -71,6 +151,118 @@ namespace kickcat
     void Bus::writeSDO(Slave& slave, uint16_t index, uint8_t subindex, bool CA, void* data, uint32_t data_size, nanoseconds timeout)
     {
         auto sdo = slave.mailbox.createSDO(index, subindex, CA, CoE::SDO::request::DOWNLOAD, data, &data_size);
-        waitForMessage(sdo, timeout);
+        waitForMessage(slave, sdo, timeout);
+    }
+
+
+    void Bus::readSDO(Slave& slave, uint16_t index, uint8_t subindex, bool CA, SDOReader const& reader, nanoseconds timeout)
+    {
+        auto sdo = slave.mailbox.createSDOUpload(index, subindex, CA, reader);
+        waitForMessage(slave, sdo, timeout);
+    }
+
+
+    void Bus::writeSDO(Slave& slave, uint16_t index, uint8_t subindex, bool CA, uint32_t size, SDOWriter const& writer, nanoseconds timeout)
+    {
+        auto sdo = slave.mailbox.createSDODownload(index, subindex, CA, size, writer);
+        waitForMessage(slave, sdo, timeout);
+    }
+
+
+    std::shared_ptr<AbstractMessage> Bus::readSDOAsync(Slave& slave, uint16_t index, uint8_t subindex, Access CA, void* data, uint32_t* data_size,
+                                                       std::function<void(AbstractMessage const&)> const& callback, nanoseconds timeout)
+    {
+        if (CA == Access::EMULATE_COMPLETE)
+        {
+            THROW_ERROR("Emulated complete access is not supported by asynchronous SDO");
+        }
+
+        auto sdo = slave.mailbox.createSDO(index, subindex, CA, CoE::SDO::request::UPLOAD, data, data_size);
+        sdo->setCallback(callback);
+        sdo->setDeadline(since_epoch() + timeout);
+        return sdo;
+    }
+
+
+    std::shared_ptr<AbstractMessage> Bus::writeSDOAsync(Slave& slave, uint16_t index, uint8_t subindex, bool CA, void* data, uint32_t* data_size,
+                                                        std::function<void(AbstractMessage const&)> const& callback, nanoseconds timeout)
+    {
+        auto sdo = slave.mailbox.createSDO(index, subindex, CA, CoE::SDO::request::DOWNLOAD, data, data_size);
+        sdo->setCallback(callback);
+        sdo->setDeadline(since_epoch() + timeout);
+        return sdo;
+    }
+
+
+    void Bus::startObjectUpload(ObjectUpload& upload, Slave& slave, uint16_t index, bool complete_access)
+    {
+        upload.slave = &slave;
+        upload.index = index;
+        upload.complete_access = complete_access;
+        upload.entries = 0;
+        upload.subindex = 0;
+        upload.size = 0;
+        upload.since = since_epoch();
+
+        if (complete_access)
+        {
+            // subindex 0 is included in the answer (padded on 16 bits)
+            upload.chunk_size = sizeof(upload.data);
+            upload.sdo = slave.mailbox.createSDO(index, 0, true, CoE::SDO::request::UPLOAD, upload.data, &upload.chunk_size);
+            return;
+        }
+
+        upload.chunk_size = sizeof(upload.entries);
+        upload.sdo = slave.mailbox.createSDO(index, 0, false, CoE::SDO::request::UPLOAD, &upload.entries, &upload.chunk_size);
+    }
+
+
+    bool Bus::processObjectUpload(ObjectUpload& upload, nanoseconds timeout)
+    {
+        if (upload.sdo->status() == MessageStatus::RUNNING)
+        {
+            if (elapsed_time(upload.since) > timeout)
+            {
+                THROW_ERROR("Error while reading SDO - Timeout");
+            }
+            return false;
+        }
+
+        if (upload.sdo->status() != MessageStatus::SUCCESS)
+        {
+            THROW_ERROR("Error while reading SDO - object upload");
+        }
+
+        if (upload.complete_access)
+        {
+            constexpr uint32_t SUBINDEX_0_SIZE = 2;
+            if (upload.chunk_size < SUBINDEX_0_SIZE)
+            {
+                THROW_ERROR("Error while reading SDO - complete access answer too small");
+            }
+            upload.entries = upload.data[0];
+            upload.size = upload.chunk_size - SUBINDEX_0_SIZE;
+            std::memmove(upload.data, upload.data + SUBINDEX_0_SIZE, upload.size);
+            return true;
+        }
+
+        // emulated complete access: upload.entries is valid since the subindex 0 is the first one to be read
+        upload.size += (upload.subindex == 0) ? 0 : upload.chunk_size;
+        if (upload.subindex >= upload.entries)
+        {
+            return true;
+        }
+
+        upload.chunk_size = static_cast<uint32_t>(sizeof(upload.data)) - upload.size;
+        if (upload.chunk_size == 0)
+        {
+            THROW_ERROR("Error while reading SDO - client buffer too small");
+        }
+
+        ++upload.subindex;
+        upload.since = since_epoch();
+        upload.sdo = upload.slave->mailbox.createSDO(upload.index, upload.subindex, false, CoE::SDO::request::UPLOAD,
+                                                     upload.data + upload.size, &upload.chunk_size);
+        return false;
     }
 }
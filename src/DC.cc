@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Bus.h"
+#include "DC.h"
+#include "Diagnostics.h"
+
+namespace kickcat
+{
+    void Bus::initDistributedClocks(int32_t drift_frames)
+    {
+        auto error = [](DatagramState const& state)
+        {
+            THROW_ERROR_DATAGRAM("error while initializing distributed clocks", state);
+        };
+        auto check_wkc = [](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+        {
+            if (wkc != 1)
+            {
+                return DatagramState::INVALID_WKC;
+            }
+            return DatagramState::OK;
+        };
+
+        // DC capability and ports state
+        for (auto& slave : slaves_)
+        {
+            auto process = [&slave](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            {
+                if (wkc != 1)
+                {
+                    return DatagramState::INVALID_WKC;
+                }
+                uint16_t features = *reinterpret_cast<uint16_t const*>(data);
+                slave.dc.supported = (features & 0x4); // DC available
+                return DatagramState::OK;
+            };
+            link_->addDatagram(Command::FPRD, createAddress(slave.address, reg::ESC_FEATURES), nullptr, 2, process, error);
+            sendGetDLStatus(slave, error);
+        }
+        link_->processDatagrams();
+
+        dc_reference_ = nullptr;
+        for (auto& slave : slaves_)
+        {
+            if (slave.dc.supported)
+            {
+                dc_reference_ = &slave;
+                break;
+            }
+        }
+        if (dc_reference_ == nullptr)
+        {
+            DEBUG_PRINT("No slave supports distributed clocks\n");
+            return;
+        }
+
+        // latch ports receive times on every slave at once
+        uint32_t latch = 0;
+        broadcastWrite(reg::DC_TIME, &latch, sizeof(latch));
+
+        for (auto& slave : slaves_)
+        {
+            if (not slave.dc.supported)
+            {
+                continue;
+            }
+
+            auto process_ports = [&slave](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            {
+                if (wkc != 1)
+                {
+                    return DatagramState::INVALID_WKC;
+                }
+                std::memcpy(slave.dc.receive_time, data, sizeof(slave.dc.receive_time));
+                return DatagramState::OK;
+            };
+            auto process_local = [&slave](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            {
+                if (wkc != 1)
+                {
+                    return DatagramState::INVALID_WKC;
+                }
+                std::memcpy(&slave.dc.local_time, data, sizeof(slave.dc.local_time));
+                return DatagramState::OK;
+            };
+            link_->addDatagram(Command::FPRD, createAddress(slave.address, reg::DC_TIME), nullptr,
+                               sizeof(slave.dc.receive_time), process_ports, error);
+            link_->addDatagram(Command::FPRD, createAddress(slave.address, reg::DC_RECEIVE_TIME_PU), nullptr,
+                               sizeof(slave.dc.local_time), process_local, error);
+        }
+        link_->processDatagrams();
+
+        computePropagationDelays(slaves_);
+
+        // align every system time on the master time, minus the propagation delay from the reference clock
+        uint64_t const master_time = static_cast<uint64_t>((since_epoch() - DC_EPOCH_OFFSET).count());
+        for (auto& slave : slaves_)
+        {
+            if (not slave.dc.supported)
+            {
+                continue;
+            }
+
+            slave.dc.delay -= dc_reference_->dc.delay;
+            slave.dc.offset = static_cast<int64_t>(master_time - slave.dc.local_time);
+
+            link_->addDatagram(Command::FPWR, createAddress(slave.address, reg::DC_SYSTEM_OFFSET), &slave.dc.offset,
+                               sizeof(slave.dc.offset), check_wkc, error);
+            link_->addDatagram(Command::FPWR, createAddress(slave.address, reg::DC_SYSTEM_DELAY), &slave.dc.delay,
+                               sizeof(slave.dc.delay), check_wkc, error);
+        }
+        link_->processDatagrams();
+
+        // static drift compensation: distribute the reference clock system time (read then written on the next slaves)
+        auto drift_error = [](DatagramState const&)
+        {
+            DEBUG_PRINT("Drift compensation frame lost\n");
+        };
+        auto drift_process = [](DatagramHeader const*, uint8_t const*, uint16_t)
+        {
+            return DatagramState::OK;
+        };
+        for (int32_t i = 0; i < drift_frames; ++i)
+        {
+            link_->addDatagram(Command::FRMW, createAddress(dc_reference_->address, reg::DC_SYSTEM_TIME), nullptr, 8,
+                               drift_process, drift_error);
+            if ((i % MAX_ETHERCAT_DATAGRAMS) == (MAX_ETHERCAT_DATAGRAMS - 1))
+            {
+                link_->processDatagrams();
+            }
+        }
+        link_->processDatagrams();
+    }
+
+
+    void Bus::configureSync(Slave& slave, nanoseconds sync0_cycle, nanoseconds sync1_cycle, nanoseconds shift)
+    {
+        if (not slave.dc.supported)
+        {
+            THROW_ERROR("Slave does not support distributed clocks");
+        }
+        if (sync0_cycle <= 0ns)
+        {
+            THROW_ERROR("Invalid SYNC0 cycle");
+        }
+
+        auto error = [](DatagramState const& state)
+        {
+            THROW_ERROR_DATAGRAM("error while configuring SYNC signals", state);
+        };
+        auto check_wkc = [](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+        {
+            if (wkc != 1)
+            {
+                return DatagramState::INVALID_WKC;
+            }
+            return DatagramState::OK;
+        };
+
+        // stop sync signals, let EtherCAT drive the sync unit, then get the slave system time to compute the start time
+        uint8_t  activation = 0;
+        uint64_t system_time = 0;
+        auto process_time = [&system_time](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+        {
+            if (wkc != 1)
+            {
+                return DatagramState::INVALID_WKC;
+            }
+            std::memcpy(&system_time, data, sizeof(system_time));
+            return DatagramState::OK;
+        };
+        link_->addDatagram(Command::FPWR, createAddress(slave.address, reg::DC_SYNC_ACTIVATION), &activation, 1, check_wkc, error);
+        link_->addDatagram(Command::FPWR, createAddress(slave.address, reg::DC_CYCLIC_CONTROL),  &activation, 1, check_wkc, error);
+        link_->addDatagram(Command::FPRD, createAddress(slave.address, reg::DC_SYSTEM_TIME), nullptr, sizeof(system_time), process_time, error);
+        link_->processDatagrams();
+
+        // first pulse on a cycle boundary, far enough to be configured before it happens
+        constexpr nanoseconds START_DELAY = 100ms;
+        uint64_t const cycle = static_cast<uint64_t>(sync0_cycle.count());
+        uint64_t start_time = ((system_time + START_DELAY.count()) / cycle) * cycle + shift.count();
+        uint32_t sync0 = static_cast<uint32_t>(sync0_cycle.count());
+        uint32_t sync1 = static_cast<uint32_t>(sync1_cycle.count());
+
+        activation = 0x03; // cyclic operation + SYNC0
+        if (sync1_cycle > 0ns)
+        {
+            activation |= 0x04; // SYNC1
+        }
+
+        link_->addDatagram(Command::FPWR, createAddress(slave.address, reg::DC_START_TIME),  &start_time, sizeof(start_time), check_wkc, error);
+        link_->addDatagram(Command::FPWR, createAddress(slave.address, reg::DC_SYNC0_CYCLE), &sync0,      sizeof(sync0),      check_wkc, error);
+        link_->addDatagram(Command::FPWR, createAddress(slave.address, reg::DC_SYNC1_CYCLE), &sync1,      sizeof(sync1),      check_wkc, error);
+        link_->addDatagram(Command::FPWR, createAddress(slave.address, reg::DC_SYNC_ACTIVATION), &activation, 1, check_wkc, error);
+        link_->processDatagrams();
+    }
+
+
+    void Bus::sendDriftCompensation(std::function<void(DatagramState const&)> const& error)
+    {
+        Link::DomainScope scope{*link_, Link::Domain::CYCLIC};
+
+        if (dc_reference_ == nullptr)
+        {
+            THROW_ERROR("Distributed clocks are not initialized");
+        }
+
+        auto process = [this](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+        {
+            if (wkc == 0)
+            {
+                return DatagramState::INVALID_WKC; // reference clock not reached
+            }
+            std::memcpy(&dc_system_time_, data, sizeof(dc_system_time_));
+            return DatagramState::OK;
+        };
+        link_->addDatagram(Command::FRMW, createAddress(dc_reference_->address, reg::DC_SYSTEM_TIME), nullptr,
+                           sizeof(dc_system_time_), process, error);
+    }
+
+
+    MasterClockSteering::MasterClockSteering(nanoseconds cycle, nanoseconds shift, nanoseconds lead, double kp, double ki)
+        : cycle_{cycle.count()}
+        , shift_{shift.count()}
+        , lead_{lead.count()}
+        , kp_{kp}
+        , ki_{ki}
+    {
+        if (cycle_ <= 0)
+        {
+            THROW_ERROR("Invalid cycle");
+        }
+    }
+
+
+    nanoseconds MasterClockSteering::update(uint64_t reference_time, nanoseconds master_time)
+    {
+        // offset variation statistics (exponentially weighted, ~16 cycles window): clocks drift is removed by the mean
+        constexpr double ALPHA = 1.0 / 16.0;
+        int64_t previous_offset = offset_;
+        offset_ = (master_time - DC_EPOCH_OFFSET).count() - static_cast<int64_t>(reference_time);
+        if (samples_ > 0)
+        {
+            double variation = static_cast<double>(offset_ - previous_offset);
+            if (samples_ == 1)
+            {
+                variation_mean_ = variation;
+            }
+            double deviation = variation - variation_mean_;
+            variation_mean_ += ALPHA * deviation;
+            variation_variance_ = (1.0 - ALPHA) * (variation_variance_ + ALPHA * deviation * deviation);
+        }
+        ++samples_;
+
+        // position of the frame in the SYNC0 cycle: 0 when it arrives on the pulse
+        int64_t phase = static_cast<int64_t>((reference_time - static_cast<uint64_t>(shift_)) % static_cast<uint64_t>(cycle_));
+        phase_error_ = phase - (cycle_ - lead_);
+        if (phase_error_ >= cycle_ / 2)
+        {
+            phase_error_ -= cycle_;
+        }
+        else if (phase_error_ < -cycle_ / 2)
+        {
+            phase_error_ += cycle_;
+        }
+
+        // anti windup: the integral term alone shall not correct more than a tenth of a cycle
+        double const max_correction = static_cast<double>(cycle_) / 10.0;
+        integral_ += static_cast<double>(phase_error_);
+        if (ki_ > 0)
+        {
+            integral_ = std::clamp(integral_, -max_correction / ki_, max_correction / ki_);
+        }
+
+        double correction = -(kp_ * static_cast<double>(phase_error_) + ki_ * integral_);
+        correction = std::clamp(correction, -max_correction, max_correction);
+        return nanoseconds(static_cast<int64_t>(correction));
+    }
+
+
+    nanoseconds MasterClockSteering::jitter() const
+    {
+        return nanoseconds(static_cast<int64_t>(std::sqrt(variation_variance_)));
+    }
+}
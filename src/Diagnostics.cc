@@ -1,6 +1,7 @@
 #include "Diagnostics.h"
 #include "Error.h"
 
+#include <algorithm>
 #include <unordered_map>
 #include <cstdio>
 #include <stack>
@@ -55,4 +56,113 @@ namespace kickcat
         }
         return topology;
     }
+
+
+    namespace
+    {
+        // open ports of a slave, in frame processing order
+        std::vector<int> openPorts(Slave const& slave)
+        {
+            std::vector<int> ports;
+            if (slave.dl_status.PL_port0) { ports.push_back(0); }
+            if (slave.dl_status.PL_port3) { ports.push_back(3); }
+            if (slave.dl_status.PL_port1) { ports.push_back(1); }
+            if (slave.dl_status.PL_port2) { ports.push_back(2); }
+            return ports;
+        }
+
+        int32_t elapsed(uint32_t from, uint32_t to)
+        {
+            return static_cast<int32_t>(to - from); // 32 bits receive times may wrap around
+        }
+    }
+
+
+    void computePropagationDelays(std::vector<Slave>& slaves)
+    {
+        auto topology = getTopology(slaves);
+
+        // Ports receive times of the closest DC ancestor that enclose the branch of a slave. Only slaves with DC latch
+        // receive times: through a non DC slave with other branches, the window also covers them and becomes unusable.
+        struct Window
+        {
+            Slave* ancestor{nullptr};
+            int from;
+            int to;
+        };
+
+        std::unordered_map<uint16_t, Slave*> by_address;
+        std::unordered_map<uint16_t, int> children; // children already processed per slave
+        std::unordered_map<uint16_t, Window> windows;
+        for (auto& slave : slaves)
+        {
+            by_address[slave.address] = &slave;
+        }
+
+        for (auto& slave : slaves)
+        {
+            uint16_t parent_address = topology[slave.address];
+            if (parent_address == slave.address)
+            {
+                slave.dc.delay = 0; // first slave: reference
+                continue;
+            }
+
+            Slave& parent = *by_address.at(parent_address);
+            std::vector<int> parent_ports = openPorts(parent);
+            int rank = ++children[parent_address]; // port 0 is the entry port: children start at rank 1
+            if (rank >= static_cast<int>(parent_ports.size()))
+            {
+                THROW_ERROR("Topology is not coherent with open ports");
+            }
+
+            Window window;
+            if (parent.dc.supported)
+            {
+                window = {&parent, parent_ports[rank - 1], parent_ports[rank]};
+            }
+            else if (parent_ports.size() == 2)
+            {
+                window = windows[parent_address]; // line through a non DC slave: same branch
+            }
+            windows[slave.address] = window;
+
+            if ((not slave.dc.supported) or (window.ancestor == nullptr))
+            {
+                // nothing latched (or no usable reference): propagate the parent delay
+                slave.dc.delay = parent.dc.delay;
+                continue;
+            }
+
+            // time spent by the frame in the child branch, seen by the ancestor
+            Slave const& ancestor = *window.ancestor;
+            int32_t branch = elapsed(ancestor.dc.receive_time[window.from], ancestor.dc.receive_time[window.to]);
+
+            // time spent by the frame inside the child branch, seen by the child
+            std::vector<int> ports = openPorts(slave);
+            int32_t inner = elapsed(slave.dc.receive_time[0], slave.dc.receive_time[ports.back()]);
+
+            slave.dc.delay = ancestor.dc.delay + (branch - inner) / 2;
+        }
+    }
+
+
+    CycleTimeEstimate estimateCycleTime(std::vector<uint16_t> const& datagrams_data_size, std::vector<Slave>& slaves,
+                                        nanoseconds cycle, CycleTimeModel const& model)
+    {
+        CycleTimeEstimate estimate;
+        estimate.wire = computeWireUsage(datagrams_data_size);
+
+        // every slave has one link to its parent (or to the master), each link is crossed twice
+        estimate.propagation = 0ns;
+        for (auto& slave : slaves)
+        {
+            int passes = std::max(1, slave.countOpenPorts()); // last slave of a line loops back its single port
+            estimate.propagation += passes * model.port_delay + 2 * model.cable_delay;
+        }
+
+        estimate.minimum_cycle = estimate.wire.time + estimate.propagation + model.master_overhead;
+        estimate.headroom = cycle - estimate.minimum_cycle;
+        return estimate;
+    }
 }
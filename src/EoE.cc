@@ -0,0 +1,56 @@
+#include <algorithm>
+
+#include "EoE.h"
+
+namespace kickcat
+{
+    EoEBridge::EoEBridge(std::shared_ptr<AbstractSocket> interface, Mailbox& mailbox)
+        : interface_{interface}
+        , mailbox_{mailbox}
+    {
+        mailbox_.eoe_handler = [this](uint8_t const* frame, int32_t frame_size)
+        {
+            if (interface_->write(frame, frame_size) != frame_size)
+            {
+                DEBUG_PRINT("Cannot forward EoE frame to the local interface\n");
+                return;
+            }
+            frames_received_++;
+        };
+    }
+
+
+    EoEBridge::~EoEBridge()
+    {
+        mailbox_.eoe_handler = nullptr;
+    }
+
+
+    void EoEBridge::process()
+    {
+        credit_ = std::min(credit_ + budget_, std::max(budget_, ETH_MAX_SIZE));
+
+        while (true)
+        {
+            if (pending_size_ == 0)
+            {
+                int32_t read_size = interface_->read(pending_.data(), static_cast<int32_t>(pending_.size()));
+                if (read_size <= 0)
+                {
+                    return;
+                }
+                pending_size_ = read_size;
+            }
+
+            if (pending_size_ > credit_)
+            {
+                return; // wait for the next cycles
+            }
+
+            mailbox_.createEoE(pending_.data(), pending_size_);
+            credit_ -= pending_size_;
+            pending_size_ = 0;
+            frames_sent_++;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+
+#include "Bus.h"
+
+namespace kickcat
+{
+    void Bus::readFoE(Slave& slave, std::string_view filename, uint32_t password, FoEReader const& reader, nanoseconds timeout)
+    {
+        auto foe = slave.mailbox.createFoERead(filename, password, reader);
+        waitForMessage(slave, foe, timeout);
+
+        if (foe->status() != MessageStatus::SUCCESS)
+        {
+            THROW_ERROR("Error while reading file with FoE");
+        }
+    }
+
+
+    void Bus::writeFoE(Slave& slave, std::string_view filename, uint32_t password, uint32_t size, FoEWriter const& writer, nanoseconds timeout)
+    {
+        auto foe = slave.mailbox.createFoEWrite(filename, password, size, writer);
+        waitForMessage(slave, foe, timeout);
+
+        if (foe->status() != MessageStatus::SUCCESS)
+        {
+            THROW_ERROR("Error while writing file with FoE");
+        }
+    }
+
+
+    std::shared_ptr<AbstractMessage> Bus::readFoEAsync(Slave& slave, std::string_view filename, uint32_t password, FoEReader const& reader,
+                                                       std::function<void(AbstractMessage const&)> const& callback)
+    {
+        auto foe = slave.mailbox.createFoERead(filename, password, reader);
+        foe->setCallback(callback);
+        return foe;
+    }
+
+
+    std::shared_ptr<AbstractMessage> Bus::writeFoEAsync(Slave& slave, std::string_view filename, uint32_t password, uint32_t size, FoEWriter const& writer,
+                                                        std::function<void(AbstractMessage const&)> const& callback)
+    {
+        auto foe = slave.mailbox.createFoEWrite(filename, password, size, writer);
+        foe->setCallback(callback);
+        return foe;
+    }
+
+
+    void Bus::waitForMessages(std::vector<std::shared_ptr<AbstractMessage>> const& messages, nanoseconds timeout)
+    {
+        auto error_callback = [](DatagramState const& state)
+        {
+            THROW_ERROR_DATAGRAM("error while checking mailboxes", state);
+        };
+        auto is_running = [](std::shared_ptr<AbstractMessage> const& message)
+        {
+            return message->status() == MessageStatus::RUNNING;
+        };
+
+        nanoseconds now = since_epoch();
+        while (std::any_of(messages.begin(), messages.end(), is_running))
+        {
+            checkMailboxes(error_callback);
+            processMessages(error_callback);
+
+            if (elapsed_time(now) > timeout)
+            {
+                THROW_ERROR("Error while waiting for messages - Timeout");
+            }
+            sleep(tiny_wait);
+        }
+    }
+}
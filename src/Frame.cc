@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 
 #include "Frame.h"
@@ -81,7 +82,8 @@ namespace kickcat
     }
 
 
-    void Frame::addDatagram(uint8_t index, enum Command command, uint32_t address, void const* data, uint16_t data_size)
+    void Frame::addDatagram(uint8_t index, enum Command command, uint32_t address, void const* data, uint16_t data_size,
+                            uint16_t irq)
     {
         DatagramHeader* header = reinterpret_cast<DatagramHeader*>(next_datagram_);
         uint8_t* pos = next_datagram_;
@@ -92,7 +94,7 @@ namespace kickcat
         header->len = data_size & 0x7ff;
         header->circulating = 0;
         header->multiple = 1;   // by default, consider that more datagrams will follow
-        header->IRQ = 0;        //TODO what's that ?
+        header->IRQ = irq;
 
         pos += sizeof(DatagramHeader);
 
@@ -105,8 +107,10 @@ namespace kickcat
                 case Command::APRD:
                 case Command::FPRD:
                 case Command::LRD:
+                case Command::ARMW:
+                case Command::FRMW:
                 {
-                    // no-op or read only command: clear the area
+                    // no-op or read only command (read multiple write is filled by the addressed slave): clear the area
                     std::memset(pos, 0, data_size);
                     break;
                 }
@@ -190,6 +194,45 @@ namespace kickcat
     }
 
 
+    WireUsage computeWireUsage(std::vector<uint16_t> const& datagrams_data_size)
+    {
+        WireUsage usage{0, 0, 0ns};
+
+        int32_t frame_datagrams = 0;
+        int32_t frame_free = 0;
+        int32_t frame_len = 0;
+        auto close_frame = [&]()
+        {
+            if (frame_datagrams == 0)
+            {
+                return;
+            }
+            int32_t size = std::max<int32_t>(sizeof(EthernetHeader) + sizeof(EthercatHeader) + frame_len, ETH_MIN_SIZE);
+            usage.frames += 1;
+            usage.bytes  += ETH_PREAMBLE_SIZE + size + ETH_FCS_SIZE + ETH_IFG_SIZE;
+            frame_datagrams = 0;
+        };
+
+        for (uint16_t data_size : datagrams_data_size)
+        {
+            int32_t needed = datagram_size(data_size);
+            if ((frame_datagrams == 0) or (frame_datagrams >= MAX_ETHERCAT_DATAGRAMS) or (frame_free < needed))
+            {
+                close_frame();
+                frame_free = ETH_MTU_SIZE - sizeof(EthercatHeader);
+                frame_len  = 0;
+            }
+            frame_datagrams += 1;
+            frame_free -= needed;
+            frame_len  += needed;
+        }
+        close_frame();
+
+        usage.time = usage.bytes * ETH_BYTE_TIME;
+        return usage;
+    }
+
+
     int32_t readFrame(std::shared_ptr<AbstractSocket> socket, Frame& frame)
     {
         int32_t read = socket->read(frame.data(), ETH_MAX_SIZE);
@@ -3,10 +3,36 @@
 #include "AbstractSocket.h"
 #include "Error.h"
 
+#include <algorithm>
+#include <cstring>
 #include <functional>
 
 namespace kickcat
 {
+    namespace
+    {
+        // OR the copy of a datagram received on the other interface into the reference one.
+        // Word-wise so that the compiler vectorises it: process data datagrams may be up to a full frame long.
+        void mergeDatagramData(uint8_t* reference, uint8_t const* copy, int32_t size)
+        {
+            int32_t i = 0;
+            for (; (i + 8) <= size; i += 8)
+            {
+                uint64_t word_reference;
+                uint64_t word_copy;
+                std::memcpy(&word_reference, reference + i, sizeof(uint64_t));
+                std::memcpy(&word_copy,      copy + i,      sizeof(uint64_t));
+                word_reference |= word_copy;
+                std::memcpy(reference + i, &word_reference, sizeof(uint64_t));
+            }
+            for (; i < size; ++i)
+            {
+                reference[i] |= copy[i];
+            }
+        }
+    }
+
+
     Link::Link(std::shared_ptr<AbstractSocket> socket_nominal,
                                    std::shared_ptr<AbstractSocket> socket_redundancy,
                                    std::function<void(void)> const& redundancyActivatedCallback,
@@ -21,62 +47,474 @@ namespace kickcat
     }
 
 
+    Link::Link(std::shared_ptr<AbstractSocket> socket_nominal, MAC const src_nominal)
+        : redundancyActivatedCallback_([](){})
+        , socket_nominal_(socket_nominal)
+        , is_redundant_(false)
+    {
+        std::copy(src_nominal, src_nominal + MAC_SIZE, src_nominal_);
+        std::copy(SECONDARY_IF_MAC, SECONDARY_IF_MAC + MAC_SIZE, src_redundancy_);
+    }
+
+
+    void Link::configureDomains(std::array<int32_t, DOMAINS> const& sizes)
+    {
+        for (int32_t i = 0; i < contexts_count_; ++i)
+        {
+            DomainContext const& context = contexts_[i];
+            if ((context.queue != context.head) or (context.frame.datagramCounter() != 0) or context.is_transaction_open)
+            {
+                THROW_ERROR("Cannot configure domains while datagrams are in flight");
+            }
+        }
+
+        int32_t total = 0;
+        for (int32_t size : sizes)
+        {
+            if (size < 2)
+            {
+                THROW_ERROR("A domain needs at least two indexes");
+            }
+            total += size;
+        }
+        if (total > 256)
+        {
+            THROW_ERROR("Domains cannot use more than 256 indexes");
+        }
+
+        int32_t first = 0;
+        for (int32_t i = 0; i < DOMAINS; ++i)
+        {
+            DomainContext& context = contexts_[i];
+            context.first = static_cast<uint8_t>(first);
+            context.size  = sizes[i];
+            context.queue = context.first;
+            context.head  = context.first;
+            for (int32_t index = first; index < (first + sizes[i]); ++index)
+            {
+                index_context_[index] = static_cast<uint8_t>(i);
+            }
+            domain_context_[i] = i;
+            first += sizes[i];
+        }
+        contexts_count_ = DOMAINS;
+    }
+
+
+    uint8_t Link::DomainContext::next(uint8_t index, int32_t n) const
+    {
+        int32_t offset = ((index - first + n) % size + size) % size;
+        return static_cast<uint8_t>(first + offset);
+    }
+
+
+    template<typename F>
+    void Link::forEachDomain(F apply)
+    {
+        // contexts follow the Domain order: cyclic first
+        for (int32_t i = 0; i < contexts_count_; ++i)
+        {
+            apply(contexts_[i]);
+        }
+    }
+
+
     void Link::addDatagram(enum Command command, uint32_t address, void const* data, uint16_t data_size,
                                std::function<DatagramState(DatagramHeader const*, uint8_t const* data, uint16_t wkc)> const& process,
                                std::function<void(DatagramState const& state)> const& error)
     {
-        if (index_queue_ == static_cast<uint8_t>(index_head_ + 1))
+        DomainContext& context = current();
+        if (context.is_transaction_open)
+        {
+            THROW_ERROR("Cannot add a datagram while a transaction is in progress");
+        }
+        if (context.queue == context.next(context.head))
         {
             THROW_ERROR("Too many datagrams in flight. Max is 255");
         }
 
         uint16_t const needed_space = datagram_size(data_size);
-        if (frame_nominal_.freeSpace() < needed_space)
+        if (context.frame.freeSpace() < needed_space)
         {
-            sendFrame();
+            sendFrame(context);
         }
 
-        addDatagramToFrame(index_head_, command, address, data, data_size);
-        callbacks_[index_head_].process = process;
-        callbacks_[index_head_].error = error;
-        callbacks_[index_head_].status = DatagramState::LOST;
-        ++index_head_;
+        uint8_t const index = context.head;
+        context.frame.addDatagram(index, command, address, data, data_size, static_cast<uint16_t>(context.generation));
+        callbacks_[index].process = process;
+        callbacks_[index].error = error;
+        callbacks_[index].status = DatagramState::LOST;
+        callbacks_[index].generation = context.generation;
+        callbacks_[index].command = command;
+        callbacks_[index].size = data_size;
+        context.head = context.next(index);
+
+        if ((command == Command::LRD) or (command == Command::LWR) or (command == Command::LRW))
+        {
+            context.traffic = TrafficClass::CYCLIC;
+        }
 
-        if (frame_nominal_.isFull())
+        if (context.frame.isFull())
         {
-            sendFrame();
+            sendFrame(context);
         }
     }
 
 
     void Link::finalizeDatagrams()
     {
-        if (frame_nominal_.datagramCounter() != 0)
+        DomainContext& context = current();
+        if (context.frame.datagramCounter() != 0)
         {
-            sendFrame();
+            sendFrame(context);
         }
     }
 
 
+    void Link::finalizeAllDatagrams()
+    {
+        forEachDomain([this](DomainContext& context)
+        {
+            if (context.frame.datagramCounter() != 0)
+            {
+                sendFrame(context);
+            }
+        });
+    }
+
+
     void Link::processDatagrams()
     {
-        finalizeDatagrams();
+        DomainContext& context = current();
+        beginTransaction(context);
+
+        nanoseconds const read_timeout = timeout(context.traffic);
+
+        // The adaptive timeout is derived from round trips measured from the send time: frames are expected by then.
+        nanoseconds const expected_by = context.sent_at + read_timeout;
+        auto remaining = [](nanoseconds deadline)
+        {
+            return std::max(deadline - since_epoch(), nanoseconds{0});
+        };
+
+        int32_t to_read = context.pending_frames;
+        while ((to_read > 0) and (isWaitingFor(context, Side::NOMINAL) or isWaitingFor(context, Side::REDUNDANCY)))
+        {
+            --to_read;
+
+            auto isOther = [](ReadStatus status)
+            {
+                return (status == ReadStatus::LATE) or (status == ReadStatus::OTHER);
+            };
+
+            bool is_other = false;
+            if (is_redundant_)
+            {
+                // Both interfaces share the same deadline.
+                nanoseconds deadline = since_epoch() + read_timeout;
+                nanoseconds first_timeout = read_timeout;
+                if (adaptive_timeout_)
+                {
+                    deadline = expected_by;
+                    first_timeout = remaining(deadline);
+                }
+                // A side that already got all its frames is not read: it would only wait for the timeout.
+                if (isWaitingFor(context, Side::REDUNDANCY))
+                {
+                    is_other |= isOther(readSide(context, Side::REDUNDANCY, first_timeout));
+                }
+                if (isWaitingFor(context, Side::NOMINAL))
+                {
+                    is_other |= isOther(readSide(context, Side::NOMINAL, remaining(deadline)));
+                }
+            }
+            else
+            {
+                nanoseconds timeout = adaptive_timeout_ ? remaining(expected_by) : read_timeout;
+                is_other = isOther(readSide(context, Side::NOMINAL, timeout));
+            }
+
+            if (is_other)
+            {
+                // Late answer or frame of another domain: read again to get the expected one.
+                ++to_read;
+            }
+        }
+
+        endTransaction(context);
+    }
+
+
+    void Link::processAllDatagrams()
+    {
+        Domain const domain = domain_;
+        std::exception_ptr client_exception;
+        for (int32_t i = 0; i < contexts_count_; ++i)
+        {
+            // every domain is processed even if a previous one failed
+            domain_ = static_cast<Domain>(i);
+            try
+            {
+                processDatagrams();
+            }
+            catch (...)
+            {
+                client_exception = std::current_exception();
+            }
+        }
+        domain_ = domain;
+
+        if (client_exception)
+        {
+            std::rethrow_exception(client_exception);
+        }
+    }
+
+
+    bool Link::poll()
+    {
+        DomainContext& context = current();
+        beginTransaction(context);
+
+        for (Side side : {Side::REDUNDANCY, Side::NOMINAL})
+        {
+            while (isWaitingFor(context, side) and (readSide(context, side, 0ns) != ReadStatus::NOTHING))
+            {
+            }
+        }
+
+        if (isWaitingFor(context, Side::NOMINAL) or isWaitingFor(context, Side::REDUNDANCY))
+        {
+            return false;
+        }
+
+        endTransaction(context);
+        return true;
+    }
+
+
+    bool Link::completeBy(nanoseconds deadline)
+    {
+        DomainContext& context = current();
+        beginTransaction(context);
+
+        while (isWaitingFor(context, Side::NOMINAL) or isWaitingFor(context, Side::REDUNDANCY))
+        {
+            nanoseconds remaining = deadline - since_epoch();
+            if (remaining <= 0ns)
+            {
+                break;
+            }
+
+            for (Side side : {Side::REDUNDANCY, Side::NOMINAL})
+            {
+                if (isWaitingFor(context, side))
+                {
+                    readSide(context, side, std::max(deadline - since_epoch(), nanoseconds{0}));
+                }
+            }
+        }
+
+        // Deadline reached: grab what is already there without waiting.
+        for (Side side : {Side::REDUNDANCY, Side::NOMINAL})
+        {
+            while (isWaitingFor(context, side) and (readSide(context, side, 0ns) != ReadStatus::NOTHING))
+            {
+            }
+        }
+
+        bool is_complete = not (isWaitingFor(context, Side::NOMINAL) or isWaitingFor(context, Side::REDUNDANCY));
+        endTransaction(context);
+        return is_complete;
+    }
+
+
+    std::vector<int> Link::fds() const
+    {
+        std::vector<int> fds;
+        fds.push_back(socket_nominal_->fd());
+        if (is_redundant_)
+        {
+            fds.push_back(socket_redundancy_->fd());
+        }
+        return fds;
+    }
 
-        uint8_t waiting_frame = sent_frame_;
-        sent_frame_ = 0;
 
-        for (int32_t i = 0; i < waiting_frame; ++i)
+    void Link::beginTransaction(DomainContext& context)
+    {
+        if (context.is_transaction_open)
         {
-            read();
-            while (isDatagramAvailable())
+            return;
+        }
+
+        if (context.frame.datagramCounter() != 0)
+        {
+            sendFrame(context);
+        }
+
+        context.pending_frames = context.sent_frame;
+        context.sent_frame = 0;
+        context.is_transaction_open = true;
+    }
+
+
+    bool Link::isWaitingFor(DomainContext const& context, Side side) const
+    {
+        if ((side == Side::REDUNDANCY) and (not is_redundant_))
+        {
+            return false;
+        }
+        return context.received_frames[static_cast<int32_t>(side)] < context.pending_frames;
+    }
+
+
+    Link::ReadStatus Link::readSide(DomainContext& context, Side side, nanoseconds timeout)
+    {
+        if (context.rx_frames.size() <= context.rx_used)
+        {
+            context.rx_frames.resize(context.rx_used + 1);
+        }
+
+        std::shared_ptr<AbstractSocket> socket = socket_nominal_;
+        int64_t* received = &statistics_.frames_nominal;
+        if (side == Side::REDUNDANCY)
+        {
+            socket = socket_redundancy_;
+            received = &statistics_.frames_redundancy;
+        }
+
+        Frame& frame = context.rx_frames[context.rx_used];
+        frame.resetContext();
+        socket->setTimeout(timeout);
+        if (readFrame(socket, frame) < 0)
+        {
+            DEBUG_PRINT("%s read fail\n", side == Side::NOMINAL ? "Nominal" : "Redundancy");
+        }
+
+        if (not frame.isDatagramAvailable())
+        {
+            return ReadStatus::NOTHING;
+        }
+        ++(*received);
+
+        // A frame only carries datagrams of one transaction: its first datagram is enough to tag it.
+        auto const* first = reinterpret_cast<DatagramHeader const*>(frame.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader));
+        if (not isCurrent(first))
+        {
+            // Answer to a frame previously declared lost: drop it.
+            ++statistics_.frames_late;
+            frame.resetContext();
+            return ReadStatus::LATE;
+        }
+
+        // Store the frame in the domain it belongs to: it may not be the one being processed.
+        DomainContext& owner = contexts_[index_context_[first->index]];
+        sampleRtt(owner.traffic, frame);
+        Frame* stored = &frame;
+        if (&owner != &context)
+        {
+            if (owner.rx_frames.size() <= owner.rx_used)
+            {
+                owner.rx_frames.resize(owner.rx_used + 1);
+            }
+            std::swap(frame, owner.rx_frames[owner.rx_used]);
+            stored = &owner.rx_frames[owner.rx_used];
+        }
+        ++owner.rx_used;
+        ++owner.received_frames[static_cast<int32_t>(side)];
+
+        // Datagrams of the transaction being processed are handed over as soon as they are complete: the first frames
+        // of a cycle are processed while the next ones are still on the wire. Other domains process theirs when they end.
+        parseFrame(*stored, side, &owner == &context);
+
+        if (&owner != &context)
+        {
+            return ReadStatus::OTHER;
+        }
+        return ReadStatus::CURRENT;
+    }
+
+
+    void Link::parseFrame(Frame& frame, Side side, bool dispatch)
+    {
+        // Match datagrams by index: the first copy received is the reference, the other one is merged in it.
+        // A frame and its copy do not have to come back in the same read (out of order, one side late) nor at all.
+        frame.resetContext();
+        frame.setIsDatagramAvailable();
+        while (frame.isDatagramAvailable())
+        {
+            auto [header, data, wkc] = frame.nextDatagram();
+            if (not isCurrent(header))
+            {
+                continue;
+            }
+
+            Received& entry = received_[header->index];
+            if (entry.header == nullptr)
+            {
+                entry = {header, data, wkc, side, false};
+            }
+            else if ((entry.side == side) or (entry.side == Side::BOTH)
+                 or (entry.header->command != header->command) or (entry.header->len != header->len))
+            {
+                // Same datagram twice on one interface or corrupted copy: keep the first one.
+                ++statistics_.datagrams_mismatch;
+                continue;
+            }
+            else
+            {
+                mergeDatagramData(entry.data, data, header->len);
+                entry.wkc = static_cast<uint16_t>(entry.wkc + wkc);
+                entry.side = Side::BOTH;
+            }
+
+            // With redundancy, a datagram is complete once both copies are in; otherwise it waits for the transaction end.
+            if (dispatch and ((not is_redundant_) or (entry.side == Side::BOTH)))
             {
-                auto [header, data, wkc] = nextDatagram();
-                callbacks_[header->index].status = callbacks_[header->index].process(header, data, wkc);
+                processDatagram(header->index);
             }
         }
+    }
+
+
+    void Link::processDatagram(uint8_t index)
+    {
+        Received& entry = received_[index];
+        switch (entry.side)
+        {
+            case Side::NONE:       { ++statistics_.datagrams_lost;            return; }
+            case Side::NOMINAL:    { ++statistics_.datagrams_nominal_only;    break; }
+            case Side::REDUNDANCY: { ++statistics_.datagrams_redundancy_only; break; }
+            case Side::BOTH:       { ++statistics_.datagrams_merged;          break; }
+        }
+        callbacks_[index].status = callbacks_[index].process(entry.header, entry.data, entry.wkc);
+        entry.processed = true;
+    }
+
+
+    void Link::endTransaction(DomainContext& context)
+    {
+        bool is_lost = false;
+        for (uint8_t i = context.queue; i != context.head; i = context.next(i))
+        {
+            if (not received_[i].processed)
+            {
+                processDatagram(i);
+            }
+            is_lost |= (callbacks_[i].status == DatagramState::LOST);
+        }
+
+        if (is_lost and adaptive_timeout_)
+        {
+            // RFC 6298 (5.5): back off until a frame is measured again, the estimate may be below the actual round trip
+            // and late frames cannot be measured.
+            nanoseconds& backoff = backoff_[static_cast<int32_t>(context.traffic)];
+            backoff = std::min(2 * timeout(context.traffic), max_timeout_);
+        }
 
         std::exception_ptr client_exception;
-        for (uint8_t i = index_queue_; i != index_head_; ++i)
+        for (uint8_t i = context.queue; i != context.head; i = context.next(i))
         {
             if (callbacks_[i].status != DatagramState::OK)
             {
@@ -90,18 +528,17 @@ namespace kickcat
                     client_exception = std::current_exception();
                 }
             }
-
-            // Attach a callback to handle not THAT lost frames.
-            // -> if a frame suspected to be lost was in fact in the pipe, it is needed to pop it
-            callbacks_[i].process = [&](DatagramHeader const*, uint8_t const*, uint16_t)
-                {
-                    read();
-                    return DatagramState::OK;
-                };
+            received_[i] = {};
         }
 
-        index_queue_ = index_head_;
-        resetFrameContext();
+        // Close the transaction: frames still in the pipe now belong to an older generation and will be dropped on arrival.
+        ++context.generation;
+        context.queue = context.head;
+        context.traffic = TrafficClass::MAILBOX;
+        context.received_frames = {};
+        context.rx_used = 0;
+        context.is_transaction_open = false;
+        context.frame.resetContext();
 
         // Rethrow last catched client exception.
         if (client_exception)
@@ -113,6 +550,11 @@ namespace kickcat
 
     void Link::checkRedundancyNeeded()
     {
+        if (not is_redundant_)
+        {
+            return;
+        }
+
         Frame frame;
         frame.addDatagram(0, Command::BRD, createAddress(0, 0x0000), nullptr, 1);
         if (writeFrame(socket_redundancy_, frame, SECONDARY_IF_MAC) < 0)
@@ -143,15 +585,38 @@ namespace kickcat
 
     void Link::writeThenRead(Frame& frame)
     {
-        socket_nominal_->setTimeout(timeout_);
-        socket_redundancy_->setTimeout(timeout_);
+        nanoseconds const read_timeout = timeout(TrafficClass::INIT);
+        socket_nominal_->setTimeout(read_timeout);
         int32_t to_write = frame.finalize();
+        if (not is_redundant_)
+        {
+            frame.setSourceMAC(PRIMARY_IF_MAC);
+            nanoseconds sent_at = adaptive_timeout_ ? since_epoch() : 0ns;
+            int32_t written = socket_nominal_->write(frame.data(), to_write);
+            if (written < to_write)
+            {
+                THROW_ERROR("Can't write to interface");
+            }
+            if (socket_nominal_->read(frame.data(), ETH_MAX_SIZE) <= 0)
+            {
+                THROW_SYSTEM_ERROR("WriteThenRead was not able to read anything");
+            }
+            if (adaptive_timeout_)
+            {
+                rtt_[static_cast<int32_t>(TrafficClass::INIT)].update(since_epoch() - sent_at);
+            }
+            checkReadFrame(frame, to_write);
+            return;
+        }
+
+        socket_redundancy_->setTimeout(read_timeout);
         auto write_read = [&](std::shared_ptr<AbstractSocket> from,
                               std::shared_ptr<AbstractSocket> to,
                               MAC const& src)
         {
             int32_t is_faulty = 0;
             frame.setSourceMAC(src);
+            nanoseconds sent_at = adaptive_timeout_ ? since_epoch() : 0ns;
             int32_t written = from->write(frame.data(), to_write);
             if (written < to_write)
             {
@@ -166,6 +631,10 @@ namespace kickcat
                     is_faulty = 1;
                 }
             }
+            if (adaptive_timeout_ and (is_faulty == 0))
+            {
+                rtt_[static_cast<int32_t>(TrafficClass::INIT)].update(since_epoch() - sent_at);
+            }
             return is_faulty;
         };
 
@@ -177,7 +646,12 @@ namespace kickcat
         {
             THROW_SYSTEM_ERROR("WriteThenRead was not able to read anything on both interfaces");
         }
+        checkReadFrame(frame, to_write);
+    }
 
+
+    void Link::checkReadFrame(Frame& frame, int32_t written)
+    {
         if (frame.ethernet()->type != ETH_ETHERCAT_TYPE)
         {
             THROW_ERROR("Invalid frame type");
@@ -190,7 +664,7 @@ namespace kickcat
         {
             current_size = ETH_MIN_SIZE;
         }
-        if (current_size != to_write)
+        if (current_size != written)
         {
             THROW_ERROR("Wrong number of bytes read");
         }
@@ -198,7 +672,7 @@ namespace kickcat
     }
 
 
-    void Link::sendFrame()
+    void Link::sendFrame(DomainContext& context)
     {
         auto write = [&](std::shared_ptr<AbstractSocket> socket, Frame& frame, MAC const& src, int32_t to_Write)
         {
@@ -215,93 +689,107 @@ namespace kickcat
         };
 
         // save number of datagrams in the frame to handle send error properly if any
-        int32_t const datagrams = frame_nominal_.datagramCounter();
-        int32_t to_Write = frame_nominal_.finalize();
+        int32_t const datagrams = context.frame.datagramCounter();
+        int32_t to_Write = context.frame.finalize();
 
-        bool is_frame_sent_nominal = write(socket_nominal_, frame_nominal_, PRIMARY_IF_MAC, to_Write);
-        bool is_frame_sent_redundancy = write(socket_redundancy_, frame_nominal_, SECONDARY_IF_MAC, to_Write);
-
-        frame_nominal_.clear();
-        frame_redundancy_.clear();
-        frame_redundancy_.resetContext();
+        bool is_frame_sent_nominal = write(socket_nominal_, context.frame, PRIMARY_IF_MAC, to_Write);
+        bool is_frame_sent_redundancy = false;
+        if (is_redundant_)
+        {
+            is_frame_sent_redundancy = write(socket_redundancy_, context.frame, SECONDARY_IF_MAC, to_Write);
+        }
+        context.frame.clear();
 
         if (is_frame_sent_nominal or is_frame_sent_redundancy)
         {
-            ++sent_frame_;
+            ++context.sent_frame;
+            if (adaptive_timeout_)
+            {
+                context.sent_at = since_epoch();
+                sent_at_[context.next(context.head, -datagrams)] = context.sent_at;
+            }
         }
         else
         {
             for (int32_t i = 0; i < datagrams; ++i)
             {
-                int32_t index = index_head_ - i - 1;
-                callbacks_[index].status = DatagramState::SEND_ERROR;
+                callbacks_[context.next(context.head, -i - 1)].status = DatagramState::SEND_ERROR;
             }
         }
     }
 
-    void Link::read()
-    {
-        nanoseconds deadline = since_epoch() + timeout_;
 
-        socket_redundancy_->setTimeout(timeout_);
-        if (readFrame(socket_redundancy_, frame_nominal_) < 0)
-        {
-            DEBUG_PRINT("Nominal read fail\n");
-        }
+    bool Link::isCurrent(DatagramHeader const* header) const
+    {
+        // The index alone is not enough: it wraps every domain size datagrams and may have been reused since the frame was
+        // sent. The transaction carried in the IRQ field tells a late answer apart even when the index was reused with the
+        // same command and size.
+        // Slaves OR their ECAT event requests into the IRQ field (if their event mask is set): only require the bits sent
+        // to come back. An older transaction tag is numerically lower, so it cannot hold all the bits of the current one.
+        Callbacks const& callback = callbacks_[header->index];
+        uint16_t const tag = static_cast<uint16_t>(callback.generation);
+        return (callback.generation == contexts_[index_context_[header->index]].generation)
+           and ((header->IRQ & tag) == tag)
+           and (callback.command == header->command)
+           and (callback.size == header->len);
+    }
 
-        nanoseconds remaining_timeout = deadline - since_epoch();
-        nanoseconds min_timeout = 0us;
-        nanoseconds timeout_second_socket = std::max(remaining_timeout, min_timeout);
 
-        socket_nominal_->setTimeout(timeout_second_socket);
-        if (readFrame(socket_nominal_, frame_redundancy_) < 0)
+    void Link::sampleRtt(TrafficClass traffic, Frame& frame)
+    {
+        if (not adaptive_timeout_)
         {
-            DEBUG_PRINT("redundancy read fail\n");
+            return;
         }
-    }
-
 
-    void Link::addDatagramToFrame(uint8_t index, enum Command command, uint32_t address, void const* data, uint16_t data_size)
-    {
-        frame_nominal_.addDatagram(index, command, address, data, data_size);
+        auto const* first = reinterpret_cast<DatagramHeader const*>(frame.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader));
+        rtt_[static_cast<int32_t>(traffic)].update(since_epoch() - sent_at_[first->index]);
+        backoff_[static_cast<int32_t>(traffic)] = 0ns;
     }
 
 
-    void Link::resetFrameContext()
+    void Link::enableAdaptiveTimeout(nanoseconds min_timeout, nanoseconds max_timeout)
     {
-        frame_nominal_.resetContext();
-        frame_redundancy_.resetContext();
+        if (min_timeout > max_timeout)
+        {
+            THROW_ERROR("Invalid adaptive timeout bounds");
+        }
+        adaptive_timeout_ = true;
+        backoff_ = {};
+        min_timeout_ = min_timeout;
+        max_timeout_ = max_timeout;
     }
 
 
-    bool Link::isDatagramAvailable()
+    nanoseconds Link::timeout(TrafficClass traffic) const
     {
-        return frame_nominal_.isDatagramAvailable() or frame_redundancy_.isDatagramAvailable();
+        RttEstimator const& estimator = rtt_[static_cast<int32_t>(traffic)];
+        if ((not adaptive_timeout_) or (estimator.samples() == 0))
+        {
+            return timeout_;
+        }
+        nanoseconds backoff = backoff_[static_cast<int32_t>(traffic)];
+        if (backoff != 0ns)
+        {
+            return backoff;
+        }
+        return std::clamp(estimator.timeout(), min_timeout_, max_timeout_);
     }
 
 
-    std::tuple<DatagramHeader const*, uint8_t*, uint16_t> Link::nextDatagram()
+    void RttEstimator::update(nanoseconds rtt)
     {
-        bool nom = frame_nominal_.isDatagramAvailable();
-        bool red = frame_redundancy_.isDatagramAvailable();
-
-        auto [header_nominal, data_nominal, wkc_nominal] = frame_nominal_.nextDatagram();
-        auto [header_redundancy, data_redundancy, wkc_redundancy] = frame_redundancy_.nextDatagram();
-
-        // When using the bus without redundancy not nom and red is the used case.
-        if (not nom and red)
+        if (samples_ == 0)
         {
-            return std::make_tuple(header_redundancy, data_redundancy, wkc_redundancy);
+            srtt_ = rtt;
+            rttvar_ = rtt / 2;
         }
-
-        if (nom and not red)
+        else
         {
-            return std::make_tuple(header_nominal, data_nominal, wkc_nominal);
+            nanoseconds delta = std::chrono::abs(srtt_ - rtt);
+            rttvar_ = rttvar_ - rttvar_ / 4 + delta / 4;
+            srtt_   = srtt_   - srtt_   / 8 + rtt   / 8;
         }
-
-        // all frames have data
-        std::transform(data_nominal, &data_nominal[header_nominal->len], data_redundancy, data_nominal, std::bit_or<uint8_t>());
-        uint16_t wkc = wkc_nominal + wkc_redundancy;
-        return std::make_tuple(header_nominal, data_nominal, wkc);
+        ++samples_;
     }
 }
@@ -1,4 +1,5 @@
 #include <cstring>
+#include <algorithm>
 
 #include "Mailbox.h"
 #include "Error.h"
@@ -42,13 +43,103 @@ namespace kickcat
         {
             THROW_ERROR("This mailbox is inactive");
         }
-        auto sdo = std::make_shared<SDOMessage>(recv_size, index, subindex, CA, request, data, data_size);
+        auto sdo = createMessage<SDOMessage>(index, subindex, CA, request, data, data_size);
         sdo->setCounter(nextCounter());
-        to_send.push(sdo);
+        to_send.push_back(sdo);
         return sdo;
     }
 
 
+    std::shared_ptr<AbstractMessage> Mailbox::createSDODownload(uint16_t index, uint8_t subindex, bool CA, uint32_t size, SDOWriter const& writer)
+    {
+        if (recv_size == 0)
+        {
+            THROW_ERROR("This mailbox is inactive");
+        }
+        auto sdo = createMessage<SDOMessage>(index, subindex, CA, size, writer);
+        sdo->setCounter(nextCounter());
+        to_send.push_back(sdo);
+        return sdo;
+    }
+
+
+    std::shared_ptr<AbstractMessage> Mailbox::createSDOUpload(uint16_t index, uint8_t subindex, bool CA, SDOReader const& reader)
+    {
+        if (recv_size == 0)
+        {
+            THROW_ERROR("This mailbox is inactive");
+        }
+        auto sdo = createMessage<SDOMessage>(index, subindex, CA, reader);
+        sdo->setCounter(nextCounter());
+        to_send.push_back(sdo);
+        return sdo;
+    }
+
+
+    std::shared_ptr<AbstractMessage> Mailbox::createFoERead(std::string_view filename, uint32_t password, FoEReader const& reader)
+    {
+        if ((recv_size == 0) or (send_size == 0))
+        {
+            THROW_ERROR("This mailbox is inactive");
+        }
+        auto foe = createMessage<FoEMessage>(send_size, filename, password, reader);
+        foe->setCounter(nextCounter());
+        to_send.push_back(foe);
+        return foe;
+    }
+
+
+    std::shared_ptr<AbstractMessage> Mailbox::createFoEWrite(std::string_view filename, uint32_t password, uint32_t size, FoEWriter const& writer)
+    {
+        if (recv_size == 0)
+        {
+            THROW_ERROR("This mailbox is inactive");
+        }
+        auto foe = createMessage<FoEMessage>(filename, password, size, writer);
+        foe->setCounter(nextCounter());
+        to_send.push_back(foe);
+        return foe;
+    }
+
+
+    std::shared_ptr<AbstractMessage> Mailbox::createEoE(uint8_t const* frame, int32_t frame_size)
+    {
+        if (recv_size == 0)
+        {
+            THROW_ERROR("This mailbox is inactive");
+        }
+        if ((frame_size <= 0) or (frame_size > ETH_MAX_SIZE))
+        {
+            THROW_ERROR("Invalid Ethernet frame size");
+        }
+
+        int32_t const max_fragment_size = EoEMessage::maxFragmentSize(recv_size);
+        if (max_fragment_size <= 0)
+        {
+            THROW_ERROR("Mailbox too small for EoE");
+        }
+        uint8_t const frame_number = eoe_frame_number_;
+        eoe_frame_number_ = (eoe_frame_number_ + 1) & 0xF;
+
+        // fragments are pushed in a row: they cannot be interleaved with another frame (other messages can)
+        std::shared_ptr<AbstractMessage> fragment;
+        int32_t offset = 0;
+        uint8_t fragment_number = 0;
+        do
+        {
+            int32_t size = std::min(frame_size - offset, max_fragment_size);
+            fragment = createMessage<EoEMessage>(frame, frame_size, offset, size, frame_number, fragment_number);
+            fragment->setCounter(nextCounter());
+            to_send_eoe.push_back(fragment);
+
+            offset += size;
+            fragment_number++;
+        } while (offset < frame_size);
+
+        return fragment;
+    }
+
+
     std::shared_ptr<GatewayMessage> Mailbox::createGatewayMessage(uint8_t const* raw_message, int32_t raw_message_size, uint16_t gateway_index)
     {
         if (raw_message_size > recv_size)
@@ -56,74 +147,481 @@ namespace kickcat
             DEBUG_PRINT("Message size is bigger than mailbox size\n");
             return nullptr;
         }
-        auto msg = std::make_shared<GatewayMessage>(recv_size, raw_message, gateway_index);
+        auto msg = createMessage<GatewayMessage>(raw_message, gateway_index);
         msg->setCounter(nextCounter());
-        to_send.push(msg);
+        to_send.push_back(msg);
         return msg;
     }
 
 
+    std::shared_ptr<AbstractMessage> const& Mailbox::nextToSend()
+    {
+        if (next_queue_ == nullptr)
+        {
+            // EoE is best effort: it only uses the mailbox when the other protocols are idle
+            next_queue_ = &to_send;
+            if (to_send.empty())
+            {
+                next_queue_ = &to_send_eoe;
+            }
+        }
+        return next_queue_->front();
+    }
+
+
     std::shared_ptr<AbstractMessage> Mailbox::send()
     {
-        auto message = to_send.front();
-        to_send.pop();
+        auto message = nextToSend();
+        next_queue_->pop_front();
+        next_queue_ = nullptr;
 
         // add message to processing queue if needed
         if (message->status() == MessageStatus::RUNNING)
         {
-            to_process.push_back(message);
+            if (message->sent())
+            {
+                auto header = reinterpret_cast<mailbox::Header const*>(message->data());
+                message->setSession(session(message->data(), false));
+                to_process.push(dispatchQueue(header), message);
+            }
+            else
+            {
+                message->notify();
+            }
         }
         return message;
     }
 
 
-    bool Mailbox::receive(uint8_t const* raw_message)
+    template<typename F>
+    void Mailbox::cancelIf(F const& predicate, uint32_t status)
     {
-        for (auto it = to_process.begin(); it != to_process.end(); ++it)
+        std::vector<std::shared_ptr<AbstractMessage>> cancelled;
+        auto collect = [&](auto& queue)
         {
-            ProcessingResult state = (*it)->process(raw_message);
-            switch (state)
+            for (auto it = queue.begin(); it != queue.end();)
             {
-                case ProcessingResult::NOOP:
+                if (predicate(*it))
                 {
+                    cancelled.push_back(*it);
+                    it = queue.erase(it);
                     continue;
                 }
-                case ProcessingResult::CONTINUE:
-                {
-                    (*it)->setCounter(nextCounter());
-                    to_send.push(*it);
-                    it = to_process.erase(it);
-                    return true;
-                }
-                case ProcessingResult::FINALIZE:
-                {
-                    it = to_process.erase(it);
-                    return true;
-                }
-                case ProcessingResult::FINALIZE_AND_KEEP:
-                {
-                    return true;
-                }
-                default: { }
+                ++it;
             }
+        };
+
+        collect(to_send);
+        to_process.removeIf(predicate, cancelled);
+
+        if (not cancelled.empty())
+        {
+            next_queue_ = nullptr; // the chosen message may be gone: nothing is being written when messages are cancelled
         }
 
-        return false;
+        // finalize once the queues are consistent: callbacks may queue new messages
+        for (auto& message : cancelled)
+        {
+            message->cancel(status);
+        }
+    }
+
+
+    void Mailbox::checkTimeouts(nanoseconds now)
+    {
+        auto expired = [now](std::shared_ptr<AbstractMessage> const& message)
+        {
+            return (message->deadline() > 0ns) and (now > message->deadline());
+        };
+        cancelIf(expired, MessageStatus::TIMEOUT);
+    }
+
+
+    void Mailbox::cancel(std::shared_ptr<AbstractMessage> const& message, uint32_t status)
+    {
+        cancelIf([&message](std::shared_ptr<AbstractMessage> const& queued) { return queued == message; }, status);
+    }
+
+
+    int32_t Mailbox::dispatchQueue(mailbox::Header const* header)
+    {
+        if ((header->address & mailbox::GATEWAY_MESSAGE_MASK) != 0)
+        {
+            return GATEWAY_QUEUE;
+        }
+        return header->type;
+    }
+
+
+    uint32_t Mailbox::session(uint8_t const* raw_message, bool answer)
+    {
+        mailbox::Header const* header = reinterpret_cast<mailbox::Header const*>(raw_message);
+        if ((header->address & mailbox::GATEWAY_MESSAGE_MASK) != 0)
+        {
+            return header->address;
+        }
+
+        if (header->type != mailbox::Type::CoE)
+        {
+            return ANY_SESSION;
+        }
+
+        mailbox::ServiceData const* coe = reinterpret_cast<mailbox::ServiceData const*>(raw_message + sizeof(mailbox::Header));
+        if ((coe->service != CoE::Service::SDO_REQUEST) and (coe->service != CoE::Service::SDO_RESPONSE))
+        {
+            return ANY_SESSION;
+        }
+
+        // segments do not carry the object address: these bytes hold segment data
+        bool is_segment = (coe->command == CoE::SDO::request::DOWNLOAD_SEGMENTED) or (coe->command == CoE::SDO::request::UPLOAD_SEGMENTED);
+        if (answer)
+        {
+            is_segment = (coe->service == CoE::Service::SDO_RESPONSE)
+                     and ((coe->command == CoE::SDO::response::UPLOAD_SEGMENTED) or (coe->command == CoE::SDO::response::DOWNLOAD_SEGMENTED));
+        }
+        if (is_segment)
+        {
+            return ANY_SESSION;
+        }
+        return (coe->index << 8) | coe->subindex;
+    }
+
+
+    std::shared_ptr<MessagePool> const& Mailbox::pool()
+    {
+        if ((pool_ == nullptr) or (pool_->bufferSize() != recv_size))
+        {
+            pool_ = std::make_shared<MessagePool>(recv_size, PREALLOCATED_MESSAGES);
+        }
+        return pool_;
+    }
+
+
+    bool Mailbox::receive(uint8_t const* raw_message)
+    {
+        mailbox::Header const* header = reinterpret_cast<mailbox::Header const*>(raw_message);
+
+        if ((header->type == mailbox::Type::CoE) and ((header->address & mailbox::GATEWAY_MESSAGE_MASK) == 0))
+        {
+            mailbox::Emergency const* emg = reinterpret_cast<mailbox::Emergency const*>(raw_message + sizeof(mailbox::Header));
+            if (emg->service == CoE::Service::EMERGENCY)
+            {
+                emergencies.push_back(*emg);
+                return true;
+            }
+        }
+
+        if ((header->type == mailbox::Type::EoE) and ((header->address & mailbox::GATEWAY_MESSAGE_MASK) == 0))
+        {
+            EoE::Header const* eoe = reinterpret_cast<EoE::Header const*>(raw_message + sizeof(mailbox::Header));
+            if (eoe->type == EoE::FrameType::FRAGMENT)
+            {
+                return receiveEoE(raw_message);
+            }
+        }
+
+        // the answer goes to the message waiting for its session, else to a message accepting any answer (i.e. SDO segments)
+        int32_t const queue = dispatchQueue(header);
+        uint32_t key = session(raw_message, true);
+        std::shared_ptr<AbstractMessage> message = to_process.front(queue, key);
+        if ((message == nullptr) and (key != ANY_SESSION))
+        {
+            key = ANY_SESSION;
+            message = to_process.front(queue, key);
+        }
+        if (message == nullptr)
+        {
+            return false;
+        }
+
+        ProcessingResult state = message->process(raw_message);
+        switch (state)
+        {
+            case ProcessingResult::CONTINUE:
+            {
+                to_process.pop(queue, key);
+                message->setCounter(nextCounter());
+                to_send.push_back(message);
+                return true;
+            }
+            case ProcessingResult::FINALIZE:
+            {
+                to_process.pop(queue, key);
+                message->notify();
+                return true;
+            }
+            case ProcessingResult::FINALIZE_AND_KEEP:
+            {
+                return true;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+
+    bool Mailbox::receiveEoE(uint8_t const* raw_message)
+    {
+        mailbox::Header const* header = reinterpret_cast<mailbox::Header const*>(raw_message);
+        EoE::Header const* eoe = reinterpret_cast<EoE::Header const*>(raw_message + sizeof(mailbox::Header));
+        uint8_t const* fragment = raw_message + sizeof(mailbox::Header) + sizeof(EoE::Header);
+        int32_t const fragment_size = header->len - static_cast<int32_t>(sizeof(EoE::Header));
+
+        if (eoe->fragment_number == 0)
+        {
+            // new frame: previous one, if any, is lost
+            eoe_rx_.size = 0;
+            eoe_rx_.frame_number = eoe->frame_number;
+            eoe_rx_.next_fragment = 0;
+            eoe_rx_.in_progress = true;
+        }
+        else if ((not eoe_rx_.in_progress)
+             or (eoe->frame_number != eoe_rx_.frame_number)
+             or (eoe->fragment_number != eoe_rx_.next_fragment)
+             or ((eoe->offset * EoE::FRAGMENT_BLOCK_SIZE) != eoe_rx_.size))
+        {
+            DEBUG_PRINT("EoE fragment out of sequence: frame dropped\n");
+            eoe_rx_.in_progress = false;
+            return true;
+        }
+
+        if ((fragment_size < 0) or ((eoe_rx_.size + fragment_size) > static_cast<int32_t>(eoe_rx_.frame.size())))
+        {
+            DEBUG_PRINT("EoE frame too big: frame dropped\n");
+            eoe_rx_.in_progress = false;
+            return true;
+        }
+
+        std::memcpy(eoe_rx_.frame.data() + eoe_rx_.size, fragment, fragment_size);
+        eoe_rx_.size += fragment_size;
+        eoe_rx_.next_fragment++;
+
+        if (eoe->last_fragment)
+        {
+            eoe_rx_.in_progress = false;
+            if (eoe_handler)
+            {
+                eoe_handler(eoe_rx_.frame.data(), eoe_rx_.size);
+            }
+        }
+        return true;
+    }
+
+
+    int32_t PendingMessages::home(uint64_t key)
+    {
+        // Fibonacci hashing: sessions (index and subindex) differ in a few bits, spread them over the table
+        return static_cast<int32_t>((key * 0x9E3779B97F4A7C15ULL) >> (64 - CAPACITY_BITS));
+    }
+
+
+    int32_t PendingMessages::find(uint64_t key) const
+    {
+        for (int32_t i = home(key); slots_[i].head != nullptr; i = (i + 1) & MASK)
+        {
+            if (slots_[i].key == key)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+
+    void PendingMessages::push(int32_t queue, std::shared_ptr<AbstractMessage> const& message)
+    {
+        uint64_t const k = key(queue, message->session());
+        message->next_pending_ = nullptr;
+
+        int32_t i = home(k);
+        for (; slots_[i].head != nullptr; i = (i + 1) & MASK)
+        {
+            if (slots_[i].key == k)
+            {
+                slots_[i].tail->next_pending_ = message;
+                slots_[i].tail = message.get();
+                ++count_.at(queue);
+                return;
+            }
+        }
+
+        if (used_ >= (CAPACITY - 1)) // the probe sequences end on a free slot
+        {
+            THROW_ERROR("Too many mailbox sessions waiting for an answer");
+        }
+        slots_[i] = {k, message, message.get()};
+        ++used_;
+        ++count_.at(queue);
+    }
+
+
+    std::shared_ptr<AbstractMessage> PendingMessages::front(int32_t queue, uint32_t session) const
+    {
+        int32_t const i = find(key(queue, session));
+        if (i < 0)
+        {
+            return nullptr;
+        }
+        return slots_[i].head;
+    }
+
+
+    void PendingMessages::pop(int32_t queue, uint32_t session)
+    {
+        int32_t const i = find(key(queue, session));
+        if (i < 0)
+        {
+            return;
+        }
+
+        Slot& slot = slots_[i];
+        std::shared_ptr<AbstractMessage> next = std::move(slot.head->next_pending_);
+        slot.head = std::move(next);
+        --count_.at(queue);
+        if (slot.head == nullptr)
+        {
+            erase(i);
+        }
+    }
+
+
+    void PendingMessages::erase(int32_t slot)
+    {
+        // backward shift deletion: a following entry moves into the hole if the hole is on its probe sequence
+        int32_t hole = slot;
+        for (int32_t i = (slot + 1) & MASK; slots_[i].head != nullptr; i = (i + 1) & MASK)
+        {
+            int32_t const distance = (i - home(slots_[i].key)) & MASK;
+            if (distance >= ((i - hole) & MASK))
+            {
+                slots_[hole] = std::move(slots_[i]);
+                hole = i;
+            }
+        }
+        slots_[hole] = {};
+        --used_;
+    }
+
+
+    void PendingMessages::clear()
+    {
+        for (auto& slot : slots_)
+        {
+            // break the chains: a message may outlive the table
+            while (slot.head != nullptr)
+            {
+                std::shared_ptr<AbstractMessage> next = std::move(slot.head->next_pending_);
+                slot.head = std::move(next);
+            }
+            slot = {};
+        }
+        count_ = {};
+        used_ = 0;
+    }
+
+
+    MessagePool::MessagePool(uint16_t buffer_size, int32_t preallocated)
+        : buffer_size_{buffer_size}
+    {
+        buffers_.reserve(preallocated);
+        objects_.reserve(preallocated);
+        for (int32_t i = 0; i < preallocated; ++i)
+        {
+            buffers_.emplace_back(buffer_size);
+            objects_.push_back(::operator new(OBJECT_BLOCK_SIZE));
+        }
+    }
+
+
+    MessagePool::~MessagePool()
+    {
+        for (void* object : objects_)
+        {
+            ::operator delete(object);
+        }
+    }
+
+
+    std::vector<uint8_t> MessagePool::acquire()
+    {
+        if (buffers_.empty())
+        {
+            return std::vector<uint8_t>(buffer_size_);
+        }
+
+        std::vector<uint8_t> buffer = std::move(buffers_.back());
+        buffers_.pop_back();
+        buffer.resize(buffer_size_);
+        std::fill(buffer.begin(), buffer.end(), 0);
+        return buffer;
+    }
+
+
+    void MessagePool::release(std::vector<uint8_t>&& buffer)
+    {
+        buffers_.push_back(std::move(buffer));
+    }
+
+
+    void* MessagePool::allocateObject(std::size_t size)
+    {
+        if (size > OBJECT_BLOCK_SIZE)
+        {
+            return ::operator new(size);
+        }
+        if (objects_.empty())
+        {
+            return ::operator new(OBJECT_BLOCK_SIZE);
+        }
+
+        void* object = objects_.back();
+        objects_.pop_back();
+        return object;
+    }
+
+
+    void MessagePool::releaseObject(void* object, std::size_t size)
+    {
+        if (size > OBJECT_BLOCK_SIZE)
+        {
+            ::operator delete(object);
+            return;
+        }
+        objects_.push_back(object);
     }
 
 
-    AbstractMessage::AbstractMessage(uint16_t mailbox_size)
+    AbstractMessage::AbstractMessage(uint16_t mailbox_size, std::shared_ptr<MessagePool> const& pool)
+        : pool_{pool}
     {
-        data_.resize(mailbox_size);
+        if ((pool_ != nullptr) and (pool_->bufferSize() == mailbox_size))
+        {
+            data_ = pool_->acquire();
+        }
+        else
+        {
+            pool_ = nullptr;
+            data_.resize(mailbox_size);
+        }
         header_ = reinterpret_cast<mailbox::Header*>(data_.data());
         header_->address  = 0; // Default: local processing address
         status_ = MessageStatus::RUNNING; // Default mode is running to send the msg on the bus
     }
 
-    SDOMessage::SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, uint8_t request, void* data, uint32_t* data_size)
-        : AbstractMessage(mailbox_size)
-        , client_data_(reinterpret_cast<uint8_t*>(data))
-        , client_data_size_(data_size)
+
+    AbstractMessage::~AbstractMessage()
+    {
+        if (pool_ != nullptr)
+        {
+            pool_->release(std::move(data_));
+        }
+    }
+
+    SDOMessage::SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, uint8_t request,
+                           std::shared_ptr<MessagePool> const& pool)
+        : AbstractMessage(mailbox_size, pool)
     {
         coe_ = reinterpret_cast<mailbox::ServiceData*>(data_.data() + sizeof(mailbox::Header));
         payload_ = reinterpret_cast<uint8_t*>(data_.data() + sizeof(mailbox::Header) + sizeof(mailbox::ServiceData));
@@ -142,33 +640,127 @@ namespace kickcat
         coe_->size_indicator  = 0;
         coe_->index    = index;
         coe_->subindex = subindex;
+    }
+
+    SDOMessage::SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, uint8_t request, void* data, uint32_t* data_size,
+                           std::shared_ptr<MessagePool> const& pool)
+        : SDOMessage(mailbox_size, index, subindex, CA, request, pool)
+    {
+        uint8_t* client_data = reinterpret_cast<uint8_t*>(data);
 
         if (request == CoE::SDO::request::DOWNLOAD)
         {
-            uint32_t size = *data_size;
-            if (size > (data_.size() - 10))
+            complete_size_ = *data_size;
+            writer_ = [client_data](uint8_t* chunk, uint32_t offset, uint32_t size)
             {
-                THROW_ERROR("Segmented download transfer required - not implemented");
-            }
+                std::memcpy(chunk, client_data + offset, size);
+            };
+            prepareDownload();
+            return;
+        }
 
-            if (size <= 4)
-            {
-                // expedited transfer
-                coe_->transfer_type  = 1;
-                coe_->size_indicator = 1;
-                coe_->block_size = (4 - size) & 0x3;
-                std::memcpy(payload_, data, size);
-            }
-            else
+        reader_ = [client_data, data_size, capacity = *data_size](uint8_t const* chunk, uint32_t offset, uint32_t size, uint32_t complete_size)
+        {
+            if ((capacity < complete_size) or (capacity < (offset + size)))
             {
-                header_->len += static_cast<uint16_t>(size);
-                std::memcpy(payload_, &size, sizeof(uint32_t));
-                std::memcpy(payload_ + sizeof(uint32_t), data, size);
+                return false;
             }
+            std::memcpy(client_data + offset, chunk, size);
+            *data_size = offset + size;
+            return true;
+        };
+    }
+
+    SDOMessage::SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, uint32_t size, SDOWriter const& writer,
+                           std::shared_ptr<MessagePool> const& pool)
+        : SDOMessage(mailbox_size, index, subindex, CA, CoE::SDO::request::DOWNLOAD, pool)
+    {
+        complete_size_ = size;
+        writer_ = writer;
+        prepareDownload();
+    }
+
+    SDOMessage::SDOMessage(uint16_t mailbox_size, uint16_t index, uint8_t subindex, bool CA, SDOReader const& reader,
+                           std::shared_ptr<MessagePool> const& pool)
+        : SDOMessage(mailbox_size, index, subindex, CA, CoE::SDO::request::UPLOAD, pool)
+    {
+        reader_ = reader;
+    }
+
+
+    void SDOMessage::prepareDownload()
+    {
+        if (data_.size() <= (sizeof(mailbox::Header) + 10))
+        {
+            THROW_ERROR("Mailbox too small for a SDO download");
+        }
+
+        if (complete_size_ <= 4)
+        {
+            // expedited transfer
+            coe_->transfer_type  = 1;
+            coe_->size_indicator = 1;
+            coe_->block_size = (4 - complete_size_) & 0x3;
+            writer_(payload_, 0, complete_size_);
+            offset_ = complete_size_;
+            return;
+        }
+
+        // normal transfer: complete size then as much data as the mailbox can hold - segments will follow if required
+        uint32_t const max_size = static_cast<uint32_t>(data_.size() - sizeof(mailbox::Header) - 10);
+        uint32_t const size = std::min(complete_size_, max_size);
+
+        coe_->size_indicator = 1;
+        header_->len += static_cast<uint16_t>(size);
+        std::memcpy(payload_, &complete_size_, sizeof(uint32_t));
+        writer_(payload_ + sizeof(uint32_t), 0, size);
+        offset_ = size;
+    }
+
+    void SDOMessage::prepareDownloadSegment()
+    {
+        // segment data directly follows the SDO command byte and fills the whole mailbox if needed
+        uint8_t* segment = reinterpret_cast<uint8_t*>(coe_) + SEGMENT_HEADER_SIZE;
+        uint32_t const max_size = static_cast<uint32_t>(data_.size() - sizeof(mailbox::Header) - SEGMENT_HEADER_SIZE);
+        uint32_t const size = std::min(complete_size_ - offset_, max_size);
+
+        std::memset(segment, 0, MIN_SEGMENT_SIZE);  // padding of small segments
+        writer_(segment, offset_, size);
+        offset_ += size;
+
+        coe_->service         = CoE::Service::SDO_REQUEST;
+        coe_->command         = CoE::SDO::request::DOWNLOAD_SEGMENTED;
+        coe_->size_indicator  = (offset_ == complete_size_); // last segment
+        coe_->transfer_type   = 0;
+        coe_->block_size      = 0;
+
+        if (size < MIN_SEGMENT_SIZE)
+        {
+            // segment data size is encoded in bits 1-3 as the number of unused bytes
+            uint8_t const unused = static_cast<uint8_t>(MIN_SEGMENT_SIZE - size);
+            coe_->transfer_type = unused & 0x1;
+            coe_->block_size    = (unused >> 1) & 0x3;
+            header_->len = SEGMENT_HEADER_SIZE + MIN_SEGMENT_SIZE;
+        }
+        else
+        {
+            header_->len = static_cast<uint16_t>(SEGMENT_HEADER_SIZE + size);
         }
     }
 
 
+    bool SDOMessage::consume(uint8_t const* chunk, uint32_t size)
+    {
+        if (not reader_(chunk, offset_, size, complete_size_))
+        {
+            status_ = MessageStatus::COE_CLIENT_BUFFER_TOO_SMALL;
+            return false;
+        }
+        offset_ += size;
+        return true;
+    }
+
+
     ProcessingResult SDOMessage::process(uint8_t const* received)
     {
         mailbox::Header const* header = reinterpret_cast<mailbox::Header const*>(received);
@@ -239,48 +831,35 @@ namespace kickcat
         if (coe->transfer_type == 1)
         {
             // expedited transfer
-            uint32_t size = 4 - coe->block_size;
-            if(*client_data_size_ < size)
+            complete_size_ = 4 - coe->block_size;
+            if (consume(payload, complete_size_))
             {
-                status_ = MessageStatus::COE_CLIENT_BUFFER_TOO_SMALL;
-                return ProcessingResult::FINALIZE;
+                status_ = MessageStatus::SUCCESS;
             }
-            std::memcpy(client_data_, payload, size);
-            *client_data_size_ = size;
-
-            status_ = MessageStatus::SUCCESS;
             return ProcessingResult::FINALIZE;
         }
 
         // standard or segmented transfer
-        uint32_t const complete_size = *reinterpret_cast<uint32_t const*>(payload);
+        complete_size_ = *reinterpret_cast<uint32_t const*>(payload);
         payload += 4;
 
-        if (*client_data_size_ < complete_size)
+        uint32_t const data_len = header->len - 10;
+        if (data_len >= complete_size_)
         {
-            status_ = MessageStatus::COE_CLIENT_BUFFER_TOO_SMALL;
+            // standard
+            if (consume(payload, complete_size_))
+            {
+                status_ = MessageStatus::SUCCESS;
+            }
             return ProcessingResult::FINALIZE;
         }
 
-        uint32_t const data_len = header->len - 10;
-        if (data_len >= complete_size)
+        // segmented: the first part of the object is in this answer
+        if (not consume(payload, data_len))
         {
-            // standard
-            std::memcpy(client_data_, payload, complete_size);
-            *client_data_size_ = complete_size;
-
-            status_ = MessageStatus::SUCCESS;
             return ProcessingResult::FINALIZE;
         }
 
-        // segmented
-        uint32_t size = *reinterpret_cast<uint32_t const*>(payload);
-        payload += 4;
-
-        std::memcpy(client_data_, payload, size);
-        client_data_ += size;
-        *client_data_size_ = size;
-
         // since transfer is segmented, we need to request the next segment
         coe_->service = CoE::Service::SDO_REQUEST;
         coe_->command = CoE::SDO::request::UPLOAD_SEGMENTED;
@@ -288,11 +867,13 @@ namespace kickcat
         coe_->block_size      = 0;
         coe_->transfer_type   = 0;
         coe_->size_indicator  = 0;
+        coe_->index           = 0;
+        coe_->subindex        = 0;
         status_ = MessageStatus::RUNNING;
         return ProcessingResult::CONTINUE;
     }
 
-    ProcessingResult SDOMessage::processUploadSegmented(mailbox::Header const* header, mailbox::ServiceData const* coe, uint8_t const* payload)
+    ProcessingResult SDOMessage::processUploadSegmented(mailbox::Header const* header, mailbox::ServiceData const* coe, uint8_t const*)
     {
         if (coe->command != CoE::SDO::response::UPLOAD_SEGMENTED)
         {
@@ -306,23 +887,22 @@ namespace kickcat
             return ProcessingResult::FINALIZE;
         }
 
-        uint32_t size = 0;
-        if (header->len == 10)
+        // segment data directly follows the SDO command byte
+        uint8_t const* segment = reinterpret_cast<uint8_t const*>(coe) + SEGMENT_HEADER_SIZE;
+        uint32_t size = header->len - SEGMENT_HEADER_SIZE;
+        if (header->len == (SEGMENT_HEADER_SIZE + MIN_SEGMENT_SIZE))
         {
-            size = 7 - (coe->block_size | (coe->size_indicator << 2));
+            // small segment: bits 1-3 are the number of unused bytes
+            size = MIN_SEGMENT_SIZE - (coe->transfer_type | (coe->block_size << 1));
         }
-        else
+
+        if (not consume(segment, size))
         {
-            size = *reinterpret_cast<uint32_t const*>(payload);
-            payload += sizeof(uint32_t);
+            return ProcessingResult::FINALIZE;
         }
 
-        std::memcpy(client_data_, payload, size);
-        client_data_ += size;
-        *client_data_size_ += size;
-
-        bool more_follow = coe->size_indicator;
-        if (not more_follow)
+        bool last_segment = coe->size_indicator;
+        if (last_segment)
         {
             status_ = MessageStatus::SUCCESS;
             return ProcessingResult::FINALIZE;
@@ -340,6 +920,14 @@ namespace kickcat
             return ProcessingResult::FINALIZE;
         }
 
+        if (offset_ < complete_size_)
+        {
+            // object is bigger than the mailbox: send the remaining data by segments
+            coe_->complete_access = false; // use for toggle bit - first segment shall be set to 0
+            prepareDownloadSegment();
+            return ProcessingResult::CONTINUE;
+        }
+
         status_ = MessageStatus::SUCCESS; // all checks passed
         return ProcessingResult::FINALIZE;
     }
@@ -352,38 +940,245 @@ namespace kickcat
             return ProcessingResult::FINALIZE;
         }
 
-        return ProcessingResult::FINALIZE;
+        if (coe->complete_access != coe_->complete_access)
+        {
+            status_ = MessageStatus::COE_SEGMENT_BAD_TOGGLE_BIT;
+            return ProcessingResult::FINALIZE;
+        }
+
+        if (offset_ == complete_size_)
+        {
+            status_ = MessageStatus::SUCCESS;
+            return ProcessingResult::FINALIZE;
+        }
+
+        coe_->complete_access = not coe_->complete_access;
+        prepareDownloadSegment();
+        return ProcessingResult::CONTINUE;
     }
 
 
-    EmergencyMessage::EmergencyMessage(Mailbox& mailbox)
-        : AbstractMessage(mailbox.recv_size)
-        , mailbox_{mailbox}
-    { }
+    FoEMessage::FoEMessage(uint16_t mailbox_size, uint8_t opcode, std::string_view filename, uint32_t password,
+                           std::shared_ptr<MessagePool> const& pool)
+        : AbstractMessage(mailbox_size, pool)
+    {
+        foe_ = reinterpret_cast<FoE::Header*>(data_.data() + sizeof(mailbox::Header));
+        payload_ = data_.data() + sizeof(mailbox::Header) + sizeof(FoE::Header);
+
+        if ((sizeof(mailbox::Header) + sizeof(FoE::Header) + filename.size()) > data_.size())
+        {
+            THROW_ERROR("FoE filename too long for the mailbox");
+        }
+
+        header_->len      = static_cast<uint16_t>(sizeof(FoE::Header) + filename.size());
+        header_->priority = 0; // unused
+        header_->channel  = 0;
+        header_->type     = mailbox::Type::FoE;
+
+        foe_->opcode   = opcode;
+        foe_->reserved = 0;
+        foe_->data     = password;
+        std::memcpy(payload_, filename.data(), filename.size());
+    }
+
+    FoEMessage::FoEMessage(uint16_t mailbox_size, uint16_t slave_mailbox_size, std::string_view filename, uint32_t password,
+                           FoEReader const& reader, std::shared_ptr<MessagePool> const& pool)
+        : FoEMessage(mailbox_size, FoE::Opcode::READ_REQUEST, filename, password, pool)
+    {
+        reader_ = reader;
+        max_packet_size_ = slave_mailbox_size - sizeof(mailbox::Header) - sizeof(FoE::Header);
+    }
+
+    FoEMessage::FoEMessage(uint16_t mailbox_size, std::string_view filename, uint32_t password, uint32_t size,
+                           FoEWriter const& writer, std::shared_ptr<MessagePool> const& pool)
+        : FoEMessage(mailbox_size, FoE::Opcode::WRITE_REQUEST, filename, password, pool)
+    {
+        writer_ = writer;
+        size_ = size;
+        max_packet_size_ = mailbox_size - sizeof(mailbox::Header) - sizeof(FoE::Header);
+    }
+
 
-    ProcessingResult EmergencyMessage::process(uint8_t const* received)
+    void FoEMessage::prepareAck()
+    {
+        header_->len = sizeof(FoE::Header);
+        foe_->opcode = FoE::Opcode::ACK;
+        foe_->data   = packet_;
+    }
+
+    void FoEMessage::prepareData()
+    {
+        // a packet shorter than a full one ends the transfer: if the file size is a multiple of the packet size,
+        // an empty packet is sent at the end.
+        uint32_t const size = std::min(size_ - offset_, max_packet_size_);
+        writer_(payload_, offset_, size);
+        offset_ += size;
+        packet_++;
+        last_packet_ = (size < max_packet_size_);
+
+        header_->len = static_cast<uint16_t>(sizeof(FoE::Header) + size);
+        foe_->opcode = FoE::Opcode::DATA;
+        foe_->data   = packet_;
+    }
+
+
+    bool FoEMessage::sent()
+    {
+        if ((foe_->opcode == FoE::Opcode::ACK) and last_packet_)
+        {
+            // last packet acknowledged: nothing more is expected from the slave
+            status_ = MessageStatus::SUCCESS;
+            return false;
+        }
+        return true;
+    }
+
+
+    ProcessingResult FoEMessage::process(uint8_t const* received)
     {
         mailbox::Header const* header = reinterpret_cast<mailbox::Header const*>(received);
-        mailbox::Emergency const* emg = reinterpret_cast<mailbox::Emergency const*>(received + sizeof(mailbox::Header));
+        FoE::Header const* foe = reinterpret_cast<FoE::Header const*>(received + sizeof(mailbox::Header));
+        uint8_t const* payload = received + sizeof(mailbox::Header) + sizeof(FoE::Header);
 
-        // check if the received message is an emergency one
-        if (header->type != mailbox::Type::CoE)
+        // skip gateway message
+        if ((header->address & mailbox::GATEWAY_MESSAGE_MASK) != 0)
         {
             return ProcessingResult::NOOP;
         }
 
-        if (emg->service != CoE::Service::EMERGENCY)
+        if (header->type != mailbox::Type::FoE)
         {
             return ProcessingResult::NOOP;
         }
 
-        mailbox_.emergencies.push_back(*emg);
-        return ProcessingResult::FINALIZE_AND_KEEP;
+        switch (foe->opcode)
+        {
+            case FoE::Opcode::ERROR:
+            {
+                DEBUG_PRINT("FoE error %x - %s\n", foe->data, FoE::error_to_str(foe->data));
+                status_ = foe->data;
+                return ProcessingResult::FINALIZE;
+            }
+            case FoE::Opcode::BUSY:
+            {
+                // slave is not ready: send again the last packet
+                return ProcessingResult::CONTINUE;
+            }
+            default: {}
+        }
+
+        if (reader_)
+        {
+            return processRead(header, foe, payload);
+        }
+        return processWrite(foe);
+    }
+
+
+    ProcessingResult FoEMessage::processRead(mailbox::Header const* header, FoE::Header const* foe, uint8_t const* payload)
+    {
+        if (foe->opcode != FoE::Opcode::DATA)
+        {
+            status_ = MessageStatus::FOE_WRONG_SERVICE;
+            return ProcessingResult::FINALIZE;
+        }
+
+        if (foe->data != (packet_ + 1))
+        {
+            status_ = MessageStatus::FOE_WRONG_PACKET_NUMBER;
+            return ProcessingResult::FINALIZE;
+        }
+
+        uint32_t const size = header->len - sizeof(FoE::Header);
+        if (not reader_(payload, offset_, size))
+        {
+            status_ = MessageStatus::FOE_CLIENT_BUFFER_TOO_SMALL;
+            return ProcessingResult::FINALIZE;
+        }
+        offset_ += size;
+        packet_++;
+        last_packet_ = (size < max_packet_size_);
+
+        prepareAck();
+        return ProcessingResult::CONTINUE;
+    }
+
+
+    ProcessingResult FoEMessage::processWrite(FoE::Header const* foe)
+    {
+        if (foe->opcode != FoE::Opcode::ACK)
+        {
+            status_ = MessageStatus::FOE_WRONG_SERVICE;
+            return ProcessingResult::FINALIZE;
+        }
+
+        if (foe->data != packet_)
+        {
+            status_ = MessageStatus::FOE_WRONG_PACKET_NUMBER;
+            return ProcessingResult::FINALIZE;
+        }
+
+        if (last_packet_)
+        {
+            status_ = MessageStatus::SUCCESS;
+            return ProcessingResult::FINALIZE;
+        }
+
+        prepareData();
+        return ProcessingResult::CONTINUE;
+    }
+
+
+    EoEMessage::EoEMessage(uint16_t mailbox_size, uint8_t const* frame, int32_t frame_size, int32_t offset, int32_t fragment_size,
+                           uint8_t frame_number, uint8_t fragment_number, std::shared_ptr<MessagePool> const& pool)
+        : AbstractMessage(mailbox_size, pool)
+    {
+        EoE::Header* eoe = reinterpret_cast<EoE::Header*>(data_.data() + sizeof(mailbox::Header));
+        uint8_t* fragment = data_.data() + sizeof(mailbox::Header) + sizeof(EoE::Header);
+
+        header_->len      = static_cast<uint16_t>(sizeof(EoE::Header) + fragment_size);
+        header_->priority = 0; // unused
+        header_->channel  = 0;
+        header_->type     = mailbox::Type::EoE;
+
+        eoe->type            = EoE::FrameType::FRAGMENT;
+        eoe->port            = 0;
+        eoe->last_fragment   = ((offset + fragment_size) == frame_size);
+        eoe->time_appended   = 0;
+        eoe->time_request    = 0;
+        eoe->reserved        = 0;
+        eoe->fragment_number = fragment_number & 0x3F;
+        eoe->frame_number    = frame_number & 0xF;
+        if (fragment_number == 0)
+        {
+            eoe->offset = ((frame_size + EoE::FRAGMENT_BLOCK_SIZE - 1) / EoE::FRAGMENT_BLOCK_SIZE) & 0x3F;
+        }
+        else
+        {
+            eoe->offset = (offset / EoE::FRAGMENT_BLOCK_SIZE) & 0x3F;
+        }
+
+        std::memcpy(fragment, frame + offset, fragment_size);
+    }
+
+
+    bool EoEMessage::sent()
+    {
+        status_ = MessageStatus::SUCCESS;
+        return false;
+    }
+
+
+    int32_t EoEMessage::maxFragmentSize(uint16_t mailbox_size)
+    {
+        int32_t const available = mailbox_size - static_cast<int32_t>(sizeof(mailbox::Header) + sizeof(EoE::Header));
+        return available - (available % EoE::FRAGMENT_BLOCK_SIZE);
     }
 
 
-    GatewayMessage::GatewayMessage(uint16_t mailbox_size, uint8_t const* raw_message, uint16_t gateway_index)
-        : AbstractMessage(mailbox_size)
+    GatewayMessage::GatewayMessage(uint16_t mailbox_size, uint8_t const* raw_message, uint16_t gateway_index,
+                                   std::shared_ptr<MessagePool> const& pool)
+        : AbstractMessage(mailbox_size, pool)
     {
         mailbox::Header const* header = reinterpret_cast<mailbox::Header const*>(raw_message);
 
@@ -0,0 +1,252 @@
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+#include "OS/Linux/BusManager.h"
+
+namespace kickcat
+{
+    BusManager::SegmentContext::SegmentContext(Segment const& segment)
+        : config{segment}
+        , link{std::make_shared<Link>(segment.nominal, segment.redundancy, [](){})}
+        , bus{link}
+    { }
+
+
+    BusManager::BusManager(nanoseconds cycle)
+        : cycle_{cycle}
+    {
+        if (cycle_ <= 0ns)
+        {
+            THROW_ERROR("Invalid cycle");
+        }
+    }
+
+
+    BusManager::~BusManager()
+    {
+        stop();
+    }
+
+
+    int32_t BusManager::addSegment(Segment const& segment)
+    {
+        if (running_)
+        {
+            THROW_ERROR("Cannot add a segment while running");
+        }
+        if (not segment.cycle)
+        {
+            THROW_ERROR("Segment cycle is not defined");
+        }
+        segments_.push_back(std::make_unique<SegmentContext>(segment));
+        return static_cast<int32_t>(segments_.size() - 1);
+    }
+
+
+    void BusManager::setImage(int32_t segment, uint8_t const* image, int32_t size)
+    {
+        if (running_)
+        {
+            THROW_ERROR("Cannot change a segment image while running");
+        }
+        auto& context = *segments_.at(segment);
+        context.image = image;
+        context.image_size = size;
+        for (auto& snapshot : context.snapshots)
+        {
+            snapshot.cycle = -1;
+            snapshot.data.resize(size);
+        }
+    }
+
+
+    void BusManager::start()
+    {
+        if (running_)
+        {
+            return;
+        }
+
+        // common timebase: first cycle on a cycle boundary, late enough for every thread to be ready
+        nanoseconds now = since_epoch();
+        start_time_ = ((now + 10ms) / cycle_ + 1) * cycle_;
+
+        // each thread configures itself before entering its loop: no cycle runs with the default scheduling
+        running_ = true;
+        for (auto& segment : segments_)
+        {
+            SegmentContext& context = *segment;
+            std::promise<void> started;
+            std::future<void> configured = started.get_future();
+            context.thread = std::thread([this, &context, &started]() { run(context, started); });
+            try
+            {
+                configured.get();
+            }
+            catch (...)
+            {
+                stop();
+                throw;
+            }
+        }
+    }
+
+
+    void BusManager::configure(SegmentContext const& segment)
+    {
+        if (segment.config.cpu >= 0)
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(segment.config.cpu, &cpuset);
+            int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+            if (result != 0)
+            {
+                errno = result;
+                THROW_SYSTEM_ERROR("pthread_setaffinity_np()");
+            }
+        }
+
+        if (segment.config.priority > 0)
+        {
+            sched_param param{};
+            param.sched_priority = segment.config.priority;
+            int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (result != 0)
+            {
+                errno = result;
+                THROW_SYSTEM_ERROR("pthread_setschedparam()");
+            }
+        }
+    }
+
+
+    void BusManager::stop()
+    {
+        running_ = false;
+        for (auto& segment : segments_)
+        {
+            if (segment->thread.joinable())
+            {
+                segment->thread.join();
+            }
+        }
+    }
+
+
+    void BusManager::run(SegmentContext& segment, std::promise<void>& started)
+    {
+        try
+        {
+            configure(segment);
+        }
+        catch (...)
+        {
+            started.set_exception(std::current_exception());
+            return;
+        }
+        started.set_value();
+
+        int64_t cycle = 0;
+        while (running_)
+        {
+            nanoseconds deadline = start_time_ + cycle * cycle_ + segment.config.phase;
+            nanoseconds delay = deadline - since_epoch();
+            if (delay > 0ns)
+            {
+                sleep(delay);
+            }
+            else if (delay < -cycle_)
+            {
+                // too late: skip the missed cycles to stay aligned on the timebase
+                ++segment.overruns;
+                cycle += -delay / cycle_;
+            }
+
+            try
+            {
+                segment.config.cycle(segment.bus, cycle);
+            }
+            catch (std::exception const& e)
+            {
+                DEBUG_PRINT("Segment cycle error: %s\n", e.what());
+                ++segment.errors;
+            }
+
+            // publish the image of this cycle, unless a reader is copying the snapshots right now
+            if (segment.mutex.try_lock())
+            {
+                Snapshot& snapshot = segment.snapshots[cycle % SNAPSHOTS];
+                if (segment.image_size > 0)
+                {
+                    std::memcpy(snapshot.data.data(), segment.image, segment.image_size);
+                }
+                snapshot.cycle = cycle;
+                segment.mutex.unlock();
+            }
+
+            ++segment.cycles;
+            ++cycle;
+        }
+    }
+
+
+    int64_t BusManager::snapshot(std::vector<std::vector<uint8_t>>& images)
+    {
+        if (segments_.empty())
+        {
+            return -1;
+        }
+
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(segments_.size());
+        for (auto& segment : segments_)
+        {
+            locks.emplace_back(segment->mutex);
+        }
+
+        auto find = [](SegmentContext const& segment, int64_t cycle) -> Snapshot const*
+        {
+            for (auto const& snapshot : segment.snapshots)
+            {
+                if (snapshot.cycle == cycle)
+                {
+                    return &snapshot;
+                }
+            }
+            return nullptr;
+        };
+
+        // most recent cycle available in every segment
+        int64_t common = -1;
+        for (auto const& candidate : segments_[0]->snapshots)
+        {
+            if (candidate.cycle <= common)
+            {
+                continue;
+            }
+            bool everywhere = true;
+            for (auto const& segment : segments_)
+            {
+                everywhere = everywhere and (find(*segment, candidate.cycle) != nullptr);
+            }
+            if (everywhere)
+            {
+                common = candidate.cycle;
+            }
+        }
+        if (common < 0)
+        {
+            return -1;
+        }
+
+        images.resize(segments_.size());
+        for (std::size_t i = 0; i < segments_.size(); ++i)
+        {
+            images[i] = find(*segments_[i], common)->data;
+        }
+        return common;
+    }
+}
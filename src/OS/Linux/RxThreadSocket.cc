@@ -0,0 +1,256 @@
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <future>
+
+#include "OS/Linux/RxThreadSocket.h"
+#include "Time.h"
+
+namespace kickcat
+{
+    // Period at which the receive thread checks if it shall stop when nothing is received.
+    constexpr nanoseconds RX_THREAD_POLL_TIMEOUT = 1ms;
+
+    RxThreadSocket::RxThreadSocket(std::shared_ptr<AbstractSocket> socket, int cpu, int priority, std::size_t capacity)
+        : socket_{socket}
+        , cpu_{cpu}
+        , priority_{priority}
+        , ring_{capacity}
+    {
+        event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd_ < 0)
+        {
+            THROW_SYSTEM_ERROR("eventfd()");
+        }
+    }
+
+
+    RxThreadSocket::~RxThreadSocket()
+    {
+        stop();
+        ::close(event_fd_);
+    }
+
+
+    void RxThreadSocket::open(std::string const& interface)
+    {
+        socket_->open(interface);
+        start();
+    }
+
+
+    void RxThreadSocket::setTimeout(nanoseconds timeout)
+    {
+        timeout_ = timeout;
+    }
+
+
+    void RxThreadSocket::close() noexcept
+    {
+        stop();
+        socket_->close();
+    }
+
+
+    void RxThreadSocket::start()
+    {
+        if (running_)
+        {
+            return;
+        }
+
+        // the thread configures itself before entering its loop: it never receives with the default scheduling
+        running_ = true;
+        std::promise<void> started;
+        std::future<void> configured = started.get_future();
+        thread_ = std::thread([this, &started]() { run(started); });
+        try
+        {
+            configured.get();
+        }
+        catch (...)
+        {
+            stop();
+            throw;
+        }
+    }
+
+
+    void RxThreadSocket::configure()
+    {
+        if (cpu_ >= 0)
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpu_, &cpuset);
+            int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+            if (result != 0)
+            {
+                errno = result;
+                THROW_SYSTEM_ERROR("pthread_setaffinity_np()");
+            }
+        }
+
+        if (priority_ > 0)
+        {
+            sched_param param{};
+            param.sched_priority = priority_;
+            int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (result != 0)
+            {
+                errno = result;
+                THROW_SYSTEM_ERROR("pthread_setschedparam()");
+            }
+        }
+    }
+
+
+    void RxThreadSocket::stop() noexcept
+    {
+        running_ = false;
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+
+    void RxThreadSocket::run(std::promise<void>& started)
+    {
+        try
+        {
+            configure();
+        }
+        catch (...)
+        {
+            started.set_exception(std::current_exception());
+            return;
+        }
+        started.set_value();
+
+        std::array<uint8_t, ETH_MAX_SIZE> overflow; // frames that do not fit in the ring are read here and dropped
+
+        // Block in the kernel on the socket descriptor, then read what is there without waiting: no polling period
+        // between the frame arrival and its timestamp. Sockets without a descriptor are read with a timeout instead.
+        int fd = socket_->fd();
+        if (fd >= 0)
+        {
+            socket_->setTimeout(0ns);
+        }
+        else
+        {
+            socket_->setTimeout(RX_THREAD_POLL_TIMEOUT);
+        }
+
+        timespec wake_up;
+        wake_up.tv_sec  = duration_cast<seconds>(RX_THREAD_POLL_TIMEOUT).count();
+        wake_up.tv_nsec = (RX_THREAD_POLL_TIMEOUT - duration_cast<seconds>(RX_THREAD_POLL_TIMEOUT)).count();
+
+        while (running_)
+        {
+            if (fd >= 0)
+            {
+                pollfd event{fd, POLLIN, 0};
+                if (ppoll(&event, 1, &wake_up, nullptr) <= 0)
+                {
+                    continue; // nothing received (or interrupted): check if the thread shall stop
+                }
+            }
+
+            Slot* slot = ring_.produce();
+            uint8_t* buffer = overflow.data();
+            if (slot != nullptr)
+            {
+                buffer = slot->data.data();
+            }
+
+            int32_t read = socket_->read(buffer, ETH_MAX_SIZE);
+            if (read < 0)
+            {
+                continue; // timeout: the socket (or ppoll) already waited
+            }
+            if (read == 0)
+            {
+                // socket without any frame to wait for (i.e. SocketNull): do not spin
+                sleep(RX_THREAD_POLL_TIMEOUT);
+                continue;
+            }
+
+            if (slot == nullptr)
+            {
+                ++overflows_;
+                continue;
+            }
+
+            slot->size = read;
+            slot->timestamp = since_epoch();
+            ring_.commit();
+            signal();
+        }
+    }
+
+
+    void RxThreadSocket::signal()
+    {
+        uint64_t one = 1;
+        if (::write(event_fd_, &one, sizeof(one)) < 0)
+        {
+            DEBUG_PRINT("eventfd write failed: %s\n", strerror(errno));
+        }
+    }
+
+
+    int32_t RxThreadSocket::read(uint8_t* frame, int32_t frame_size)
+    {
+        nanoseconds deadline = since_epoch() + timeout_;
+
+        while (true)
+        {
+            Slot* slot = ring_.consume();
+            if (slot != nullptr)
+            {
+                int32_t size = std::min(frame_size, slot->size);
+                std::memcpy(frame, slot->data.data(), size);
+                timestamp_ = slot->timestamp;
+                ring_.release();
+                return size;
+            }
+
+            // Ring is empty: clear pending wake ups, then check again before sleeping to not miss a frame
+            // committed in between.
+            uint64_t count;
+            if (::read(event_fd_, &count, sizeof(count)) > 0)
+            {
+                continue;
+            }
+
+            nanoseconds remaining = deadline - since_epoch();
+            if (remaining <= 0ns)
+            {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+
+            pollfd event{event_fd_, POLLIN, 0};
+            timespec wait;
+            wait.tv_sec  = duration_cast<seconds>(remaining).count();
+            wait.tv_nsec = (remaining - duration_cast<seconds>(remaining)).count();
+            if ((ppoll(&event, 1, &wait, nullptr) < 0) and (errno != EINTR))
+            {
+                return -1;
+            }
+        }
+    }
+
+
+    int32_t RxThreadSocket::write(uint8_t const* frame, int32_t frame_size)
+    {
+        return socket_->write(frame, frame_size);
+    }
+}
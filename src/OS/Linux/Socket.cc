@@ -144,6 +144,10 @@ namespace kickcat
             {
                 if (errno == EAGAIN)
                 {
+                    if (since_epoch() >= deadline)
+                    {
+                        break; // nothing to wait for (i.e. null timeout): do not sleep a polling period
+                    }
                     sleep(polling_period_);
                     continue;
                 }
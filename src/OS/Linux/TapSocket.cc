@@ -0,0 +1,78 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+
+#include <cstring>
+
+#include "OS/Linux/TapSocket.h"
+
+namespace kickcat
+{
+    void TapSocket::open(std::string const& interface)
+    {
+        fd_ = ::open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+        if (fd_ < 0)
+        {
+            THROW_SYSTEM_ERROR("open(/dev/net/tun)");
+        }
+
+        // Ethernet frames without packet information header
+        struct ifreq ifr;
+        std::memset(&ifr, 0, sizeof(ifr));
+        ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+        std::strncpy(ifr.ifr_name, interface.c_str(), sizeof(ifr.ifr_name) - 1);
+
+        int rc = ioctl(fd_, TUNSETIFF, &ifr);
+        if (rc < 0)
+        {
+            THROW_SYSTEM_ERROR("ioctl(TUNSETIFF)");
+        }
+    }
+
+    void TapSocket::setTimeout(nanoseconds timeout)
+    {
+        timeout_ = timeout;
+    }
+
+    void TapSocket::close() noexcept
+    {
+        if (fd_ == -1)
+        {
+            return;
+        }
+
+        int rc = ::close(fd_);
+        if (rc < 0)
+        {
+            perror(LOCATION ": close()"); // we cannot throw here - at least trace the error
+        }
+        fd_ = -1;
+    }
+
+    int32_t TapSocket::read(uint8_t* frame, int32_t frame_size)
+    {
+        if (timeout_ > 0ns)
+        {
+            // ppoll: sub-millisecond timeouts are not truncated
+            struct pollfd fds = { fd_, POLLIN, 0 };
+            timespec wait;
+            wait.tv_sec  = duration_cast<seconds>(timeout_).count();
+            wait.tv_nsec = (timeout_ - duration_cast<seconds>(timeout_)).count();
+            int rc = ::ppoll(&fds, 1, &wait, nullptr);
+            if (rc <= 0)
+            {
+                return -1;
+            }
+        }
+
+        return static_cast<int32_t>(::read(fd_, frame, frame_size));
+    }
+
+    int32_t TapSocket::write(uint8_t const* frame, int32_t frame_size)
+    {
+        return static_cast<int32_t>(::write(fd_, frame, frame_size));
+    }
+}
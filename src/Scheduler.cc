@@ -0,0 +1,99 @@
+#include <algorithm>
+
+#include "Scheduler.h"
+
+namespace kickcat
+{
+    Scheduler::Scheduler(Bus& bus, int32_t acyclic_budget)
+        : bus_{bus}
+        , acyclic_budget_{acyclic_budget}
+    { }
+
+
+    void Scheduler::addProcessData(int32_t group, int32_t period)
+    {
+        if (period <= 0)
+        {
+            THROW_ERROR("Invalid period");
+        }
+        process_data_.push_back({group, period});
+    }
+
+
+    void Scheduler::addTask(int32_t period, int32_t budget, Task const& task, int32_t offset)
+    {
+        if ((period <= 0) or (budget <= 0))
+        {
+            THROW_ERROR("Invalid period or budget");
+        }
+        if ((offset < 0) or (offset >= period))
+        {
+            THROW_ERROR("Invalid offset");
+        }
+        if (budget > acyclic_budget_)
+        {
+            THROW_ERROR("Task budget exceeds the acyclic budget");
+        }
+        tasks_.push_back({period, budget, task, cycle_ + offset});
+        candidates_.reserve(tasks_.size());
+    }
+
+
+    void Scheduler::cycle(Error const& error)
+    {
+        addDatagrams(error);
+        bus_.processAwaitingFrames();
+        ++cycle_;
+    }
+
+
+    void Scheduler::addDatagrams(Error const& error)
+    {
+        // acyclic tasks write in the domains of their helpers: route them to the process data frames they are budgeted in
+        Bus::CyclicFramesScope scope{bus_};
+
+        if (bus_.dcReference() != nullptr)
+        {
+            bus_.sendDriftCompensation(error);
+        }
+
+        for (auto const& pd : process_data_)
+        {
+            if ((cycle_ % pd.period) == 0)
+            {
+                bus_.sendLogicalReadWrite(pd.group, error);
+            }
+        }
+
+        // most urgent first: the later a task is relative to its period, the sooner it runs
+        candidates_.clear();
+        for (auto& task : tasks_)
+        {
+            if (task.due <= cycle_)
+            {
+                candidates_.push_back(&task);
+            }
+        }
+        std::stable_sort(candidates_.begin(), candidates_.end(), [this](AcyclicTask const* lhs, AcyclicTask const* rhs)
+        {
+            return (cycle_ - lhs->due) * rhs->period > (cycle_ - rhs->due) * lhs->period;
+        });
+
+        int32_t budget = acyclic_budget_;
+        for (auto* task : candidates_)
+        {
+            if (task->budget > budget)
+            {
+                continue; // does not fit in this cycle: a smaller task may
+            }
+            if ((task->budget <= MAX_ETHERCAT_PAYLOAD_SIZE) and (task->budget > bus_.frameFreeSpace()))
+            {
+                continue; // would open a new frame
+            }
+
+            task->task(error);
+            task->due = cycle_ + task->period;
+            budget -= task->budget;
+        }
+    }
+}
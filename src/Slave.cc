@@ -5,6 +5,48 @@
 
 namespace kickcat
 {
+    bool Slave::PIMapping::getBit(int32_t bit) const
+    {
+        int32_t pos = bit_offset + bit;
+        return (data[pos / 8] >> (pos % 8)) & 1;
+    }
+
+
+    void Slave::PIMapping::setBit(int32_t bit, bool value)
+    {
+        int32_t pos = bit_offset + bit;
+        uint8_t mask = static_cast<uint8_t>(1 << (pos % 8));
+        if (value)
+        {
+            data[pos / 8] |= mask;
+        }
+        else
+        {
+            data[pos / 8] &= static_cast<uint8_t>(~mask);
+        }
+    }
+
+
+    uint32_t Slave::PIMapping::getBits(int32_t bit, int32_t count) const
+    {
+        uint32_t value = 0;
+        for (int32_t i = 0; i < count; ++i)
+        {
+            value |= static_cast<uint32_t>(getBit(bit + i)) << i;
+        }
+        return value;
+    }
+
+
+    void Slave::PIMapping::setBits(int32_t bit, int32_t count, uint32_t value)
+    {
+        for (int32_t i = 0; i < count; ++i)
+        {
+            setBit(bit + i, (value >> i) & 1);
+        }
+    }
+
+
     void Slave::parseStrings(uint8_t const* section_start)
     {
         sii.strings.push_back(std::string_view()); // index 0 is an empty string
@@ -48,6 +48,31 @@ namespace kickcat
     }
 
 
+    char const* FoE::error_to_str(uint32_t error_code)
+    {
+        switch (error_code)
+        {
+            case 0x8000: { return "Not defined";                  }
+            case 0x8001: { return "Not found";                    }
+            case 0x8002: { return "Access denied";                }
+            case 0x8003: { return "Disk full";                    }
+            case 0x8004: { return "Illegal";                      }
+            case 0x8005: { return "Packet number wrong";          }
+            case 0x8006: { return "Already exists";               }
+            case 0x8007: { return "No user";                      }
+            case 0x8008: { return "Bootstrap only";               }
+            case 0x8009: { return "Not bootstrap";                }
+            case 0x800A: { return "No rights";                    }
+            case 0x800B: { return "Program error";                }
+
+            default:
+            {
+                return "unknown FoE error code";
+            }
+        }
+    }
+
+
     char const* ALStatus_to_string(int32_t code)
     {
         switch (code)
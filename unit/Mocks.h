@@ -56,19 +56,15 @@ namespace kickcat
 
                 // Check the content of the sent frame:
                 Frame frameCheck(data, data_size);
-                uint8_t* datagram = frameCheck.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader);
-                DatagramHeader const* header = reinterpret_cast<DatagramHeader*>(datagram);
-                uint8_t* payload = datagram + sizeof(DatagramHeader);
                 int32_t i = 0;
                 while (frameCheck.isDatagramAvailable())
                 {
+                    auto [header, payload, wkc] = frameCheck.nextDatagram();
                     if (expected_datagrams[i].check_payload)
                     {
                         EXPECT_EQ(0, std::memcmp(payload, &expected_datagrams[i].to_check, sizeof(T)));
                     }
                     EXPECT_EQ(expected_datagrams[i].cmd, header->command);
-
-                    std::tie(header, payload, std::ignore) = frameCheck.nextDatagram();
                     i++;
                 }
                 EXPECT_EQ(expected_datagrams.size(), i);
@@ -79,18 +75,27 @@ namespace kickcat
 
         template<typename T>
         void handleReply(std::vector<T> answers, uint16_t replied_wkc = 1)
+        {
+            handleReply<T>(answers, std::vector<uint16_t>(MAX_ETHERCAT_DATAGRAMS, replied_wkc));
+        }
+
+        // Reply with a specific working counter per datagram
+        template<typename T>
+        void handleReply(std::vector<T> answers, std::vector<uint16_t> replied_wkcs)
         {
             EXPECT_CALL(*this, read(::testing::_, ::testing::_))
-            .WillOnce(::testing::Invoke([this, replied_wkc, answers](uint8_t* data, int32_t)
+            .WillOnce(::testing::Invoke([this, replied_wkcs, answers](uint8_t* data, int32_t)
             {
                 auto it = answers.begin();
+                auto it_wkc = replied_wkcs.begin();
                 uint16_t* wkc = reinterpret_cast<uint16_t*>(contexts_.front().payload + contexts_.front().header->len);
 
                 DatagramHeader const* current_header = contexts_.front().header;                     // current header to check loop condition
                 do
                 {
                     std::memcpy(contexts_.front().payload, &(*it), sizeof(T));
-                    *wkc = replied_wkc;
+                    *wkc = *it_wkc;
+                    ++it_wkc;
 
                     current_header = contexts_.front().header;                                    // save current header
                     ++it;                                                       // next payload
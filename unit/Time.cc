@@ -1,3 +1,4 @@
+#include <atomic>
 
 #include "kickcat/Time.h"
 
@@ -6,9 +7,8 @@ namespace kickcat
     nanoseconds since_epoch()
     {
         auto now = time_point_cast<nanoseconds>(system_clock::now());
-        static nanoseconds mock_now = now.time_since_epoch();
+        static std::atomic<int64_t> mock_now{now.time_since_epoch().count()}; // atomic: called by BusManager threads
 
-        mock_now += 1ms;
-        return mock_now;
+        return nanoseconds(mock_now += 1000000); // +1ms
     }
 }
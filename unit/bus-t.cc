@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <cstring>
+#include <map>
+#include <queue>
 
 #include "kickcat/Link.h"
 #include "kickcat/SocketNull.h"
@@ -20,6 +22,14 @@ struct SDOAnswer
     uint8_t payload[4];
 } __attribute__((__packed__));
 
+struct SDOCompleteAnswer
+{
+    mailbox::Header header;
+    mailbox::ServiceData sdo;
+    uint32_t size;
+    uint8_t payload[32];
+} __attribute__((__packed__));
+
 
 
 // All the bus test are done like the redundancy is not activated (working only on the nominal interface).
@@ -87,7 +97,7 @@ public:
         handleReplyWriteThenRead();
 
         // reset slaves
-        for (int i = 0; i < 8; ++i)
+        for (int i = 0; i < 9; ++i)
         {
             checkSendFrameSimple(Command::BWR);
             handleReplyWriteThenRead();
@@ -232,6 +242,37 @@ public:
         }
     }
 
+    void addReadCompleteAccessSDO(uint16_t index, std::vector<uint8_t> const& data_to_reply)
+    {
+        InSequence s;
+
+        SDOCompleteAnswer answer;
+        std::memset(&answer, 0, sizeof(answer));
+        answer.header.len = static_cast<uint16_t>(10 + sizeof(uint32_t) + data_to_reply.size());
+        answer.header.address = 0;
+        answer.header.type = mailbox::Type::CoE;
+        answer.sdo.service = CoE::Service::SDO_RESPONSE;
+        answer.sdo.command = CoE::SDO::response::UPLOAD;
+        answer.sdo.complete_access = 1;
+        answer.sdo.index = index;
+        answer.sdo.subindex = 0;
+        answer.sdo.transfer_type = 0;
+        answer.size = static_cast<uint32_t>(data_to_reply.size());
+        std::memcpy(answer.payload, data_to_reply.data(), data_to_reply.size());
+
+        checkSendFrameSimple(Command::FPRD, 2);
+        io_nominal->handleReply<uint8_t>({0, 0});// can write, nothing to read
+
+        checkSendFrameSimple(Command::FPWR);  // write to mailbox
+        handleReplySimple();
+
+        checkSendFrameSimple(Command::FPRD, 2);
+        io_nominal->handleReply<uint8_t>({0, 0x08});// can write, something to read
+
+        checkSendFrameSimple(Command::FPRD);
+        io_nominal->handleReply<SDOCompleteAnswer>({answer}); // read answer
+    }
+
 protected:
     std::shared_ptr<MockSocket> io_nominal{ std::make_shared<MockSocket>() };
     std::shared_ptr<SocketNull> io_redundancy{ std::make_shared<SocketNull>() };
@@ -343,6 +384,171 @@ TEST_F(BusTest, logical_cmd)
 }
 
 
+TEST_F(BusTest, logical_cmd_addressing_group)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    slave.supported_mailbox = eeprom::MailboxProtocol::None; // disable mailbox protocol to use SII PDO mapping
+    slave.group = 3;
+
+    checkSendFrameSimple(Command::FPWR, 4);
+    io_nominal->handleReply<uint8_t>({2, 3});
+
+    uint8_t iomap[64];
+    bus.createMapping(iomap);
+
+    // no frame for other groups
+    bus.sendLogicalRead(0, [](DatagramState const&){});
+    bus.sendLogicalWrite(1, [](DatagramState const&){});
+    bus.sendLogicalReadWrite(2, [](DatagramState const&){});
+    bus.finalizeDatagrams();
+
+    int64_t logical_read = 0x0001020304050607;
+    checkSendFrameSimple(Command::LRD);
+    io_nominal->handleReply<int64_t>({logical_read});
+    bus.sendLogicalRead(3, [](DatagramState const&){});
+    bus.processAwaitingFrames();
+
+    for (int i = 0; i < 8; ++i)
+    {
+        ASSERT_EQ(7 - i, slave.input.data[i]);
+    }
+}
+
+
+TEST_F(BusTest, logical_cmd_inputs_handler)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    slave.supported_mailbox = eeprom::MailboxProtocol::None; // disable mailbox protocol to use SII PDO mapping
+
+    checkSendFrameSimple(Command::FPWR, 4);
+    io_nominal->handleReply<uint8_t>({2, 3});
+
+    uint8_t iomap[128];
+    bus.createMapping(iomap);
+
+    int32_t calls = 0;
+    bus.setInputsHandler(slave, [&](Slave& received)
+    {
+        // called from the frame processing, once the inputs are copied
+        ASSERT_EQ(&slave, &received);
+        ASSERT_EQ(7, received.input.data[0]);
+        calls++;
+    });
+
+    int64_t logical_read = 0x0001020304050607;
+    checkSendFrameSimple(Command::LRD);
+    io_nominal->handleReply<int64_t>({logical_read});
+    bus.processDataRead([](DatagramState const&){});
+    ASSERT_EQ(1, calls);
+
+    checkSendFrameSimple(Command::LRW);
+    io_nominal->handleReply<int64_t>({logical_read});
+    bus.processDataReadWrite([](DatagramState const&){});
+    ASSERT_EQ(2, calls);
+
+    // invalid working counter: inputs are not updated
+    checkSendFrameSimple(Command::LRD);
+    handleReplySimple(0);
+    bus.processDataRead([](DatagramState const&){});
+    ASSERT_EQ(2, calls);
+
+    bus.setInputsHandler(slave, nullptr);
+    checkSendFrameSimple(Command::LRD);
+    io_nominal->handleReply<int64_t>({logical_read});
+    bus.processDataRead([](DatagramState const&){});
+    ASSERT_EQ(2, calls);
+
+    Slave other;
+    ASSERT_THROW(bus.setInputsHandler(other, nullptr), Error);
+}
+
+
+TEST_F(BusTest, logical_cmd_staged_outputs)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    slave.supported_mailbox = eeprom::MailboxProtocol::None; // disable mailbox protocol to use SII PDO mapping
+
+    checkSendFrameSimple(Command::FPWR, 4);
+    io_nominal->handleReply<uint8_t>({2, 3});
+
+    uint8_t iomap[128];
+    bus.createMapping(iomap);
+
+    ASSERT_THROW(bus.stagedOutputs(slave), Error);
+    ASSERT_THROW(bus.stageOutputs(1), Error);
+
+    int64_t current = 0x0706050403020100;
+    std::memcpy(slave.output.data, &current, sizeof(int64_t));
+    bus.stageOutputs(0);
+
+    // staged but not committed: the cycle keeps sending the outputs it had when the group was staged
+    int64_t staged = 0x1716151413121110;
+    std::memcpy(bus.stagedOutputs(slave), &staged, sizeof(int64_t));
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LWR, current}));
+    io_nominal->handleReply<int64_t>({0});
+    bus.processDataWrite([](DatagramState const&){});
+
+    // committed: picked up by the next cycle
+    ASSERT_EQ(1, bus.commitOutputs(0));
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRW, staged}));
+    io_nominal->handleReply<int64_t>({0});
+    bus.processDataReadWrite([](DatagramState const&){});
+    ASSERT_EQ(0, std::memcmp(slave.output.data, &staged, sizeof(int64_t)));
+
+    // the staging area keeps the last commit: a partial update sends the other outputs unchanged
+    bus.stagedOutputs(slave)[0] = 0x42;
+    bus.commitOutputs(0);
+    staged = (staged & ~int64_t{0xFF}) | 0x42;
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LWR, staged}));
+    io_nominal->handleReply<int64_t>({0});
+    bus.sendLogicalWrite(0, [](DatagramState const&){});
+    bus.processAwaitingFrames();
+}
+
+
+TEST_F(BusTest, logical_cmd_bit_packed)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    slave.supported_mailbox = eeprom::MailboxProtocol::None; // disable mailbox protocol to use SII PDO mapping
+
+    eeprom::PDOEntry tx_pdo{0x6000, 1, 0, 0, 3, 0};
+    eeprom::PDOEntry rx_pdo{0x7000, 1, 0, 0, 2, 0};
+    slave.sii.TxPDO = {&tx_pdo};
+    slave.sii.RxPDO = {&rx_pdo};
+    slave.input.size = 0;
+
+    bus.configureMappingLayout(Bus::MappingLayout::BIT_PACKED);
+
+    checkSendFrameSimple(Command::FPWR, 4);
+    io_nominal->handleReply<uint8_t>({2, 3});
+
+    uint8_t iomap[2] = {0, 0};
+    bus.createMapping(iomap);
+    ASSERT_EQ(1, slave.input.bsize);
+    ASSERT_EQ(0, slave.input.bit_offset);
+    ASSERT_EQ(iomap,     slave.input.data);
+    ASSERT_EQ(iomap + 1, slave.output.data);  // client buffer mirrors the frames
+
+    checkSendFrameSimple(Command::LRD);
+    io_nominal->handleReply<uint8_t>({0xFD});
+    bus.processDataRead([](DatagramState const&){});
+    ASSERT_EQ(5, slave.input.getBits(0, 3));
+
+    slave.output.setBits(0, 2, 2);
+    std::vector<DatagramCheck<uint8_t>> expecteds(1, {Command::LWR, 2});
+    io_nominal->checkSendFrame(expecteds);
+    io_nominal->handleReply<uint8_t>({0});
+    bus.processDataWrite([](DatagramState const&){});
+}
+
 TEST_F(BusTest, AL_status_error)
 {
     auto& slave = bus.slaves().at(0);
@@ -442,6 +648,44 @@ TEST_F(BusTest, write_SDO_OK)
     bus.writeSDO(slave, 0x1018, 1, false, &data, data_size);
 }
 
+TEST_F(BusTest, write_SDO_event_driven_OK)
+{
+    InSequence s;
+
+    int32_t data = 0xCAFEDECA;
+    uint32_t data_size = sizeof(data);
+    auto& slave = bus.slaves().at(0);
+    bus.configureMessageWait(Bus::MessageWaitMode::EVENT_DRIVEN);
+
+    SDOAnswer answer;
+    std::memset(&answer, 0, sizeof(answer));
+    SDOAnswer skip = answer;  // zeroed: mailbox state is empty
+
+    // write message, read the (not yet available) answer and check mailbox state in one frame
+    std::vector<DatagramCheck<uint8_t>> write_read_check{{Command::FPWR, 0, false}, {Command::FPRD, 0, false}, {Command::FPRD, 0, false}};
+    io_nominal->checkSendFrame(write_read_check);
+    io_nominal->handleReply<SDOAnswer>({skip, skip, skip}, {0, 0, 1});   // mailbox full: message not written
+
+    io_nominal->checkSendFrame(write_read_check);
+    io_nominal->handleReply<SDOAnswer>({skip, skip, skip}, {1, 0, 1});   // message written, nothing to read
+
+    answer.header.len = 10;
+    answer.header.address = 0;
+    answer.header.type = mailbox::Type::CoE;
+    answer.sdo.service = CoE::Service::SDO_RESPONSE;
+    answer.sdo.command = CoE::SDO::response::DOWNLOAD;
+    answer.sdo.index = 0x1018;
+    answer.sdo.subindex = 1;
+
+    std::vector<DatagramCheck<uint8_t>> read_check{{Command::FPRD, 0, false}, {Command::FPRD, 0, false}};
+    io_nominal->checkSendFrame(read_check);
+    io_nominal->handleReply<SDOAnswer>({answer, skip}, {1, 1});          // answer read
+
+    bus.writeSDO(slave, 0x1018, 1, false, &data, data_size);
+    ASSERT_TRUE(slave.mailbox.to_send.empty());
+    ASSERT_FALSE(slave.mailbox.can_read);
+}
+
 TEST_F(BusTest, write_SDO_timeout)
 {
     InSequence s;
@@ -510,6 +754,140 @@ TEST_F(BusTest, read_SDO_OK)
     ASSERT_EQ(4, data_size);
 }
 
+TEST_F(BusTest, read_SDO_async_OK)
+{
+    InSequence s;
+
+    int32_t data = 0;
+    uint32_t data_size = sizeof(data);
+    auto& slave = bus.slaves().at(0);
+
+    int32_t callback_counter = 0;
+    auto sdo = bus.readSDOAsync(slave, 0x1018, 1, Bus::Access::PARTIAL, &data, &data_size,
+        [&](AbstractMessage const& message)
+        {
+            ASSERT_EQ(MessageStatus::SUCCESS, message.status());
+            ++callback_counter;
+        });
+    ASSERT_EQ(MessageStatus::RUNNING, sdo->status());
+
+    auto error = [](DatagramState const&){ throw std::logic_error(""); };
+
+    checkSendFrameSimple(Command::FPRD, 2);
+    io_nominal->handleReply<uint8_t>({0, 0});// can write, nothing to read
+    bus.checkMailboxes(error);
+
+    checkSendFrameSimple(Command::FPWR);  // write to mailbox
+    handleReplySimple();
+    bus.processMessages(error);
+    ASSERT_EQ(0, callback_counter);
+
+    checkSendFrameSimple(Command::FPRD, 2);
+    io_nominal->handleReply<uint8_t>({0, 0x08});// can write, something to read
+    bus.checkMailboxes(error);
+
+    SDOAnswer answer;
+    answer.header.len = 10;
+    answer.header.address = 0;
+    answer.header.type = mailbox::Type::CoE;
+    answer.sdo.service = CoE::Service::SDO_RESPONSE;
+    answer.sdo.command = CoE::SDO::response::UPLOAD;
+    answer.sdo.index = 0x1018;
+    answer.sdo.subindex = 1;
+    answer.sdo.transfer_type = 1;
+    answer.sdo.block_size = 0;
+    *reinterpret_cast<uint32_t*>(answer.payload) = 0xDEADBEEF;
+
+    checkSendFrameSimple(Command::FPRD);
+    io_nominal->handleReply<SDOAnswer>({answer}); // read answer
+    bus.processMessages(error);
+
+    ASSERT_EQ(1, callback_counter);
+    ASSERT_EQ(MessageStatus::SUCCESS, sdo->status());
+    ASSERT_EQ(0xDEADBEEF, data);
+    ASSERT_EQ(4, data_size);
+}
+
+TEST_F(BusTest, read_SDO_async_timeout)
+{
+    InSequence s;
+
+    int32_t data = 0;
+    uint32_t data_size = sizeof(data);
+    auto& slave = bus.slaves().at(0);
+
+    int32_t callback_counter = 0;
+    auto sdo = bus.readSDOAsync(slave, 0x1018, 1, Bus::Access::PARTIAL, &data, &data_size,
+        [&](AbstractMessage const& message)
+        {
+            ASSERT_EQ(MessageStatus::TIMEOUT, message.status());
+            ++callback_counter;
+        }, 10ms);
+
+    auto error = [](DatagramState const&){ throw std::logic_error(""); };
+
+    checkSendFrameSimple(Command::FPRD, 2);
+    io_nominal->handleReply<uint8_t>({0, 0});// can write, nothing to read
+    bus.checkMailboxes(error);
+
+    checkSendFrameSimple(Command::FPWR);  // write to mailbox
+    handleReplySimple();
+    bus.processMessages(error);
+    ASSERT_EQ(0, callback_counter);
+
+    // no answer: the SDO is finalized once its deadline is reached (the test clock moves by 1ms per call)
+    for (int32_t i = 0; i < 10; ++i)
+    {
+        since_epoch();
+    }
+    bus.processMessages(error); // nothing to send nor read: no frame
+    ASSERT_EQ(1, callback_counter);
+    ASSERT_EQ(MessageStatus::TIMEOUT, sdo->status());
+
+    ASSERT_THROW(bus.readSDOAsync(slave, 0x1018, 1, Bus::Access::EMULATE_COMPLETE, &data, &data_size, nullptr), Error);
+}
+
+TEST_F(BusTest, read_SDO_async_timeout_cyclic)
+{
+    InSequence s;
+
+    int32_t data = 0;
+    uint32_t data_size = sizeof(data);
+    auto& slave = bus.slaves().at(0);
+
+    int32_t callback_counter = 0;
+    auto sdo = bus.readSDOAsync(slave, 0x1018, 1, Bus::Access::PARTIAL, &data, &data_size,
+        [&](AbstractMessage const&) { ++callback_counter; }, 10ms);
+
+    auto error = [](DatagramState const&){ throw std::logic_error(""); };
+
+    // cyclic loop built on the send* helpers
+    checkSendFrameSimple(Command::FPRD, 2);
+    io_nominal->handleReply<uint8_t>({0, 0});// can write, nothing to read
+    bus.sendMailboxesWriteChecks(error);
+    bus.sendMailboxesReadChecks(error);
+    bus.processAwaitingFrames();
+
+    checkSendFrameSimple(Command::FPWR);  // write to mailbox
+    handleReplySimple();
+    bus.sendWriteMessages(error);
+    bus.sendReadMessages(error);
+    bus.processAwaitingFrames();
+    ASSERT_EQ(0, callback_counter);
+
+    // no answer: the next cycle finalizes the SDO once its deadline is reached (the test clock moves by 1ms per call)
+    for (int32_t i = 0; i < 10; ++i)
+    {
+        since_epoch();
+    }
+    bus.sendWriteMessages(error);
+    bus.sendReadMessages(error);
+    ASSERT_EQ(1, callback_counter);
+    ASSERT_EQ(MessageStatus::TIMEOUT, sdo->status());
+    ASSERT_FALSE(slave.mailbox.hasMessageToSend());
+    ASSERT_TRUE(slave.mailbox.to_process.empty());
+}
+
 TEST_F(BusTest, read_SDO_emulated_complete_access_OK)
 {
     addReadEmulatedSDO<uint32_t>(0x1018, { 3, 0xCAFE0000, 0x0000DECA, 0xFADEFACE });
@@ -565,6 +943,42 @@ TEST_F(BusTest, detect_mapping_CoE)
 }
 
 
+TEST_F(BusTest, detect_mapping_CoE_complete_access)
+{
+    InSequence s;
+
+    eeprom::GeneralEntry general;
+    std::memset(&general, 0, sizeof(general));
+    general.SDO_complete_access = 1;
+    auto& slave = bus.slaves().at(0);
+    slave.sii.general = &general;
+
+    // subindex 0 is padded on 16 bits
+    addReadCompleteAccessSDO(CoE::SM_COM_TYPE,    { 2, 0, SyncManagerType::Output, SyncManagerType::Input });
+
+    addReadCompleteAccessSDO(CoE::SM_CHANNEL + 0, { 2, 0, 0x0A, 0x1A, 0x0B, 0x1A });
+    addReadCompleteAccessSDO(0x1A0A,              { 2, 0,  8, 0, 0, 0,  8, 0, 0, 0 });
+    addReadCompleteAccessSDO(0x1A0B,              { 1, 0, 16, 0, 0, 0 });
+
+    addReadCompleteAccessSDO(CoE::SM_CHANNEL + 1, { 1, 0, 0x0A, 0x16 });
+    addReadCompleteAccessSDO(0x160A,              { 3, 0, 16, 0, 0, 0, 16, 0, 0, 0, 1, 0, 0, 0 });
+
+    // SM/FMMU configuration
+    checkSendFrameSimple(Command::FPWR, 4);
+    io_nominal->handleReply<uint8_t>({2, 3});
+
+    uint8_t iomap[64];
+    bus.createMapping(iomap);
+
+    ASSERT_EQ(32, slave.output.size);
+    ASSERT_EQ(4,  slave.output.bsize);
+    ASSERT_EQ(0,  slave.output.sync_manager);
+    ASSERT_EQ(33, slave.input.size);
+    ASSERT_EQ(5,  slave.input.bsize);
+    ASSERT_EQ(1,  slave.input.sync_manager);
+}
+
+
 TEST_F(BusTest, pdio_watchdogs)
 {
     auto clearForInit = [&]()
@@ -611,3 +1025,537 @@ TEST_F(BusTest, send_get_DL_status)
     ASSERT_EQ(slave.dl_status.LOOP_port0, 1);
     ASSERT_EQ(slave.dl_status.LOOP_port1, 1);
 }
+
+TEST_F(BusTest, configure_sync)
+{
+    auto& slave = bus.slaves().at(0);
+    slave.dc.supported = false;
+    ASSERT_THROW(bus.configureSync(slave, 1ms), Error);
+
+    slave.dc.supported = true;
+    ASSERT_THROW(bus.configureSync(slave, 0ms), Error);
+
+    InSequence s;
+
+    // stop sync signals and get system time
+    io_nominal->checkSendFrame<uint8_t>({{Command::FPWR, 0}, {Command::FPWR, 0}, {Command::FPRD, 0, false}});
+    io_nominal->handleReply<uint8_t>({0, 0, 0});
+
+    // start time, cycles and activation with SYNC1
+    io_nominal->checkSendFrame<uint8_t>({{Command::FPWR, 0, false}, {Command::FPWR, 0, false}, {Command::FPWR, 0, false}, {Command::FPWR, 0x07}});
+    io_nominal->handleReply<uint8_t>({0, 0, 0, 0});
+
+    bus.configureSync(slave, 1ms, 500us);
+}
+
+TEST_F(BusTest, drift_compensation_without_dc)
+{
+    ASSERT_EQ(nullptr, bus.dcReference());
+    ASSERT_THROW(bus.sendDriftCompensation([](DatagramState const&){}), Error);
+}
+
+TEST_F(BusTest, drift_compensation_in_process_data)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    slave.supported_mailbox = eeprom::MailboxProtocol::None; // disable mailbox protocol to use SII PDO mapping
+
+    checkSendFrameSimple(Command::FPWR, 4);
+    io_nominal->handleReply<uint8_t>({2, 3, 0, 0});
+
+    uint8_t iomap[128];
+    bus.createMapping(iomap);
+
+    // distributed clocks: the only slave is the reference clock
+    checkSendFrameSimple(Command::FPRD, 2);     // DC features, DL status
+    io_nominal->handleReply<uint16_t>({0x0004, 0x0530});
+    checkSendFrameSimple(Command::BWR);         // latch receive times
+    handleReplyWriteThenRead();
+    checkSendFrameSimple(Command::FPRD, 2);     // receive times
+    io_nominal->handleReply<uint8_t>({0, 0});
+    checkSendFrameSimple(Command::FPWR, 2);     // system time offset and delay
+    io_nominal->handleReply<uint8_t>({0, 0});
+    checkSendFrameSimple(Command::FRMW);        // static drift compensation
+    handleReplySimple();
+    bus.initDistributedClocks(1);
+    ASSERT_EQ(&slave, bus.dcReference());
+
+    // the reference clock time is distributed in the frame of the process data
+    auto error = [](DatagramState const&){ throw std::logic_error(""); };
+    std::vector<std::pair<Command, std::function<void()>>> exchanges
+    {
+        {Command::LRD, [&]() { bus.processDataRead(error);      }},
+        {Command::LWR, [&]() { bus.processDataWrite(error);     }},
+        {Command::LRW, [&]() { bus.processDataReadWrite(error); }},
+    };
+    uint64_t system_time = 0x0102030405060708;
+    for (auto const& [command, exchange] : exchanges)
+    {
+        io_nominal->checkSendFrame<uint8_t>({{Command::FRMW, 0, false}, {command, 0, false}});
+        io_nominal->handleReply<uint64_t>({system_time, 0});
+        exchange();
+        ASSERT_EQ(system_time, bus.dcSystemTime());
+        system_time += 1000;
+    }
+}
+
+
+// CoE slaves answering SDO uploads from their object dictionary: checks how the requests are interleaved between slaves
+class MailboxSlavesSocket : public AbstractSocket
+{
+public:
+    static constexpr uint16_t MAILBOX_OUT = 0x1000;
+    static constexpr uint16_t MAILBOX_IN  = 0x1100;
+
+    struct Entry
+    {
+        uint32_t value;
+        uint8_t size;
+    };
+    using Dictionary = std::map<std::pair<uint16_t, uint8_t>, Entry>;
+
+    struct SlaveState
+    {
+        Dictionary dictionary;
+        std::vector<uint8_t> answer;    // answer waiting in the slave mailbox
+        bool in_flight{false};          // an SDO was received and is not read yet
+    };
+
+    MailboxSlavesSocket(std::map<uint16_t, Dictionary> const& dictionaries)
+    {
+        for (auto const& [address, dictionary] : dictionaries)
+        {
+            slaves[address].dictionary = dictionary;
+        }
+    }
+
+    void open(std::string const&) override {}
+    void setTimeout(nanoseconds) override {}
+    void close() noexcept override {}
+
+    int32_t write(uint8_t const* data, int32_t data_size) override
+    {
+        Frame frame(data, data_size);
+        while (frame.isDatagramAvailable())
+        {
+            auto [header, payload, wkc] = frame.nextDatagram();
+            uint16_t* answer_wkc = reinterpret_cast<uint16_t*>(payload + header->len);
+            auto it = slaves.find(static_cast<uint16_t>(header->address & 0xFFFF));
+            if (it == slaves.end())
+            {
+                continue;
+            }
+            SlaveState& slave = it->second;
+            uint16_t offset = static_cast<uint16_t>(header->address >> 16);
+
+            *answer_wkc = 1;
+            if ((header->command == Command::FPRD) and (offset == reg::SYNC_MANAGER_1 + reg::SM_STATS))
+            {
+                payload[0] = slave.answer.empty() ? 0 : 0x08;
+            }
+            else if ((header->command == Command::FPRD) and (offset == reg::SYNC_MANAGER_0 + reg::SM_STATS))
+            {
+                payload[0] = slave.in_flight ? 0x08 : 0; // one request at once in the slave mailbox
+            }
+            else if ((header->command == Command::FPWR) and (offset == MAILBOX_OUT))
+            {
+                if (slave.in_flight)
+                {
+                    overlaps++;
+                }
+                slave.in_flight = true;
+                answer(slave, payload);
+
+                int32_t busy = 0;
+                for (auto const& [address, state] : slaves)
+                {
+                    busy += state.in_flight;
+                }
+                max_in_flight = std::max(max_in_flight, busy);
+            }
+            else if ((header->command == Command::FPRD) and (offset == MAILBOX_IN))
+            {
+                if (slave.answer.empty())
+                {
+                    *answer_wkc = 0;
+                    continue;
+                }
+                std::memcpy(payload, slave.answer.data(), slave.answer.size());
+                slave.answer.clear();
+                slave.in_flight = false;
+            }
+        }
+
+        replies.emplace(frame.data(), frame.data() + data_size);
+        return data_size;
+    }
+
+    int32_t read(uint8_t* data, int32_t data_size) override
+    {
+        if (replies.empty())
+        {
+            return -1;
+        }
+        int32_t size = std::min(data_size, static_cast<int32_t>(replies.front().size()));
+        std::memcpy(data, replies.front().data(), size);
+        replies.pop();
+        return size;
+    }
+
+    void answer(SlaveState& slave, uint8_t const* request)
+    {
+        auto coe = reinterpret_cast<mailbox::ServiceData const*>(request + sizeof(mailbox::Header));
+
+        // object data: one entry, or subindex 0 (padded on 16 bits) then every entry with complete access
+        std::vector<uint8_t> data;
+        auto append = [&](uint8_t subindex)
+        {
+            auto it = slave.dictionary.find({coe->index, subindex});
+            if (it == slave.dictionary.end())
+            {
+                return false;
+            }
+            uint8_t const* value = reinterpret_cast<uint8_t const*>(&it->second.value);
+            data.insert(data.end(), value, value + it->second.size);
+            return true;
+        };
+        if (not append(coe->subindex))
+        {
+            return; // unknown object: the slave never answers
+        }
+        if (coe->complete_access)
+        {
+            ++complete_accesses;
+            uint8_t entries = data[0];
+            data.resize(2, 0);
+            for (uint8_t subindex = 1; subindex <= entries; ++subindex)
+            {
+                append(subindex);
+            }
+        }
+
+        SDOCompleteAnswer answer;
+        std::memset(&answer, 0, sizeof(answer));
+        answer.header.type = mailbox::Type::CoE;
+        answer.sdo.service = CoE::Service::SDO_RESPONSE;
+        answer.sdo.command = CoE::SDO::response::UPLOAD;
+        answer.sdo.index = coe->index;
+        answer.sdo.subindex = coe->subindex;
+        if (coe->complete_access)
+        {
+            answer.header.len = static_cast<uint16_t>(10 + data.size());
+            answer.sdo.complete_access = 1;
+            answer.sdo.size_indicator = 1;
+            answer.size = static_cast<uint32_t>(data.size());
+            std::memcpy(answer.payload, data.data(), data.size());
+        }
+        else
+        {
+            answer.header.len = 10;
+            answer.sdo.transfer_type = 1;
+            answer.sdo.block_size = static_cast<uint8_t>(4 - data.size());
+            std::memcpy(&answer.size, data.data(), data.size()); // expedited: the data takes the place of the size
+        }
+
+        slave.answer.resize(256, 0);
+        std::memcpy(slave.answer.data(), &answer, sizeof(answer));
+    }
+
+    std::map<uint16_t, SlaveState> slaves;
+    std::queue<std::vector<uint8_t>> replies;
+    int32_t overlaps{0};        // SDO written while the slave was still processing the previous one
+    int32_t max_in_flight{0};   // slaves with an SDO in flight at the same time
+    int32_t complete_accesses{0}; // SDO uploads of a whole object
+};
+
+
+// Bus of CoE slaves with the same object dictionary, detecting their mapping from it
+class DetectMappingTest : public testing::Test
+{
+public:
+    static constexpr int32_t SLAVES = 3;
+
+    // SM0 outputs: 0x160A (16 + 16 bits) and 0x160B (32 + 16 bits) - SM1 inputs: 0x1A0A (8 + 8 bits) and 0x1A0B (16 + 8 bits)
+    MailboxSlavesSocket::Dictionary dictionary
+    {
+        {{CoE::SM_COM_TYPE, 0}, {2, 1}},
+        {{CoE::SM_COM_TYPE, 1}, {SyncManagerType::Output, 1}},
+        {{CoE::SM_COM_TYPE, 2}, {SyncManagerType::Input,  1}},
+        {{CoE::SM_CHANNEL + 0, 0}, {2, 1}},
+        {{CoE::SM_CHANNEL + 0, 1}, {0x160A, 2}},
+        {{CoE::SM_CHANNEL + 0, 2}, {0x160B, 2}},
+        {{0x160A, 0}, {2, 1}}, {{0x160A, 1}, {16, 4}}, {{0x160A, 2}, {16, 4}},
+        {{0x160B, 0}, {2, 1}}, {{0x160B, 1}, {32, 4}}, {{0x160B, 2}, {16, 4}},
+        {{CoE::SM_CHANNEL + 1, 0}, {2, 1}},
+        {{CoE::SM_CHANNEL + 1, 1}, {0x1A0A, 2}},
+        {{CoE::SM_CHANNEL + 1, 2}, {0x1A0B, 2}},
+        {{0x1A0A, 0}, {2, 1}}, {{0x1A0A, 1}, {8,  4}}, {{0x1A0A, 2}, {8,  4}},
+        {{0x1A0B, 0}, {2, 1}}, {{0x1A0B, 1}, {16, 4}}, {{0x1A0B, 2}, {8,  4}},
+    };
+
+    void createBus(eeprom::GeneralEntry const* general = nullptr)
+    {
+        std::map<uint16_t, MailboxSlavesSocket::Dictionary> dictionaries;
+        for (uint16_t i = 0; i < SLAVES; ++i)
+        {
+            dictionaries[static_cast<uint16_t>(0x1001 + i)] = dictionary;
+        }
+        socket = std::make_shared<MailboxSlavesSocket>(dictionaries);
+        bus = std::make_unique<Bus>(std::make_shared<Link>(socket));
+        bus->configureWaitLatency(0ns, 0ns);
+
+        for (uint16_t i = 0; i < SLAVES; ++i)
+        {
+            Slave slave;
+            slave.address = static_cast<uint16_t>(0x1001 + i);
+            slave.is_static_mapping = false;
+            slave.supported_mailbox = eeprom::MailboxProtocol::CoE;
+            slave.mailbox.recv_offset = MailboxSlavesSocket::MAILBOX_OUT;
+            slave.mailbox.recv_size   = 256;
+            slave.mailbox.send_offset = MailboxSlavesSocket::MAILBOX_IN;
+            slave.mailbox.send_size   = 256;
+            slave.sii.syncManagers_ = {&sm_out, &sm_in};
+            slave.sii.general = general;
+            bus->slaves().push_back(slave);
+        }
+    }
+
+    void checkMapping()
+    {
+        // every slave has its SDO in flight at the same time, but never more than one
+        ASSERT_EQ(0, socket->overlaps);
+        ASSERT_EQ(SLAVES, socket->max_in_flight);
+        for (auto const& slave : bus->slaves())
+        {
+            ASSERT_EQ(10, slave.output.bsize);
+            ASSERT_EQ(5,  slave.input.bsize);
+        }
+    }
+
+    eeprom::SyncManagerEntry sm_out{0x1800, 0, 0x64, 0, 1, 3};
+    eeprom::SyncManagerEntry sm_in {0x1C00, 0, 0x20, 0, 1, 4};
+    std::shared_ptr<MailboxSlavesSocket> socket;
+    std::unique_ptr<Bus> bus;
+    uint8_t iomap[256];
+};
+
+
+TEST_F(DetectMappingTest, parallel)
+{
+    createBus();
+    bus->createMapping(iomap);
+    checkMapping();
+}
+
+
+TEST_F(DetectMappingTest, parallel_complete_access)
+{
+    eeprom::GeneralEntry general{};
+    general.SDO_complete_access = 1;
+    createBus(&general);
+    bus->createMapping(iomap);
+    checkMapping();
+
+    // one upload per object: SM types, two SM channels and four PDOs
+    ASSERT_EQ(7 * SLAVES, socket->complete_accesses);
+}
+
+
+TEST_F(DetectMappingTest, error_withdraws_uploads)
+{
+    // slaves never answer on their inputs: the other slaves uploads are still in flight when the first one times out
+    dictionary.erase({CoE::SM_CHANNEL + 1, 0});
+    createBus();
+    ASSERT_THROW(bus->createMapping(iomap), Error);
+
+    for (auto& slave : bus->slaves())
+    {
+        ASSERT_FALSE(slave.mailbox.hasMessageToSend());
+        ASSERT_TRUE(slave.mailbox.to_process.empty());
+    }
+}
+
+
+TEST(Bus, frame_packing)
+{
+    std::shared_ptr<MockSocket> io_nominal{ std::make_shared<MockSocket>() };
+    std::shared_ptr<SocketNull> io_redundancy{ std::make_shared<SocketNull>() };
+    std::shared_ptr<Link> link = std::make_shared<Link>(io_nominal, io_redundancy, nullptr);
+    Bus bus{ link };
+    EXPECT_CALL(*io_nominal, setTimeout(::testing::_)).WillRepeatedly(Return());
+
+    eeprom::SyncManagerEntry sm{0x1000, 0, 0x20, 0, 1, 4};
+    for (int32_t size : {1000, 600, 600, 400})
+    {
+        Slave slave;
+        slave.is_static_mapping = true;
+        slave.input.bsize = size;
+        slave.input.sync_manager = 0;
+        slave.output.bsize = 0;
+        slave.sii.syncManagers_ = {&sm};
+        bus.slaves().push_back(slave);
+    }
+
+    auto map = [&](Bus::FramePacking packing)
+    {
+        bus.configureFramePacking(packing);
+        io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(8, {Command::FPWR, 0, false}));
+        io_nominal->handleReply<uint8_t>(std::vector<uint8_t>(8, 0));
+        std::vector<uint8_t> iomap(4096);
+        bus.createMapping(iomap.data());
+    };
+
+    // in order: 1000 | 600 + 600 | 400
+    map(Bus::FramePacking::IN_ORDER);
+    ASSERT_EQ(0,    bus.slaves()[0].input.address);
+    ASSERT_EQ(1486, bus.slaves()[1].input.address);
+    ASSERT_EQ(2086, bus.slaves()[2].input.address);
+    ASSERT_EQ(2972, bus.slaves()[3].input.address);
+    nanoseconds in_order = bus.predictedWireTime();
+
+    // first fit: 1000 + 400 | 600 + 600
+    map(Bus::FramePacking::FIRST_FIT);
+    ASSERT_EQ(0,    bus.slaves()[0].input.address);
+    ASSERT_EQ(1486, bus.slaves()[1].input.address);
+    ASSERT_EQ(2086, bus.slaves()[2].input.address);
+    ASSERT_EQ(1000, bus.slaves()[3].input.address);
+    ASSERT_LT(bus.predictedWireTime(), in_order);
+}
+
+
+TEST(Bus, inputs_handler_multiple_frames)
+{
+    std::shared_ptr<MockSocket> io_nominal{ std::make_shared<MockSocket>() };
+    std::shared_ptr<Link> link = std::make_shared<Link>(io_nominal);
+    Bus bus{ link };
+    EXPECT_CALL(*io_nominal, setTimeout(::testing::_)).WillRepeatedly(Return());
+
+    eeprom::SyncManagerEntry sm{0x1000, 0, 0x20, 0, 1, 4};
+    for (int32_t i = 0; i < 2; ++i)
+    {
+        Slave slave;
+        slave.is_static_mapping = true;
+        slave.input.bsize = 1000;   // one slave per frame
+        slave.input.sync_manager = 0;
+        slave.output.bsize = 0;
+        slave.sii.syncManagers_ = {&sm};
+        bus.slaves().push_back(slave);
+    }
+
+    InSequence s;
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(4, {Command::FPWR, 0, false}));
+    io_nominal->handleReply<uint8_t>(std::vector<uint8_t>(4, 0));
+    std::vector<uint8_t> iomap(4096);
+    bus.createMapping(iomap.data());
+
+    // frames read when each handler runs: the first slave is serviced before the second frame is read
+    std::vector<int64_t> frames_read;
+    int64_t const mapping_frames = link->statistics().frames_nominal;
+    for (auto& slave : bus.slaves())
+    {
+        bus.setInputsHandler(slave, [&](Slave&) { frames_read.push_back(link->statistics().frames_nominal - mapping_frames); });
+    }
+
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(1, {Command::LRD, 0, false}));
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(1, {Command::LRD, 0, false}));
+    io_nominal->handleReply<uint8_t>({0});
+    io_nominal->handleReply<uint8_t>({0});
+    bus.processDataRead([](DatagramState const&){});
+    ASSERT_EQ((std::vector<int64_t>{1, 2}), frames_read);
+
+    // a throwing handler does not break the frame processing: its error is rethrown once done
+    bus.setInputsHandler(bus.slaves()[0], [](Slave&) { throw std::runtime_error("handler"); });
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(1, {Command::LRD, 0, false}));
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(1, {Command::LRD, 0, false}));
+    io_nominal->handleReply<uint8_t>({0});
+    io_nominal->handleReply<uint8_t>({0});
+    ASSERT_THROW(bus.processDataRead([](DatagramState const&){}), std::runtime_error);
+    ASSERT_EQ((std::vector<int64_t>{1, 2, 4}), frames_read);
+
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(1, {Command::LRD, 0, false}));
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(1, {Command::LRD, 0, false}));
+    io_nominal->handleReply<uint8_t>({0});
+    io_nominal->handleReply<uint8_t>({0});
+    ASSERT_THROW(bus.processDataRead([](DatagramState const&){}), std::runtime_error);
+    ASSERT_EQ((std::vector<int64_t>{1, 2, 4, 6}), frames_read);
+}
+
+
+TEST(Bus, latency_priority)
+{
+    std::shared_ptr<MockSocket> io_nominal{ std::make_shared<MockSocket>() };
+    std::shared_ptr<SocketNull> io_redundancy{ std::make_shared<SocketNull>() };
+    std::shared_ptr<Link> link = std::make_shared<Link>(io_nominal, io_redundancy, nullptr);
+    Bus bus{ link };
+    EXPECT_CALL(*io_nominal, setTimeout(::testing::_)).WillRepeatedly(Return());
+
+    eeprom::SyncManagerEntry sm{0x1000, 0, 0x20, 0, 1, 4};
+    for (int32_t size : {100, 8, 100, 8})
+    {
+        Slave slave;
+        slave.is_static_mapping = true;
+        slave.input.bsize = size;
+        slave.input.sync_manager = 0;
+        slave.output.bsize = 0;
+        slave.sii.syncManagers_ = {&sm};
+        bus.slaves().push_back(slave);
+    }
+
+    // two critical axes among bulk I/O: they get a small dedicated frame, sent first
+    bus.slaves()[1].priority = 1;
+    bus.slaves()[3].priority = 1;
+
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>(8, {Command::FPWR, 0, false}));
+    io_nominal->handleReply<uint8_t>(std::vector<uint8_t>(8, 0));
+    std::vector<uint8_t> iomap(4096);
+    bus.createMapping(iomap.data());
+
+    ASSERT_EQ(0,    bus.slaves()[1].input.address);
+    ASSERT_EQ(8,    bus.slaves()[3].input.address);
+    ASSERT_EQ(1486, bus.slaves()[0].input.address);
+    ASSERT_EQ(1586, bus.slaves()[2].input.address);
+
+    // the critical datagram goes out in its own Ethernet frame, before the bulk one
+    auto checkFrame = [](uint32_t address, uint16_t len)
+    {
+        return Invoke([address, len](uint8_t const* data, int32_t data_size)
+        {
+            Frame frame{data, data_size};
+            auto [header, payload, wkc] = frame.nextDatagram();
+            EXPECT_EQ(Command::LRD, header->command);
+            EXPECT_EQ(address, header->address);
+            EXPECT_EQ(len,     header->len);
+            EXPECT_EQ(0,       header->multiple);
+            return data_size;
+        });
+    };
+    InSequence s;
+    EXPECT_CALL(*io_nominal, write(_,_)).WillOnce(checkFrame(0,    16));
+    EXPECT_CALL(*io_nominal, write(_,_)).WillOnce(checkFrame(1486, 200));
+    bus.sendLogicalRead([](DatagramState const&){});
+    bus.finalizeDatagrams();
+}
+
+
+TEST_F(BusTest, logical_cmd_split_areas)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    slave.supported_mailbox = eeprom::MailboxProtocol::None; // disable mailbox protocol to use SII PDO mapping
+    bus.configureFramePacking(Bus::FramePacking::IN_ORDER, Bus::ProcessDataAreas::SPLIT);
+
+    checkSendFrameSimple(Command::FPWR, 4);
+    io_nominal->handleReply<uint8_t>({2, 3});
+
+    uint8_t iomap[128];
+    bus.createMapping(iomap);
+    ASSERT_EQ(0,    slave.input.address);
+    ASSERT_EQ(1486, slave.output.address);
+
+    // inputs are read and outputs written in distinct datagrams
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint8_t>>{{Command::LRD, 0, false}, {Command::LWR, 0, false}});
+    io_nominal->handleReply<uint8_t>({0, 0});
+    bus.processDataReadWrite([](DatagramState const&){});
+}
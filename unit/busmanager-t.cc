@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <system_error>
+
+#include "kickcat/OS/Linux/BusManager.h"
+#include "kickcat/SocketNull.h"
+
+using namespace kickcat;
+
+TEST(BusManager, invalid_configuration)
+{
+    ASSERT_THROW(BusManager(0ns), Error);
+
+    BusManager manager(1ms);
+    BusManager::Segment segment;
+    segment.nominal    = std::make_shared<SocketNull>();
+    segment.redundancy = std::make_shared<SocketNull>();
+    ASSERT_THROW(manager.addSegment(segment), Error); // no cycle
+}
+
+TEST(BusManager, thread_configuration_error)
+{
+    BusManager manager(10ms);
+
+    int32_t cycles = 0;
+    BusManager::Segment segment;
+    segment.nominal    = std::make_shared<SocketNull>();
+    segment.redundancy = std::make_shared<SocketNull>();
+    segment.priority   = 1000; // invalid SCHED_FIFO priority
+    segment.cycle = [&cycles](Bus&, int64_t) { ++cycles; };
+    manager.addSegment(segment);
+
+    // the thread reports the error before running any cycle
+    ASSERT_THROW(manager.start(), std::system_error);
+    ASSERT_EQ(0, cycles);
+    ASSERT_EQ(0, manager.cycles(0));
+}
+
+TEST(BusManager, consistent_snapshots)
+{
+    // note: unit tests clock moves forward by 1ms at each call: the cycle shall be long enough for the threads to stay on time
+    BusManager manager(10ms);
+
+    std::vector<int64_t> images(2, -1);
+    for (int32_t i = 0; i < 2; ++i)
+    {
+        BusManager::Segment segment;
+        segment.nominal    = std::make_shared<SocketNull>();
+        segment.redundancy = std::make_shared<SocketNull>();
+        segment.cycle = [&images, i](Bus&, int64_t cycle) { images[i] = cycle; };
+        int32_t index = manager.addSegment(segment);
+        ASSERT_EQ(i, index);
+        manager.setImage(index, reinterpret_cast<uint8_t const*>(&images[i]), sizeof(int64_t));
+    }
+
+    std::vector<std::vector<uint8_t>> snapshot;
+    ASSERT_EQ(-1, manager.snapshot(snapshot));
+
+    manager.start();
+    while ((manager.cycles(0) < 10) or (manager.cycles(1) < 10))
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    // images of every segment come from the same cycle, whatever the threads are doing
+    for (int i = 0; i < 10; ++i)
+    {
+        int64_t cycle = manager.snapshot(snapshot);
+        ASSERT_GE(cycle, 0);
+        ASSERT_EQ(2, snapshot.size());
+        for (auto const& image : snapshot)
+        {
+            int64_t value;
+            std::memcpy(&value, image.data(), sizeof(int64_t));
+            ASSERT_EQ(cycle, value);
+        }
+    }
+
+    manager.stop();
+    ASSERT_EQ(0, manager.errors(0));
+    ASSERT_EQ(0, manager.errors(1));
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include "kickcat/DC.h"
+#include "kickcat/Error.h"
+
+using namespace kickcat;
+
+TEST(MasterClockSteering, invalid_cycle)
+{
+    ASSERT_THROW(MasterClockSteering(0ns, 0ns, 100us), Error);
+}
+
+TEST(MasterClockSteering, lock_on_reference_clock)
+{
+    constexpr int64_t CYCLE = 1000000; // 1ms
+    MasterClockSteering steering(1ms, 0ns, 200us);
+
+    // master time is since_epoch() (2025-01-01), the reference system time (EtherCAT epoch) is one second ahead:
+    // the reference clock runs 100ppm faster than the master one and starts in the middle of a cycle
+    nanoseconds const start = 1735689600s;
+    int64_t master = start.count();
+    int64_t const system_start = (start - DC_EPOCH_OFFSET + 1s).count();
+    double  elapsed = CYCLE / 2;
+    int64_t reference = system_start + static_cast<int64_t>(elapsed);
+    nanoseconds period{CYCLE};
+    for (int i = 0; i < 2000; ++i)
+    {
+        master += period.count();
+        elapsed += static_cast<double>(period.count()) * 1.0001;
+        reference = system_start + static_cast<int64_t>(elapsed);
+        period = nanoseconds(CYCLE) + steering.update(static_cast<uint64_t>(reference), nanoseconds(master));
+    }
+
+    // frames reach the reference slave 200us before SYNC0
+    ASSERT_LT(std::abs(steering.phaseError().count()), 1000);
+    ASSERT_EQ(CYCLE - 200000, reference % CYCLE - steering.phaseError().count());
+
+    // the master cycle follows the reference clock: offset is stable and only holds the clocks difference
+    ASSERT_LT(steering.jitter(), 1us);
+    ASSERT_EQ(master - DC_EPOCH_OFFSET.count() - reference, steering.offset().count());
+    ASSERT_LT(std::abs(steering.offset().count() + 1000000000), 1000000); // one second, plus the drift
+}
+
+TEST(MasterClockSteering, jitter)
+{
+    MasterClockSteering steering(1ms, 0ns, 200us);
+    for (int i = 0; i < 1000; ++i)
+    {
+        int64_t noise = (i % 2) ? 5000 : -5000;
+        steering.update(1000000 * i, nanoseconds(1000000 * i + noise));
+    }
+    ASSERT_NEAR(10000, steering.jitter().count(), 1000); // offset moves by +/- 10us every cycle
+}
@@ -137,3 +137,97 @@ TEST(Diagnostics, get_topology)
 
     ASSERT_THROW(getTopology(slaves), Error);
 }
+
+
+TEST(Diagnostics, compute_propagation_delays)
+{
+    std::vector<Slave> slaves(4);
+    for (uint16_t i = 0; i < 4; ++i)
+    {
+        slaves[i].address = i;
+        slaves[i].dc.supported = true;
+    }
+
+    // 0 - 1 - 3
+    //     |
+    //     2   (port 3 is processed before port 1)
+    slaves[0].dl_status.PL_port0 = 1;
+    slaves[0].dl_status.PL_port1 = 1;
+    slaves[0].dc.receive_time[0] = 5000;
+    slaves[0].dc.receive_time[1] = 5600;
+
+    slaves[1].dl_status.PL_port0 = 1;
+    slaves[1].dl_status.PL_port1 = 1;
+    slaves[1].dl_status.PL_port3 = 1;
+    slaves[1].dc.receive_time[0] = 1000;
+    slaves[1].dc.receive_time[3] = 1100;
+    slaves[1].dc.receive_time[1] = 1300;
+
+    slaves[2].dl_status.PL_port0 = 1;
+    slaves[2].dc.receive_time[0] = 0xFFFFFFF0; // receive times are local and may wrap around
+
+    slaves[3].dl_status.PL_port0 = 1;
+    slaves[3].dc.receive_time[0] = 42;
+
+    computePropagationDelays(slaves);
+    ASSERT_EQ(0,   slaves[0].dc.delay);
+    ASSERT_EQ(150, slaves[1].dc.delay);     // (600 - 300) / 2
+    ASSERT_EQ(200, slaves[2].dc.delay);     // 150 + (1100 - 1000) / 2
+    ASSERT_EQ(250, slaves[3].dc.delay);     // 150 + (1300 - 1100) / 2
+}
+
+
+TEST(Diagnostics, compute_propagation_delays_non_dc_slave)
+{
+    std::vector<Slave> slaves(4);
+    for (uint16_t i = 0; i < 4; ++i)
+    {
+        slaves[i].address = i;
+        slaves[i].dc.supported = true;
+        slaves[i].dl_status.PL_port0 = 1;
+        slaves[i].dl_status.PL_port1 = 1;
+    }
+    slaves[3].dl_status.PL_port1 = 0;
+
+    // 0 - 1 - 2 - 3 with a non DC slave in the middle: its receive times are never read
+    slaves[1].dc.supported = false;
+    slaves[1].dc.receive_time[0] = 0xDEAD;
+    slaves[1].dc.receive_time[1] = 0xBEEF;
+
+    slaves[0].dc.receive_time[0] = 1000;
+    slaves[0].dc.receive_time[1] = 1600;
+    slaves[2].dc.receive_time[0] = 50;
+    slaves[2].dc.receive_time[1] = 250;
+    slaves[3].dc.receive_time[0] = 7;
+
+    computePropagationDelays(slaves);
+    ASSERT_EQ(0,   slaves[0].dc.delay);
+    ASSERT_EQ(0,   slaves[1].dc.delay);     // propagated from its parent
+    ASSERT_EQ(200, slaves[2].dc.delay);     // measured from slave 0: (600 - 200) / 2
+    ASSERT_EQ(300, slaves[3].dc.delay);     // 200 + (200 - 0) / 2
+}
+
+
+TEST(Diagnostics, estimate_cycle_time)
+{
+    std::vector<Slave> slaves(3);
+    slaves[0].dl_status.PL_port0 = 1;
+    slaves[0].dl_status.PL_port1 = 1;
+    slaves[1].dl_status.PL_port0 = 1;
+    slaves[1].dl_status.PL_port1 = 1;
+    slaves[2].dl_status.PL_port0 = 1;
+
+    CycleTimeEstimate estimate = estimateCycleTime({1}, slaves, 100us);
+    ASSERT_EQ(1, estimate.wire.frames);
+    ASSERT_EQ(84 * 80ns, estimate.wire.time);
+    ASSERT_EQ(5 * 500ns + 6 * 50ns, estimate.propagation);     // 5 ports crossed, 3 links crossed twice
+    ASSERT_EQ(6720ns + 2800ns + 50us, estimate.minimum_cycle);
+    ASSERT_EQ(100us - estimate.minimum_cycle, estimate.headroom);
+
+    // not feasible
+    CycleTimeModel model;
+    model.master_overhead = 0ns;
+    estimate = estimateCycleTime({1400, 1400, 1400}, slaves, 10us, model);
+    ASSERT_EQ(3, estimate.wire.frames);
+    ASSERT_LT(estimate.headroom, 0ns);
+}
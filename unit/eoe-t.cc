@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <queue>
+#include <cstring>
+
+#include "kickcat/EoE.h"
+
+using namespace kickcat;
+
+// Local network interface: frames to read are pushed by the test, written frames are stored
+class FakeInterface : public AbstractSocket
+{
+public:
+    void open(std::string const&) override {}
+    void setTimeout(nanoseconds) override {}
+    void close() noexcept override {}
+
+    int32_t read(uint8_t* frame, int32_t frame_size) override
+    {
+        if (to_read.empty())
+        {
+            return -1;
+        }
+        auto const& next = to_read.front();
+        int32_t size = std::min(frame_size, static_cast<int32_t>(next.size()));
+        std::memcpy(frame, next.data(), size);
+        to_read.pop();
+        return size;
+    }
+
+    int32_t write(uint8_t const* frame, int32_t frame_size) override
+    {
+        written.emplace_back(frame, frame + frame_size);
+        return frame_size;
+    }
+
+    std::queue<std::vector<uint8_t>> to_read;
+    std::vector<std::vector<uint8_t>> written;
+};
+
+class EoETest : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        master.recv_size = 256;
+        master.send_size = 256;
+        slave.recv_size  = 256;
+        slave.send_size  = 256;
+
+        // simulated slave: echo every received frame
+        slave.eoe_handler = [this](uint8_t const* frame, int32_t frame_size)
+        {
+            slave_frames++;
+            slave.createEoE(frame, frame_size);
+        };
+    }
+
+    // exchange every waiting message between the master and the simulated slave, as the bus would do
+    void exchange()
+    {
+        while (master.hasMessageToSend())
+        {
+            auto message = master.send();
+            slave.receive(message->data());
+        }
+        while (slave.hasMessageToSend())
+        {
+            auto message = slave.send();
+            master.receive(message->data());
+        }
+    }
+
+    std::vector<uint8_t> createFrame(int32_t size, uint8_t seed)
+    {
+        std::vector<uint8_t> frame(size);
+        for (int32_t i = 0; i < size; ++i)
+        {
+            frame[i] = static_cast<uint8_t>(i + seed);
+        }
+        return frame;
+    }
+
+protected:
+    Mailbox master;
+    Mailbox slave;
+    int32_t slave_frames{0};
+    std::shared_ptr<FakeInterface> interface{std::make_shared<FakeInterface>()};
+};
+
+
+TEST_F(EoETest, fragments)
+{
+    // 256 - 6 (mailbox header) - 4 (EoE header) = 246 -> 224 bytes (multiple of 32) per fragment
+    ASSERT_EQ(224, EoEMessage::maxFragmentSize(256));
+
+    auto frame = createFrame(500, 0);
+    auto last = master.createEoE(frame.data(), static_cast<int32_t>(frame.size()));
+    ASSERT_EQ(3, master.to_send_eoe.size());
+
+    for (int32_t i = 0; i < 3; ++i)
+    {
+        auto message = master.send();
+        mailbox::Header const* header = reinterpret_cast<mailbox::Header const*>(message->data());
+        EoE::Header const* eoe = reinterpret_cast<EoE::Header const*>(message->data() + sizeof(mailbox::Header));
+        ASSERT_EQ(mailbox::Type::EoE,           header->type);
+        ASSERT_EQ(EoE::FrameType::FRAGMENT,     eoe->type);
+        ASSERT_EQ(i,                            eoe->fragment_number);
+        ASSERT_EQ(i == 2,                       eoe->last_fragment);
+        if (i == 0)
+        {
+            ASSERT_EQ(16, eoe->offset); // complete size: 500 bytes in 32 bytes blocks
+        }
+        else
+        {
+            ASSERT_EQ(i * 224 / 32, eoe->offset);
+        }
+        ASSERT_EQ(MessageStatus::SUCCESS, message->status());  // no answer expected
+    }
+    ASSERT_EQ(MessageStatus::SUCCESS, last->status());
+    ASSERT_TRUE(master.to_process.empty(mailbox::Type::EoE));
+}
+
+
+TEST_F(EoETest, other_messages_first)
+{
+    auto frame = createFrame(500, 0);
+    master.createEoE(frame.data(), static_cast<int32_t>(frame.size()));
+
+    // the fragment chosen for the next write is kept even if a message is queued in between
+    auto next = master.nextToSend();
+    uint32_t data = 0;
+    uint32_t data_size = sizeof(data);
+    auto sdo = master.createSDO(0x1018, 1, false, CoE::SDO::request::UPLOAD, &data, &data_size);
+    ASSERT_EQ(next, master.send());
+
+    // the SDO does not wait for the rest of the frame
+    ASSERT_EQ(sdo, master.send());
+    ASSERT_EQ(2, master.to_send_eoe.size());
+    while (master.hasMessageToSend())
+    {
+        auto message = master.send();
+        mailbox::Header const* header = reinterpret_cast<mailbox::Header const*>(message->data());
+        ASSERT_EQ(mailbox::Type::EoE, header->type);
+    }
+}
+
+
+TEST_F(EoETest, end_to_end)
+{
+    EoEBridge bridge(interface, master);
+
+    auto frame = createFrame(1000, 7);
+    interface->to_read.push(frame);
+
+    bridge.process();
+    ASSERT_EQ(1, bridge.framesSent());
+    exchange();
+
+    ASSERT_EQ(1, slave_frames);
+    ASSERT_EQ(1, bridge.framesReceived());
+    ASSERT_EQ(1, interface->written.size());
+    ASSERT_EQ(frame, interface->written.at(0));
+}
+
+
+TEST_F(EoETest, bandwidth_budget)
+{
+    EoEBridge bridge(interface, master);
+    bridge.setBandwidthBudget(600);
+
+    interface->to_read.push(createFrame(1000, 1));
+    interface->to_read.push(createFrame(1000, 2));
+
+    bridge.process(); // 600 bytes available
+    ASSERT_EQ(0, bridge.framesSent());
+    ASSERT_FALSE(master.hasMessageToSend());
+
+    bridge.process(); // 1200 bytes available
+    ASSERT_EQ(1, bridge.framesSent());
+
+    bridge.process(); // 800 bytes available
+    ASSERT_EQ(1, bridge.framesSent());
+
+    bridge.process(); // 1400 bytes available
+    ASSERT_EQ(2, bridge.framesSent());
+
+    exchange();
+    ASSERT_EQ(2, interface->written.size());
+    ASSERT_EQ(createFrame(1000, 1), interface->written.at(0));
+    ASSERT_EQ(createFrame(1000, 2), interface->written.at(1));
+}
+
+
+TEST_F(EoETest, fragment_out_of_sequence)
+{
+    auto frame = createFrame(500, 0);
+    slave.eoe_handler = [this](uint8_t const*, int32_t) { slave_frames++; };
+
+    master.createEoE(frame.data(), static_cast<int32_t>(frame.size()));
+    master.send(); // first fragment is lost
+    while (master.hasMessageToSend())
+    {
+        ASSERT_TRUE(slave.receive(master.send()->data()));
+    }
+    ASSERT_EQ(0, slave_frames);
+
+    // next frame is received
+    master.createEoE(frame.data(), static_cast<int32_t>(frame.size()));
+    exchange();
+    ASSERT_EQ(1, slave_frames);
+}
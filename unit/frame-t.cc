@@ -304,3 +304,26 @@ TEST(Frame, write_error)
     ASSERT_EQ(-1, writeFrame(io_nominal, frame, PRIMARY_IF_MAC));
 }
 
+
+TEST(Frame, wire_usage)
+{
+    // empty
+    WireUsage usage = computeWireUsage({});
+    ASSERT_EQ(0, usage.frames);
+    ASSERT_EQ(0ns, usage.time);
+
+    // small frame is padded: 8 preamble + 60 + 4 FCS + 12 IFG
+    usage = computeWireUsage({1});
+    ASSERT_EQ(1, usage.frames);
+    ASSERT_EQ(84, usage.bytes);
+    ASSERT_EQ(84 * 80ns, usage.time);
+
+    // two big datagrams cannot share a frame: 8 + 14 + 2 + (10 + 1400 + 2) + 4 + 12 per frame
+    usage = computeWireUsage({1400, 1400});
+    ASSERT_EQ(2, usage.frames);
+    ASSERT_EQ(2 * 1452, usage.bytes);
+
+    // datagrams count is limited per frame
+    usage = computeWireUsage(std::vector<uint16_t>(MAX_ETHERCAT_DATAGRAMS + 1, 1));
+    ASSERT_EQ(2, usage.frames);
+}
@@ -37,7 +37,7 @@ public:
 
     void checkSendFrameError()
     {
-        ASSERT_EQ(link.sent_frame_, 0);
+        ASSERT_EQ(link.current().sent_frame, 0);
         ASSERT_EQ(link.callbacks_[0].status, DatagramState::SEND_ERROR);
     }
 
@@ -75,6 +75,30 @@ public:
         });
     }
 
+    // Reply with a frame holding a single datagram of a transaction (its generation), whatever was sent
+    template<typename T>
+    void reply(std::shared_ptr<MockSocket> socket, uint8_t index, Command cmd, T const& payload, uint16_t wkc,
+               uint16_t generation = 1)
+    {
+        EXPECT_CALL(*socket, read(_,_))
+        .WillOnce(Invoke([=](uint8_t* data, int32_t)
+        {
+            Frame frame;
+            frame.addDatagram(index, cmd, 0, &payload, sizeof(T), generation);
+            int32_t to_write = frame.finalize();
+            std::memcpy(data, frame.data(), to_write);
+            uint8_t* payload_pos = data + sizeof(EthernetHeader) + sizeof(EthercatHeader) + sizeof(DatagramHeader);
+            std::memcpy(payload_pos, &payload, sizeof(T));  // read commands are sent without payload
+            std::memcpy(payload_pos + sizeof(T), &wkc, sizeof(uint16_t));
+            return to_write;
+        })).RetiresOnSaturation();
+    }
+
+    Link::Statistics const& statistics() const
+    {
+        return link.statistics();
+    }
+
 protected:
     std::shared_ptr<MockSocket> io_nominal{ std::make_shared<MockSocket>() };
     std::shared_ptr<MockSocket> io_redundancy{ std::make_shared<MockSocket>() };
@@ -887,16 +911,8 @@ TEST_F(LinkTest, process_datagrams_error_rethrow)
         [&](DatagramState const&){ throw std::underflow_error("E"); }
     );
 
-    EXPECT_CALL(*io_nominal, read(_,_))
-    .WillOnce(Invoke([&](uint8_t*, int32_t)
-    {
-        return ETH_MIN_SIZE;
-    }));
-    EXPECT_CALL(*io_redundancy, read(_,_))
-    .WillOnce(Invoke([&](uint8_t*, int32_t)
-    {
-        return ETH_MIN_SIZE;
-    }));
+    io_redundancy->handleReply<uint8_t>({payload, payload, payload, payload, payload}, 0);
+    io_nominal->handleReply<uint8_t>({payload, payload, payload, payload, payload}, 0);
 
     EXPECT_THROW(link.processDatagrams(), std::overflow_error);
 }
@@ -1009,7 +1025,7 @@ TEST_F(LinkTest, process_datagrams_old_frame)
         .WillOnce(Invoke([payload](uint8_t* data, int32_t)
         {
             Frame frame;
-            frame.addDatagram(2, Command::BRD,  0, &payload, 1);
+            frame.addDatagram(2, Command::BRD,  0, &payload, 1, 3);
             int32_t toWrite = frame.finalize();
             std::memcpy(data, frame.data(), toWrite);
             return toWrite;
@@ -1019,6 +1035,492 @@ TEST_F(LinkTest, process_datagrams_old_frame)
 
     ASSERT_EQ(1, process_callback_counter); // datagram lost (invalid frame)
     ASSERT_EQ(2, error_callback_counter);
+    ASSERT_EQ(2, statistics().frames_late);
+}
+
+
+TEST_F(LinkTest, single_interface_late_frame)
+{
+    InSequence s;
+
+    Link single{io_nominal};
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    uint16_t status = 0x0008;
+    auto process = [&](DatagramHeader const*, uint8_t const*, uint16_t)
+    {
+        process_callback_counter++;
+        return DatagramState::OK;
+    };
+    auto error = [&](DatagramState const&) { error_callback_counter++; };
+
+    // first transaction: the answer is late
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    io_nominal->readError();
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    single.processDatagrams();
+    ASSERT_EQ(0, process_callback_counter);
+    ASSERT_EQ(1, error_callback_counter);
+
+    // second transaction: the late answer shows up first, then a frame reusing the current index with another
+    // command (index wrap), and finally the expected answer.
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint16_t>>(1, {Command::FPRD, 0, false}));
+    reply(io_nominal, 0, Command::LRD, logical_read, 1);
+    reply(io_nominal, 1, Command::LRD, logical_read, 1, 2);
+    reply(io_nominal, 1, Command::FPRD, status, 1, 2);
+    single.addDatagram(Command::FPRD, 0, uint16_t{0}, process, error);
+    single.processDatagrams();
+
+    ASSERT_EQ(1, process_callback_counter);
+    ASSERT_EQ(1, error_callback_counter);
+    ASSERT_EQ(3, single.statistics().frames_nominal);
+    ASSERT_EQ(2, single.statistics().frames_late);
+}
+
+
+TEST_F(LinkTest, domains)
+{
+    Link single{io_nominal};
+    ASSERT_THROW(single.configureDomains({4, 1, 2, 2}), Error);
+    ASSERT_THROW(single.configureDomains({200, 50, 4, 4}), Error);
+    single.configureDomains({4, 4, 2, 246});
+
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    uint16_t status = 0x0008;
+    int32_t cyclic_processed{0};
+    int32_t mailbox_processed{0};
+    auto error = [&](DatagramState const&) { error_callback_counter++; };
+
+    InSequence s;
+
+    // both domains in flight: the mailbox answer read while processing the cyclic domain is kept for it
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint16_t>>(1, {Command::FPRD, 0, false}));
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    reply(io_nominal, 4, Command::FPRD, status, 1);
+    reply(io_nominal, 0, Command::LRD, logical_read, 1);
+
+    {
+        Link::DomainScope scope{single, Link::Domain::MAILBOX};
+        single.addDatagram(Command::FPRD, 0, uint16_t{0},
+            [&](DatagramHeader const*, uint8_t const*, uint16_t) { mailbox_processed++; return DatagramState::OK; }, error);
+        single.finalizeDatagrams();
+    }
+    ASSERT_EQ(Link::Domain::USER, single.domain());
+
+    single.setDomain(Link::Domain::CYCLIC);
+    single.addDatagram(Command::LRD, 0, skip,
+        [&](DatagramHeader const*, uint8_t const*, uint16_t) { cyclic_processed++; return DatagramState::OK; }, error);
+    single.processDatagrams();
+    ASSERT_EQ(1, cyclic_processed);
+    ASSERT_EQ(0, mailbox_processed);
+
+    // nothing left to read for the mailbox domain
+    single.setDomain(Link::Domain::MAILBOX);
+    single.processDatagrams();
+    ASSERT_EQ(1, mailbox_processed);
+    ASSERT_EQ(0, error_callback_counter);
+    ASSERT_EQ(2, single.statistics().frames_nominal);
+
+    // a lost mailbox answer does not fail the cyclic domain
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<uint16_t>>(1, {Command::FPRD, 0, false}));
+    reply(io_nominal, 1, Command::LRD, logical_read, 1, 2);
+    io_nominal->readError();
+
+    single.addDatagram(Command::FPRD, 0, uint16_t{0},
+        [&](DatagramHeader const*, uint8_t const*, uint16_t) { mailbox_processed++; return DatagramState::OK; }, error);
+    single.setDomain(Link::Domain::CYCLIC);
+    single.addDatagram(Command::LRD, 0, skip,
+        [&](DatagramHeader const*, uint8_t const*, uint16_t) { cyclic_processed++; return DatagramState::OK; }, error);
+    single.finalizeAllDatagrams();
+    single.processAllDatagrams();
+    ASSERT_EQ(2, cyclic_processed);
+    ASSERT_EQ(1, mailbox_processed);
+    ASSERT_EQ(1, error_callback_counter);
+    ASSERT_EQ(1, single.statistics().datagrams_lost);
+
+    single.addDatagram(Command::LRD, 0, skip,
+        [&](DatagramHeader const*, uint8_t const*, uint16_t) { return DatagramState::OK; }, error);
+    ASSERT_THROW(single.configureDomains({4, 4, 2, 2}), Error);
+}
+
+
+TEST_F(LinkTest, late_frame_index_reuse)
+{
+    InSequence s;
+
+    // two indexes per domain: the index of a lost datagram comes back two transactions later
+    Link single{io_nominal};
+    single.configureDomains({2, 2, 2, 250});
+    single.setDomain(Link::Domain::CYCLIC);
+
+    int64_t skip{0};
+    int64_t late = 0x0706050403020100;
+    int64_t logical_read = 0x0001020304050607;
+    std::vector<int64_t> processed;
+    auto process = [&](DatagramHeader const*, uint8_t const* data, uint16_t)
+    {
+        int64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        processed.push_back(value);
+        return DatagramState::OK;
+    };
+    auto error = [&](DatagramState const&) { error_callback_counter++; };
+
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    io_nominal->readError();
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    single.processDatagrams();
+
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    reply(io_nominal, 1, Command::LRD, logical_read, 1, 2);
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    single.processDatagrams();
+
+    // same index, command and size: only the transaction carried in the frame tells the late answer apart
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    reply(io_nominal, 0, Command::LRD, late, 1, 1);
+    reply(io_nominal, 0, Command::LRD, logical_read, 1, 3);
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    single.processDatagrams();
+
+    ASSERT_EQ((std::vector<int64_t>{logical_read, logical_read}), processed);
+    ASSERT_EQ(1, error_callback_counter);
+    ASSERT_EQ(1, single.statistics().frames_late);
+}
+
+
+TEST_F(LinkTest, event_requests_in_irq)
+{
+    InSequence s;
+
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    int64_t processed{0};
+    auto process = [&](DatagramHeader const*, uint8_t const* data, uint16_t)
+    {
+        std::memcpy(&processed, data, sizeof(processed));
+        return DatagramState::OK;
+    };
+    auto error = [&](DatagramState const&) { error_callback_counter++; };
+
+    // a slave with unmasked ECAT events ORs them into the transaction tag (here AL status and SM0 events)
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    reply(io_nominal, 0, Command::LRD, logical_read, 1, 0x0018 | 1);
+    link.addDatagram(Command::LRD, 0, skip, process, error);
+    link.processDatagrams();
+
+    ASSERT_EQ(logical_read, processed);
+    ASSERT_EQ(0, error_callback_counter);
+    ASSERT_EQ(0, statistics().frames_late);
+}
+
+
+TEST_F(LinkTest, late_frame_no_extra_read)
+{
+    InSequence s;
+
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    Command cmd = Command::LRD;
+
+    checkSendFrameRedundancy(std::vector<DatagramCheck<int64_t>>(1, {cmd, skip, false}));
+    addDatagram(cmd, skip, logical_read, 2);
+
+    // the late frame asks for another read on the nominal side only: the redundancy side is complete
+    reply(io_redundancy, 0, cmd, logical_read, 1);
+    reply(io_nominal,    0, cmd, logical_read, 1, 0);
+    reply(io_nominal,    0, cmd, logical_read, 1);
+    link.processDatagrams();
+
+    ASSERT_EQ(1, process_callback_counter);
+    ASSERT_EQ(0, error_callback_counter);
+    ASSERT_EQ(1, statistics().frames_late);
+}
+
+
+TEST(RttEstimator, update)
+{
+    RttEstimator rtt;
+    ASSERT_EQ(0, rtt.samples());
+
+    rtt.update(100us);
+    ASSERT_EQ(100us, rtt.srtt());
+    ASSERT_EQ(50us,  rtt.rttvar());
+    ASSERT_EQ(300us, rtt.timeout());
+
+    // a steady round trip time shrinks the timeout toward it
+    for (int32_t i = 0; i < 100; ++i)
+    {
+        rtt.update(100us);
+    }
+    ASSERT_EQ(100us, rtt.srtt());
+    ASSERT_GT(102us, rtt.timeout());
+
+    // a jittery one widens it
+    for (int32_t i = 0; i < 100; ++i)
+    {
+        rtt.update(i % 2 ? 50us : 150us);
+    }
+    ASSERT_LT(250us, rtt.timeout());
+    ASSERT_EQ(201, rtt.samples());
+}
+
+
+TEST_F(LinkTest, adaptive_timeout)
+{
+    using ::testing::AllOf;
+    using ::testing::Gt;
+    using ::testing::Lt;
+
+    Link single{io_nominal};
+    single.setTimeout(2ms);
+    single.enableAdaptiveTimeout(100us, 100ms);
+
+    int64_t skip{0};
+    auto process = [&](DatagramHeader const*, uint8_t const*, uint16_t) { return DatagramState::OK; };
+    auto error = [&](DatagramState const&) { error_callback_counter++; };
+
+    // no measure yet: the configured timeout is used, counted from the send time
+    {
+        InSequence s;
+        io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+        EXPECT_CALL(*io_nominal, setTimeout(AllOf(Gt(0ns), Lt(nanoseconds{2ms}))));
+        io_nominal->handleReply<int64_t>({skip}, 1);
+    }
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    single.processDatagrams();
+
+    ASSERT_EQ(1, single.rtt(Link::TrafficClass::CYCLIC).samples());
+    ASSERT_EQ(0, single.rtt(Link::TrafficClass::MAILBOX).samples());
+    nanoseconds cyclic_timeout = single.timeout(Link::TrafficClass::CYCLIC);
+    ASSERT_EQ(std::clamp(single.rtt(Link::TrafficClass::CYCLIC).timeout(), nanoseconds{100us}, nanoseconds{100ms}), cyclic_timeout);
+    ASSERT_EQ(2ms, single.timeout(Link::TrafficClass::MAILBOX));
+
+    // the next cyclic transaction follows the measure
+    {
+        InSequence s;
+        io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+        EXPECT_CALL(*io_nominal, setTimeout(AllOf(Gt(0ns), Lt(cyclic_timeout))));
+        io_nominal->handleReply<int64_t>({skip}, 1);
+    }
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    single.processDatagrams();
+    ASSERT_EQ(2, single.rtt(Link::TrafficClass::CYCLIC).samples());
+    ASSERT_EQ(0, error_callback_counter);
+    cyclic_timeout = single.timeout(Link::TrafficClass::CYCLIC);
+
+    // lost frames: the timeout backs off (up to the maximum) until a frame is measured again
+    for (nanoseconds expected : {2 * cyclic_timeout, 4 * cyclic_timeout})
+    {
+        io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+        io_nominal->readError();
+        single.addDatagram(Command::LRD, 0, skip, process, error);
+        single.processDatagrams();
+        ASSERT_EQ(std::min(expected, nanoseconds{100ms}), single.timeout(Link::TrafficClass::CYCLIC));
+    }
+    ASSERT_EQ(2, error_callback_counter);
+
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    reply(io_nominal, 4, Command::LRD, skip, 1, 5);
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    single.processDatagrams();
+    ASSERT_EQ(3, single.rtt(Link::TrafficClass::CYCLIC).samples());
+    ASSERT_EQ(std::clamp(single.rtt(Link::TrafficClass::CYCLIC).timeout(), nanoseconds{100us}, nanoseconds{100ms}),
+              single.timeout(Link::TrafficClass::CYCLIC));
+
+    single.disableAdaptiveTimeout();
+    ASSERT_EQ(2ms, single.timeout(Link::TrafficClass::CYCLIC));
+    ASSERT_THROW(single.enableAdaptiveTimeout(1ms, 100us), Error);
+}
+
+
+TEST_F(LinkTest, poll)
+{
+    InSequence s;
+
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    Command cmd = Command::LRD;
+    std::vector<DatagramCheck<int64_t>> expecteds_1(1, {cmd, skip, false});
+    addDatagram(cmd, skip, logical_read, 2);
+    checkSendFrameRedundancy(expecteds_1);
+
+    // nothing came back yet
+    io_redundancy->readError();
+    io_nominal->readError();
+    ASSERT_FALSE(link.poll());
+    ASSERT_EQ(0, process_callback_counter);
+    ASSERT_THROW(addDatagram(cmd, skip, logical_read, 2), Error);
+
+    // both copies are there
+    io_redundancy->handleReply<int64_t>({logical_read}, 2);
+    io_nominal->handleReply<int64_t>({skip}, 0);
+    ASSERT_TRUE(link.poll());
+    ASSERT_EQ(1, process_callback_counter);
+    ASSERT_EQ(0, error_callback_counter);
+
+    std::vector<int> fds = link.fds();
+    ASSERT_EQ(2, fds.size());
+    ASSERT_EQ(-1, fds[0]); // mocks have no file descriptor
+}
+
+
+TEST_F(LinkTest, complete_by)
+{
+    Link single{io_nominal};
+    ASSERT_EQ(1, single.fds().size());
+
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    auto process = [&](DatagramHeader const*, uint8_t const*, uint16_t)
+    {
+        process_callback_counter++;
+        return DatagramState::OK;
+    };
+    auto error = [&](DatagramState const& state)
+    {
+        error_callback_counter++;
+        last_error = state;
+    };
+
+    // answer before the deadline
+    {
+        InSequence s;
+        io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+        io_nominal->handleReply<int64_t>({logical_read}, 1);
+    }
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    ASSERT_TRUE(single.completeBy(since_epoch() + 10ms));
+    ASSERT_EQ(1, process_callback_counter);
+    ASSERT_EQ(0, error_callback_counter);
+
+    // no answer: the datagram is lost at the deadline
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    EXPECT_CALL(*io_nominal, read(_,_))
+        .WillRepeatedly(Invoke([](uint8_t*, int32_t)
+        {
+            errno = ETIMEDOUT;
+            return -1;
+        }));
+    single.addDatagram(Command::LRD, 0, skip, process, error);
+    ASSERT_FALSE(single.completeBy(since_epoch() + 10ms));
+    ASSERT_EQ(1, process_callback_counter);
+    ASSERT_EQ(1, error_callback_counter);
+    ASSERT_EQ(DatagramState::LOST, last_error);
+}
+
+
+TEST_F(LinkTest, process_datagrams_out_of_order)
+{
+    InSequence s;
+
+    int64_t skip{0};
+    int64_t part_nominal    = 0x0001020300000000;
+    int64_t part_redundancy = 0x0000000004050607;
+    int64_t full            = 0x0001020304050607;
+    Command cmd = Command::LRD;
+    std::vector<DatagramCheck<int64_t>> expecteds_1(1, {cmd, skip, false});
+
+    // ring broken between slaves: each datagram comes back on both sides, and the copies are not read together
+    checkSendFrameRedundancy(expecteds_1);
+    checkSendFrameRedundancy(expecteds_1);
+    addDatagram(cmd, skip, full, 2);
+    sendFrame();
+    addDatagram(cmd, skip, full, 2);
+    sendFrame();
+
+    reply(io_redundancy, 1, cmd, part_redundancy, 1);
+    reply(io_nominal,    0, cmd, part_nominal,    1);
+    reply(io_redundancy, 0, cmd, part_redundancy, 1);
+    reply(io_nominal,    1, cmd, part_nominal,    1);
+
+    link.processDatagrams();
+
+    ASSERT_EQ(2, process_callback_counter);
+    ASSERT_EQ(0, error_callback_counter);
+    ASSERT_EQ(2, statistics().frames_nominal);
+    ASSERT_EQ(2, statistics().frames_redundancy);
+    ASSERT_EQ(2, statistics().datagrams_merged);
+    ASSERT_EQ(0, statistics().datagrams_mismatch);
+}
+
+
+TEST_F(LinkTest, process_datagrams_early_dispatch)
+{
+    InSequence s;
+
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    Command cmd = Command::LRD;
+    std::vector<DatagramCheck<int64_t>> expecteds_1(1, {cmd, skip, false});
+
+    // frames read when each datagram is processed: as soon as both copies of its frame are in
+    std::vector<int64_t> frames_read;
+    auto process = [&](DatagramHeader const*, uint8_t const*, uint16_t)
+    {
+        frames_read.push_back(statistics().frames_nominal + statistics().frames_redundancy);
+        return DatagramState::OK;
+    };
+    auto error = [&](DatagramState const&) { error_callback_counter++; };
+
+    checkSendFrameRedundancy(expecteds_1);
+    checkSendFrameRedundancy(expecteds_1);
+    link.addDatagram(cmd, 0, skip, process, error);
+    sendFrame();
+    link.addDatagram(cmd, 0, skip, process, error);
+    sendFrame();
+
+    reply(io_redundancy, 0, cmd, logical_read, 1);
+    reply(io_nominal,    0, cmd, logical_read, 1);
+    reply(io_redundancy, 1, cmd, logical_read, 1);
+    reply(io_nominal,    1, cmd, logical_read, 1);
+
+    link.processDatagrams();
+
+    ASSERT_EQ((std::vector<int64_t>{2, 4}), frames_read);
+    ASSERT_EQ(0, error_callback_counter);
+    ASSERT_EQ(2, statistics().datagrams_merged);
+}
+
+
+TEST_F(LinkTest, process_datagrams_one_side_statistics)
+{
+    InSequence s;
+
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    Command cmd = Command::LRD;
+    std::vector<DatagramCheck<int64_t>> expecteds_1(1, {cmd, skip, false});
+
+    checkSendFrameRedundancy(expecteds_1);
+    checkSendFrameRedundancy(expecteds_1);
+    checkSendFrameRedundancy(expecteds_1);
+    for (int32_t i = 0; i < 3; ++i)
+    {
+        addDatagram(cmd, skip, logical_read, 2);
+        sendFrame();
+    }
+
+    reply(io_redundancy, 0, cmd, logical_read, 2);
+    io_nominal->readError();
+    io_redundancy->readError();
+    reply(io_nominal, 1, cmd, logical_read, 2);
+    io_redundancy->readError();
+    io_nominal->readError();
+
+    link.processDatagrams();
+
+    ASSERT_EQ(2, process_callback_counter);
+    ASSERT_EQ(1, error_callback_counter);
+    ASSERT_EQ(DatagramState::LOST, last_error);
+    ASSERT_EQ(1, statistics().frames_nominal);
+    ASSERT_EQ(1, statistics().frames_redundancy);
+    ASSERT_EQ(1, statistics().datagrams_redundancy_only);
+    ASSERT_EQ(1, statistics().datagrams_nominal_only);
+    ASSERT_EQ(1, statistics().datagrams_lost);
+    ASSERT_EQ(0, statistics().datagrams_merged);
 }
 
 
@@ -1063,4 +1565,55 @@ TEST_F(LinkTest, process_datagram_check_timeout_min)
     io_nominal->handleReply<int64_t>({skip}, 0);
     link.processDatagrams();
 }
+
+
+TEST_F(LinkTest, single_interface_process_datagrams)
+{
+    Link single{io_nominal};
+    ASSERT_FALSE(single.isRedundant());
+    ASSERT_TRUE(link.isRedundant());
+
+    // nothing goes through the redundancy interface
+    EXPECT_CALL(*io_redundancy, write(_,_)).Times(0);
+    EXPECT_CALL(*io_redundancy, read(_,_)).Times(0);
+
+    int64_t skip{0};
+    int64_t logical_read = 0x0001020304050607;
+    io_nominal->checkSendFrame(std::vector<DatagramCheck<int64_t>>(1, {Command::LRD, skip, false}));
+    io_nominal->handleReply<int64_t>({logical_read}, 1);
+
+    int64_t answer = 0;
+    uint16_t answer_wkc = 0;
+    single.addDatagram(Command::LRD, 0, skip,
+        [&](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+        {
+            std::memcpy(&answer, data, sizeof(answer));
+            answer_wkc = wkc;
+            return DatagramState::OK;
+        },
+        [&](DatagramState const&) { error_callback_counter++; });
+    single.processDatagrams();
+
+    ASSERT_EQ(logical_read, answer);
+    ASSERT_EQ(1, answer_wkc);
+    ASSERT_EQ(0, error_callback_counter);
+
+    // redundancy check is meaningless
+    single.checkRedundancyNeeded();
+}
+
+TEST_F(LinkTest, single_interface_writeThenRead)
+{
+    Link single{io_nominal};
+    Frame frame;
+
+    EXPECT_CALL(*io_redundancy, write(_,_)).Times(0);
+    EXPECT_CALL(*io_nominal, write(_,_)).WillOnce(Return(ETH_MIN_SIZE));
+    EXPECT_CALL(*io_nominal, read(_,_)).WillOnce(Return(ETH_MIN_SIZE));
+    single.writeThenRead(frame);
+
+    EXPECT_CALL(*io_nominal, write(_,_)).WillOnce(Return(ETH_MIN_SIZE));
+    EXPECT_CALL(*io_nominal, read(_,_)).WillOnce(Return(-1));
+    ASSERT_THROW(single.writeThenRead(frame), std::system_error);
+}
 }
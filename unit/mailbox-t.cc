@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
+#include <cstring>
 #include "kickcat/Mailbox.h"
+#include "kickcat/Error.h"
 
 using namespace kickcat;
 
@@ -68,10 +70,6 @@ TEST_F(MailboxTest, received_unknown_message)
 
 TEST_F(MailboxTest, received_emergency_message)
 {
-    // create reception callback
-    auto emg_callback = std::make_shared<EmergencyMessage>(mailbox);
-    mailbox.to_process.push_back(emg_callback);
-
     // raw data that represent an emergency message
     header->type = mailbox::Type::CoE;
     emg->service = CoE::Service::EMERGENCY;
@@ -83,12 +81,8 @@ TEST_F(MailboxTest, received_emergency_message)
     ASSERT_EQ(0x3310,  mailbox.emergencies.at(0).error_code);
 }
 
-TEST_F(MailboxTest, emergency_callback_not_related_message)
+TEST_F(MailboxTest, emergency_not_related_message)
 {
-    // create reception callback
-    auto emg_callback = std::make_shared<EmergencyMessage>(mailbox);
-    mailbox.to_process.push_back(emg_callback);
-
     header->type = mailbox::Type::CoE;
     emg->service = CoE::Service::SDO_INFORMATION;
     ASSERT_FALSE(mailbox.receive(raw_message));
@@ -164,103 +158,277 @@ TEST_F(MailboxTest, SDO_upload_standard_OK)
     sdo->index = 0x1018;
     sdo->subindex = 1;
     int32_t* reply = static_cast<int32_t*>(payload);
-    reply[0] = 8; // payload size
+    reply[0] = 16; // complete size - partial (seggmented) since more than contains in ths header
     reply[1] = 0xDEADBEEF;
     reply[2] = 0xA5A5A5A5;
     ASSERT_TRUE(mailbox.receive(raw_message));
+    message = mailbox.send();
+    ASSERT_EQ(MessageStatus::RUNNING, message->status());
+    ASSERT_EQ(CoE::SDO::request::UPLOAD_SEGMENTED, sdo_section->command);
+    ASSERT_EQ(false,                               sdo_section->complete_access); // toggle bit
+
+    // segment data follows the SDO command byte
+    header->len = 3 + 8;
+    sdo->size_indicator = 1; // last segment
+    sdo->complete_access = false;
+    sdo->command = CoE::SDO::response::UPLOAD_SEGMENTED;
+    uint32_t segment[2] = {0xCAFEDECA, 0xD0D0FACE};
+    std::memcpy(raw_message + sizeof(mailbox::Header) + 3, segment, sizeof(segment));
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::SUCCESS, message->status());
+
     ASSERT_EQ(0xDEADBEEF, data[0]);
     ASSERT_EQ(0xA5A5A5A5, data[1]);
-    ASSERT_EQ(8, data_size);
+    ASSERT_EQ(0xCAFEDECA, data[2]);
+    ASSERT_EQ(0xD0D0FACE, data[3]);
+    ASSERT_EQ(16, data_size);
 }
 
 
-TEST_F(MailboxTest, SDO_upload_segmented_OK)
+
+TEST_F(MailboxTest, SDO_download_OK)
 {
-    int32_t data[4] = {0};
+    int32_t data = 0xCAFEDECA;
     uint32_t data_size = sizeof(data);
-    mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::UPLOAD, &data, &data_size);
+    mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::DOWNLOAD, &data, &data_size);
 
     auto message = mailbox.send();
     ASSERT_EQ(MessageStatus::RUNNING, message->status());
-    ASSERT_EQ(mailbox.recv_size, message->size());
 
     // check message content
     mailbox::Header const* sdo_header = reinterpret_cast<mailbox::Header const*>(message->data());
     mailbox::ServiceData const* sdo_section = reinterpret_cast<mailbox::ServiceData const*>(message->data() + sizeof(mailbox::Header));
+    uint32_t const* sdo_payload =  reinterpret_cast<uint32_t const*>(message->data() + sizeof(mailbox::Header) + sizeof(mailbox::ServiceData));
     ASSERT_EQ(mailbox::Type::CoE, sdo_header->type);
     ASSERT_EQ(CoE::Service::SDO_REQUEST,    sdo_section->service);
-    ASSERT_EQ(CoE::SDO::request::UPLOAD,    sdo_section->command);
+    ASSERT_EQ(CoE::SDO::request::DOWNLOAD,  sdo_section->command);
     ASSERT_EQ(0x1018,                       sdo_section->index);
     ASSERT_EQ(1,                            sdo_section->subindex);
     ASSERT_EQ(false,                        sdo_section->complete_access);
+    ASSERT_EQ(0,                            sdo_section->block_size);
+    ASSERT_EQ(0xCAFEDECA,                   *sdo_payload);
 
     // reply
     header->type = mailbox::Type::CoE;
-    header->len = 10 + 8;
-    sdo->transfer_type = 0;
-    sdo->block_size = 0; // 4 bytes
-    sdo->command = CoE::SDO::request::UPLOAD;
+    sdo->command = CoE::SDO::response::DOWNLOAD;
+    sdo->service = CoE::Service::SDO_RESPONSE;
+    sdo->index = 0x1018;
+    sdo->subindex = 1;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::SUCCESS, message->status());
+}
+
+TEST_F(MailboxTest, SDO_download_segmented_OK)
+{
+    // initiate: 256 - 6 (mailbox header) - 10 (CoE + SDO + complete size) = 240 bytes
+    // segments: 256 - 6 (mailbox header) - 3 (CoE + SDO command) = 247 bytes
+    uint8_t data[240 + 247 + 3];
+    for (uint32_t i = 0; i < sizeof(data); ++i)
+    {
+        data[i] = static_cast<uint8_t>(i);
+    }
+
+    uint32_t chunks = 0;
+    auto message = mailbox.createSDODownload(0x1018, 1, false, sizeof(data), [&](uint8_t* chunk, uint32_t offset, uint32_t size)
+    {
+        std::memcpy(chunk, data + offset, size);
+        chunks++;
+    });
+
+    auto to_send = mailbox.send();
+    mailbox::Header const* sdo_header = reinterpret_cast<mailbox::Header const*>(message->data());
+    mailbox::ServiceData const* sdo_section = reinterpret_cast<mailbox::ServiceData const*>(message->data() + sizeof(mailbox::Header));
+    uint8_t const* sdo_payload = message->data() + sizeof(mailbox::Header) + sizeof(mailbox::ServiceData);
+    uint8_t const* segment = message->data() + sizeof(mailbox::Header) + 3;
+    ASSERT_EQ(CoE::SDO::request::DOWNLOAD,  sdo_section->command);
+    ASSERT_EQ(1,                            sdo_section->size_indicator);
+    ASSERT_EQ(10 + 240,                     sdo_header->len);
+    ASSERT_EQ(sizeof(data),                 *reinterpret_cast<uint32_t const*>(sdo_payload));
+    ASSERT_EQ(0, std::memcmp(sdo_payload + 4, data, 240));
+
+    // reply
+    header->type = mailbox::Type::CoE;
+    sdo->command = CoE::SDO::response::DOWNLOAD;
     sdo->service = CoE::Service::SDO_RESPONSE;
     sdo->index = 0x1018;
     sdo->subindex = 1;
-    int32_t* reply = static_cast<int32_t*>(payload);
-    reply[0] = 16; // complete size - partial (seggmented) since more than contains in ths header
-    reply[1] = 8;  // segment size
-    reply[2] = 0xDEADBEEF;
-    reply[3] = 0xA5A5A5A5;
     ASSERT_TRUE(mailbox.receive(raw_message));
-    message = mailbox.send();
     ASSERT_EQ(MessageStatus::RUNNING, message->status());
-    ASSERT_EQ(CoE::SDO::request::UPLOAD_SEGMENTED, sdo_section->command);
 
-    header->len = 10 + 8;
-    sdo->size_indicator = 0;
-    sdo->complete_access = not sdo->complete_access;
-    sdo->command = CoE::SDO::response::UPLOAD_SEGMENTED;
-    reply[0] = 8;
+    // first segment: fill the whole mailbox
+    to_send = mailbox.send();
+    ASSERT_EQ(CoE::SDO::request::DOWNLOAD_SEGMENTED, sdo_section->command);
+    ASSERT_EQ(false,                                 sdo_section->complete_access); // toggle
+    ASSERT_EQ(0,                                     sdo_section->size_indicator);  // more follows
+    ASSERT_EQ(3 + 247,                               sdo_header->len);
+    ASSERT_EQ(0, std::memcmp(segment, data + 240, 247));
+
+    sdo->command = CoE::SDO::response::DOWNLOAD_SEGMENTED;
+    sdo->complete_access = true; // wrong toggle bit
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::COE_SEGMENT_BAD_TOGGLE_BIT, message->status());
+}
+
+TEST_F(MailboxTest, SDO_download_segmented_last_small_segment)
+{
+    uint8_t data[240 + 247 + 3] = {0};
+    data[sizeof(data) - 1] = 0x42;
+    uint32_t data_size = sizeof(data);
+    auto message = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::DOWNLOAD, data, &data_size);
+
+    mailbox::Header const* sdo_header = reinterpret_cast<mailbox::Header const*>(message->data());
+    mailbox::ServiceData const* sdo_section = reinterpret_cast<mailbox::ServiceData const*>(message->data() + sizeof(mailbox::Header));
+    uint8_t const* segment = message->data() + sizeof(mailbox::Header) + 3;
+
+    header->type = mailbox::Type::CoE;
+    sdo->service = CoE::Service::SDO_RESPONSE;
+    sdo->index = 0x1018;
+    sdo->subindex = 1;
+
+    mailbox.send();
+    sdo->command = CoE::SDO::response::DOWNLOAD;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+
+    mailbox.send();
+    sdo->command = CoE::SDO::response::DOWNLOAD_SEGMENTED;
+    sdo->complete_access = false;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+
+    // last segment: 3 bytes padded to 7, 4 unused bytes encoded in bits 1-3
+    mailbox.send();
+    ASSERT_EQ(true,  sdo_section->complete_access); // toggle
+    ASSERT_EQ(1,     sdo_section->size_indicator);  // last segment
+    ASSERT_EQ(10,    sdo_header->len);
+    ASSERT_EQ(0,     sdo_section->transfer_type);
+    ASSERT_EQ(2,     sdo_section->block_size);
+    ASSERT_EQ(0x42,  segment[2]);
+    ASSERT_EQ(0,     segment[3]);
+
+    sdo->complete_access = true;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::SUCCESS, message->status());
+    ASSERT_TRUE(mailbox.to_send.empty());
+    ASSERT_TRUE(mailbox.to_process.empty(mailbox::Type::CoE));
+}
+
+TEST_F(MailboxTest, SDO_upload_streaming)
+{
+    std::vector<uint8_t> object;
+    uint32_t object_size = 0;
+    auto message = mailbox.createSDOUpload(0x1018, 1, false, [&](uint8_t const* chunk, uint32_t offset, uint32_t size, uint32_t complete_size)
+    {
+        object_size = complete_size;
+        object.resize(offset + size);
+        std::memcpy(object.data() + offset, chunk, size);
+        return true;
+    });
+    mailbox.send();
+
+    header->type = mailbox::Type::CoE;
+    header->len = 10 + 4;
+    sdo->transfer_type = 0;
+    sdo->command = CoE::SDO::response::UPLOAD;
+    sdo->service = CoE::Service::SDO_RESPONSE;
+    sdo->index = 0x1018;
+    sdo->subindex = 1;
+    uint32_t* reply = static_cast<uint32_t*>(payload);
+    reply[0] = 4 + 3;
     reply[1] = 0xCAFEDECA;
-    reply[2] = 0xD0D0FACE;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    mailbox.send();
+
+    // small last segment: 3 bytes, 4 unused
+    header->len = 10;
+    sdo->command = CoE::SDO::response::UPLOAD_SEGMENTED;
+    sdo->complete_access = false;
+    sdo->size_indicator = 1;
+    sdo->transfer_type = 0;
+    sdo->block_size = 2;
+    uint8_t* segment = raw_message + sizeof(mailbox::Header) + 3;
+    segment[0] = 1;
+    segment[1] = 2;
+    segment[2] = 3;
     ASSERT_TRUE(mailbox.receive(raw_message));
     ASSERT_EQ(MessageStatus::SUCCESS, message->status());
 
-    ASSERT_EQ(0xDEADBEEF, data[0]);
-    ASSERT_EQ(0xA5A5A5A5, data[1]);
-    ASSERT_EQ(0xCAFEDECA, data[2]);
-    ASSERT_EQ(0xD0D0FACE, data[3]);
-    ASSERT_EQ(16, data_size);
+    ASSERT_EQ(7, object_size);
+    ASSERT_EQ(7, object.size());
+    ASSERT_EQ(0xCAFEDECA, *reinterpret_cast<uint32_t*>(object.data()));
+    ASSERT_EQ(3, object[6]);
 }
 
 
-
-TEST_F(MailboxTest, SDO_download_OK)
+TEST_F(MailboxTest, SDO_callback)
 {
     int32_t data = 0xCAFEDECA;
     uint32_t data_size = sizeof(data);
-    mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::DOWNLOAD, &data, &data_size);
+    auto message = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::DOWNLOAD, &data, &data_size);
 
-    auto message = mailbox.send();
-    ASSERT_EQ(MessageStatus::RUNNING, message->status());
+    uint32_t status = MessageStatus::RUNNING;
+    message->setCallback([&](AbstractMessage const& msg) { status = msg.status(); });
 
-    // check message content
-    mailbox::Header const* sdo_header = reinterpret_cast<mailbox::Header const*>(message->data());
-    mailbox::ServiceData const* sdo_section = reinterpret_cast<mailbox::ServiceData const*>(message->data() + sizeof(mailbox::Header));
-    uint32_t const* sdo_payload =  reinterpret_cast<uint32_t const*>(message->data() + sizeof(mailbox::Header) + sizeof(mailbox::ServiceData));
-    ASSERT_EQ(mailbox::Type::CoE, sdo_header->type);
-    ASSERT_EQ(CoE::Service::SDO_REQUEST,    sdo_section->service);
-    ASSERT_EQ(CoE::SDO::request::DOWNLOAD,  sdo_section->command);
-    ASSERT_EQ(0x1018,                       sdo_section->index);
-    ASSERT_EQ(1,                            sdo_section->subindex);
-    ASSERT_EQ(false,                        sdo_section->complete_access);
-    ASSERT_EQ(0,                            sdo_section->block_size);
-    ASSERT_EQ(0xCAFEDECA,                   *sdo_payload);
+    mailbox.send();
+    ASSERT_EQ(MessageStatus::RUNNING, status);
 
     // reply
     header->type = mailbox::Type::CoE;
-    sdo->command = CoE::SDO::request::DOWNLOAD;
+    sdo->command = CoE::SDO::response::DOWNLOAD;
     sdo->service = CoE::Service::SDO_RESPONSE;
     sdo->index = 0x1018;
     sdo->subindex = 1;
     ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::SUCCESS, status);
+    ASSERT_TRUE(mailbox.to_process.empty(mailbox::Type::CoE));
+}
+
+TEST_F(MailboxTest, SDO_timeout)
+{
+    int32_t data = 0xCAFEDECA;
+    uint32_t data_size = sizeof(data);
+    auto sent = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::DOWNLOAD, &data, &data_size);
+    auto queued = mailbox.createSDO(0x1018, 2, false, CoE::SDO::request::DOWNLOAD, &data, &data_size);
+    auto blocking = mailbox.createSDO(0x1018, 3, false, CoE::SDO::request::DOWNLOAD, &data, &data_size);
+    sent->setDeadline(10ms);
+    queued->setDeadline(20ms);
+
+    int32_t callbacks = 0;
+    sent->setCallback([&](AbstractMessage const&) { ++callbacks; });
+    queued->setCallback([&](AbstractMessage const&) { ++callbacks; });
+    mailbox.send();
+
+    mailbox.checkTimeouts(10ms);
+    ASSERT_EQ(0, callbacks);
+
+    // sent message is not waiting for its answer anymore
+    mailbox.checkTimeouts(11ms);
+    ASSERT_EQ(1, callbacks);
+    ASSERT_EQ(MessageStatus::TIMEOUT, sent->status());
+    ASSERT_TRUE(mailbox.to_process.empty(mailbox::Type::CoE));
+
+    // queued message is not sent anymore, messages without deadline are kept
+    mailbox.checkTimeouts(1s);
+    ASSERT_EQ(2, callbacks);
+    ASSERT_EQ(MessageStatus::TIMEOUT, queued->status());
+    ASSERT_EQ(MessageStatus::RUNNING, blocking->status());
+    ASSERT_EQ(blocking, mailbox.send());
+    ASSERT_FALSE(mailbox.hasMessageToSend());
+}
+
+TEST_F(MailboxTest, SDO_cancel)
+{
+    int32_t data = 0xCAFEDECA;
+    uint32_t data_size = sizeof(data);
+    auto sent = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::DOWNLOAD, &data, &data_size);
+    auto queued = mailbox.createSDO(0x1018, 2, false, CoE::SDO::request::DOWNLOAD, &data, &data_size);
+    mailbox.send();
+
+    mailbox.cancel(sent);
+    ASSERT_EQ(MessageStatus::CANCELLED, sent->status());
+    ASSERT_TRUE(mailbox.to_process.empty(mailbox::Type::CoE));
+
+    mailbox.cancel(queued, MessageStatus::TIMEOUT);
+    ASSERT_EQ(MessageStatus::TIMEOUT, queued->status());
+    ASSERT_FALSE(mailbox.hasMessageToSend());
 }
 
 TEST_F(MailboxTest, SDO_download_abort)
@@ -296,3 +464,326 @@ TEST_F(MailboxTest, SDO_download_abort)
 
     ASSERT_EQ(0x06010000, message->status());
 }
+
+TEST_F(MailboxTest, dispatch_by_protocol)
+{
+    int32_t data = 0;
+    uint32_t data_size = sizeof(data);
+    auto message = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::UPLOAD, &data, &data_size);
+    mailbox.send();
+    ASSERT_EQ(1, mailbox.to_process.size(mailbox::Type::CoE));
+
+    // emergency is not dispatched to the SDO
+    header->type = mailbox::Type::CoE;
+    emg->service = CoE::Service::EMERGENCY;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(1, mailbox.emergencies.size());
+    ASSERT_EQ(MessageStatus::RUNNING, message->status());
+
+    // other protocol is not dispatched to the SDO
+    header->type = mailbox::Type::FoE;
+    ASSERT_FALSE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::RUNNING, message->status());
+    ASSERT_FALSE(mailbox.to_process.empty(mailbox::Type::CoE));
+}
+
+TEST_F(MailboxTest, dispatch_by_session)
+{
+    int32_t first = 0;
+    int32_t second = 0;
+    uint32_t first_size = sizeof(first);
+    uint32_t second_size = sizeof(second);
+    auto first_message  = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::UPLOAD, &first,  &first_size);
+    auto second_message = mailbox.createSDO(0x1018, 2, false, CoE::SDO::request::UPLOAD, &second, &second_size);
+    mailbox.send();
+    mailbox.send();
+    ASSERT_EQ(2, mailbox.to_process.size(mailbox::Type::CoE));
+
+    // answer of the second SDO goes to it, even if the first one waits since longer
+    header->len = 10;
+    header->type = mailbox::Type::CoE;
+    sdo->service = CoE::Service::SDO_RESPONSE;
+    sdo->command = CoE::SDO::response::UPLOAD;
+    sdo->transfer_type = 1;
+    sdo->block_size = 0;
+    sdo->index = 0x1018;
+    sdo->subindex = 2;
+    *static_cast<int32_t*>(payload) = 0xCAFE;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::SUCCESS, second_message->status());
+    ASSERT_EQ(0xCAFE, second);
+    ASSERT_EQ(MessageStatus::RUNNING, first_message->status());
+
+    // no SDO waits for this object
+    sdo->subindex = 3;
+    ASSERT_FALSE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::RUNNING, first_message->status());
+}
+
+TEST_F(MailboxTest, dispatch_segment_by_session)
+{
+    // a segmented upload is in progress while another SDO waits for its answer
+    uint8_t object[16];
+    uint32_t object_size = sizeof(object);
+    int32_t other = 0;
+    uint32_t other_size = sizeof(other);
+    auto segmented = mailbox.createSDO(0x2000, 0, false, CoE::SDO::request::UPLOAD, object, &object_size);
+    mailbox.send();
+
+    header->type = mailbox::Type::CoE;
+    header->len = 10 + 4;
+    sdo->service = CoE::Service::SDO_RESPONSE;
+    sdo->command = CoE::SDO::response::UPLOAD;
+    sdo->transfer_type = 0;
+    sdo->index = 0x2000;
+    sdo->subindex = 0;
+    uint32_t* reply = static_cast<uint32_t*>(payload);
+    reply[0] = 4 + 7;
+    reply[1] = 0xCAFEDECA;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    auto waiting = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::UPLOAD, &other, &other_size);
+    mailbox.send();
+    mailbox.send();
+    ASSERT_EQ(2, mailbox.to_process.size(mailbox::Type::CoE));
+
+    // segment data in place of the object address looks like the session of the waiting SDO: it is still a segment
+    header->len = 10;
+    sdo->command = CoE::SDO::response::UPLOAD_SEGMENTED;
+    sdo->complete_access = false;
+    sdo->size_indicator = 1;
+    sdo->transfer_type = 0;
+    sdo->block_size = 0;
+    uint8_t* segment = raw_message + sizeof(mailbox::Header) + 3;
+    uint8_t const data[] = {0x18, 0x10, 0x01, 4, 5, 6, 7};
+    std::memcpy(segment, data, sizeof(data));
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::SUCCESS, segmented->status());
+    ASSERT_EQ(11, object_size);
+    ASSERT_EQ(0, std::memcmp(object + 4, data, sizeof(data)));
+    ASSERT_EQ(MessageStatus::RUNNING, waiting->status());
+    ASSERT_EQ(1, mailbox.to_process.size(mailbox::Type::CoE));
+}
+
+class PendingMessage : public AbstractMessage
+{
+public:
+    PendingMessage(uint32_t session)
+        : AbstractMessage(16)
+    {
+        setSession(session);
+    }
+    ProcessingResult process(uint8_t const*) override { return ProcessingResult::NOOP; }
+};
+
+TEST(PendingMessages, sessions)
+{
+    PendingMessages pending;
+    std::vector<std::shared_ptr<AbstractMessage>> messages;
+    auto push = [&](int32_t queue, uint32_t session)
+    {
+        messages.push_back(std::make_shared<PendingMessage>(session));
+        pending.push(queue, messages.back());
+    };
+
+    // fill the table: sessions collide in their probe sequences, two messages per session on the CoE queue
+    for (uint32_t i = 0; i < PendingMessages::CAPACITY - 1; ++i)
+    {
+        push(mailbox::Type::CoE, 0x101800 + i);
+    }
+    push(mailbox::Type::CoE, 0x101800);
+    ASSERT_EQ(PendingMessages::CAPACITY, pending.size(mailbox::Type::CoE));
+    ASSERT_TRUE(pending.empty(mailbox::Type::FoE));
+    ASSERT_THROW(pending.push(mailbox::Type::FoE, std::make_shared<PendingMessage>(0)), Error);
+
+    // FIFO per session
+    ASSERT_EQ(messages[0], pending.front(mailbox::Type::CoE, 0x101800));
+    pending.pop(mailbox::Type::CoE, 0x101800);
+    ASSERT_EQ(messages.back(), pending.front(mailbox::Type::CoE, 0x101800));
+    ASSERT_EQ(nullptr, pending.front(mailbox::Type::FoE, 0x101800));
+
+    // removing sessions keeps the other ones reachable
+    std::vector<std::shared_ptr<AbstractMessage>> removed;
+    pending.removeIf([](std::shared_ptr<AbstractMessage> const& message) { return (message->session() % 2) == 1; }, removed);
+    ASSERT_EQ(PendingMessages::CAPACITY / 2 - 1, removed.size());
+    for (uint32_t i = 0; i < PendingMessages::CAPACITY - 1; ++i)
+    {
+        auto front = pending.front(mailbox::Type::CoE, 0x101800 + i);
+        if ((i % 2) == 1)
+        {
+            ASSERT_EQ(nullptr, front);
+            continue;
+        }
+        ASSERT_NE(nullptr, front);
+        pending.pop(mailbox::Type::CoE, 0x101800 + i);
+    }
+    ASSERT_TRUE(pending.empty());
+
+    // freed slots are available again
+    push(mailbox::Type::FoE, Mailbox::ANY_SESSION);
+    ASSERT_EQ(messages.back(), pending.front(mailbox::Type::FoE, Mailbox::ANY_SESSION));
+    pending.clear();
+    ASSERT_TRUE(pending.empty());
+    ASSERT_EQ(nullptr, pending.front(mailbox::Type::FoE, Mailbox::ANY_SESSION));
+}
+
+TEST_F(MailboxTest, message_storage_recycled)
+{
+    int32_t data = 0;
+    uint32_t data_size = sizeof(data);
+
+    auto message = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::UPLOAD, &data, &data_size);
+    uint8_t const* storage = message->data();
+    AbstractMessage const* object = message.get();
+    ASSERT_EQ(mailbox.recv_size, message->size());
+    mailbox.send();
+    message.reset();
+    mailbox.to_process.clear();
+
+    // next message reuses the released storage and object
+    message = mailbox.createSDO(0x1018, 2, false, CoE::SDO::request::UPLOAD, &data, &data_size);
+    ASSERT_EQ(storage, message->data());
+    ASSERT_EQ(object, message.get());
+    ASSERT_EQ(mailbox.recv_size, message->size());
+}
+
+TEST_F(MailboxTest, FoE_write_OK)
+{
+    // data packet: 256 - 6 (mailbox header) - 6 (FoE header) = 244 bytes
+    uint8_t file[244 + 56];
+    for (uint32_t i = 0; i < sizeof(file); ++i)
+    {
+        file[i] = static_cast<uint8_t>(i);
+    }
+
+    auto message = mailbox.createFoEWrite("firmware.bin", 0xCAFE, sizeof(file), [&](uint8_t* chunk, uint32_t offset, uint32_t size)
+    {
+        std::memcpy(chunk, file + offset, size);
+    });
+
+    mailbox::Header const* foe_header = reinterpret_cast<mailbox::Header const*>(message->data());
+    FoE::Header const* foe_section = reinterpret_cast<FoE::Header const*>(message->data() + sizeof(mailbox::Header));
+    uint8_t const* foe_payload = message->data() + sizeof(mailbox::Header) + sizeof(FoE::Header);
+
+    mailbox.send();
+    ASSERT_EQ(mailbox::Type::FoE,           foe_header->type);
+    ASSERT_EQ(6 + 12,                       foe_header->len);
+    ASSERT_EQ(FoE::Opcode::WRITE_REQUEST,   foe_section->opcode);
+    ASSERT_EQ(0xCAFE,                       foe_section->data);
+    ASSERT_EQ(0, std::memcmp(foe_payload, "firmware.bin", 12));
+
+    FoE::Header* foe = reinterpret_cast<FoE::Header*>(raw_message + sizeof(mailbox::Header));
+    header->type = mailbox::Type::FoE;
+    header->len = sizeof(FoE::Header);
+    foe->opcode = FoE::Opcode::ACK;
+    foe->data = 0;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+
+    mailbox.send();
+    ASSERT_EQ(FoE::Opcode::DATA,            foe_section->opcode);
+    ASSERT_EQ(1,                            foe_section->data);
+    ASSERT_EQ(6 + 244,                      foe_header->len);
+    ASSERT_EQ(0, std::memcmp(foe_payload, file, 244));
+
+    // slave is busy: packet is sent again
+    foe->opcode = FoE::Opcode::BUSY;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    mailbox.send();
+    ASSERT_EQ(FoE::Opcode::DATA,            foe_section->opcode);
+    ASSERT_EQ(1,                            foe_section->data);
+
+    foe->opcode = FoE::Opcode::ACK;
+    foe->data = 1;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+
+    mailbox.send();
+    ASSERT_EQ(2,                            foe_section->data);
+    ASSERT_EQ(6 + 56,                       foe_header->len);
+    ASSERT_EQ(0, std::memcmp(foe_payload, file + 244, 56));
+
+    foe->data = 2;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::SUCCESS, message->status());
+    ASSERT_TRUE(mailbox.to_process.empty(mailbox::Type::FoE));
+}
+
+TEST_F(MailboxTest, FoE_read_OK)
+{
+    std::vector<uint8_t> file;
+    auto message = mailbox.createFoERead("config.xml", 0, [&](uint8_t const* chunk, uint32_t offset, uint32_t size)
+    {
+        file.resize(offset + size);
+        std::memcpy(file.data() + offset, chunk, size);
+        return true;
+    });
+
+    FoE::Header const* foe_section = reinterpret_cast<FoE::Header const*>(message->data() + sizeof(mailbox::Header));
+    mailbox.send();
+    ASSERT_EQ(FoE::Opcode::READ_REQUEST, foe_section->opcode);
+
+    FoE::Header* foe = reinterpret_cast<FoE::Header*>(raw_message + sizeof(mailbox::Header));
+    uint8_t* foe_payload = raw_message + sizeof(mailbox::Header) + sizeof(FoE::Header);
+    header->type = mailbox::Type::FoE;
+    header->len = sizeof(FoE::Header) + 244;
+    foe->opcode = FoE::Opcode::DATA;
+    foe->data = 1;
+    foe_payload[0] = 0x42;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+
+    mailbox.send();
+    ASSERT_EQ(FoE::Opcode::ACK,         foe_section->opcode);
+    ASSERT_EQ(1,                        foe_section->data);
+    ASSERT_FALSE(mailbox.to_process.empty(mailbox::Type::FoE));
+
+    // wrong packet number is detected
+    foe->data = 3;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::FOE_WRONG_PACKET_NUMBER, message->status());
+    ASSERT_EQ(244, file.size());
+    ASSERT_EQ(0x42, file[0]);
+}
+
+TEST_F(MailboxTest, FoE_read_last_packet)
+{
+    std::vector<uint8_t> file;
+    auto message = mailbox.createFoERead("config.xml", 0, [&](uint8_t const* chunk, uint32_t offset, uint32_t size)
+    {
+        file.resize(offset + size);
+        std::memcpy(file.data() + offset, chunk, size);
+        return true;
+    });
+
+    bool notified = false;
+    message->setCallback([&](AbstractMessage const&) { notified = true; });
+    mailbox.send();
+
+    FoE::Header* foe = reinterpret_cast<FoE::Header*>(raw_message + sizeof(mailbox::Header));
+    header->type = mailbox::Type::FoE;
+    header->len = sizeof(FoE::Header) + 10;
+    foe->opcode = FoE::Opcode::DATA;
+    foe->data = 1;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(MessageStatus::RUNNING, message->status());
+    ASSERT_FALSE(notified);
+
+    // last ACK is sent: no answer expected
+    mailbox.send();
+    ASSERT_EQ(MessageStatus::SUCCESS, message->status());
+    ASSERT_TRUE(notified);
+    ASSERT_TRUE(mailbox.to_process.empty(mailbox::Type::FoE));
+    ASSERT_EQ(10, file.size());
+}
+
+TEST_F(MailboxTest, FoE_error)
+{
+    auto message = mailbox.createFoEWrite("firmware.bin", 0, 0, [](uint8_t*, uint32_t, uint32_t) {});
+    mailbox.send();
+
+    FoE::Header* foe = reinterpret_cast<FoE::Header*>(raw_message + sizeof(mailbox::Header));
+    header->type = mailbox::Type::FoE;
+    header->len = sizeof(FoE::Header);
+    foe->opcode = FoE::Opcode::ERROR;
+    foe->data = 0x8002;
+    ASSERT_TRUE(mailbox.receive(raw_message));
+    ASSERT_EQ(0x8002, message->status());
+    ASSERT_STREQ("Access denied", FoE::error_to_str(message->status()));
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <system_error>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "kickcat/OS/Linux/RxThreadSocket.h"
+
+using namespace kickcat;
+
+namespace
+{
+    // Thread safe socket fed by the test
+    class FeedSocket : public AbstractSocket
+    {
+    public:
+        void open(std::string const&) override { is_open = true; }
+        void setTimeout(nanoseconds) override {}
+        void close() noexcept override { is_open = false; }
+        int32_t write(uint8_t const*, int32_t frame_size) override { return frame_size; }
+
+        int32_t read(uint8_t* frame, int32_t) override
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (frames.empty())
+            {
+                lock.unlock();
+                sleep(100us);
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            std::vector<uint8_t> const& next = frames.front();
+            std::memcpy(frame, next.data(), next.size());
+            int32_t size = static_cast<int32_t>(next.size());
+            frames.pop();
+            return size;
+        }
+
+        void feed(std::vector<uint8_t> const& frame)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frames.push(frame);
+        }
+
+        bool is_open{false};
+        std::mutex mutex;
+        std::queue<std::vector<uint8_t>> frames;
+    };
+
+    // Socket with a descriptor: the receive thread shall block on it instead of polling read()
+    class PipeSocket : public AbstractSocket
+    {
+    public:
+        PipeSocket()
+        {
+            if (pipe2(fds, O_NONBLOCK) < 0)
+            {
+                THROW_SYSTEM_ERROR("pipe2()");
+            }
+        }
+
+        ~PipeSocket()
+        {
+            ::close(fds[0]);
+            ::close(fds[1]);
+        }
+
+        void open(std::string const&) override {}
+        void setTimeout(nanoseconds timeout) override { read_timeout = timeout; }
+        void close() noexcept override {}
+        int32_t write(uint8_t const*, int32_t frame_size) override { return frame_size; }
+        int fd() const override { return fds[0]; }
+
+        int32_t read(uint8_t* frame, int32_t frame_size) override
+        {
+            ++reads;
+            return static_cast<int32_t>(::read(fds[0], frame, frame_size));
+        }
+
+        void feed(std::vector<uint8_t> const& frame)
+        {
+            ASSERT_EQ(static_cast<ssize_t>(frame.size()), ::write(fds[1], frame.data(), frame.size()));
+        }
+
+        int fds[2];
+        std::atomic<nanoseconds> read_timeout{-1ns};
+        std::atomic<int32_t> reads{0};
+    };
+}
+
+TEST(RxThreadSocket, receive)
+{
+    auto inner = std::make_shared<FeedSocket>();
+    RxThreadSocket socket(inner);
+    ASSERT_GE(socket.fd(), 0);
+
+    socket.open("test");
+    ASSERT_TRUE(inner->is_open);
+
+    // nothing received
+    uint8_t frame[ETH_MAX_SIZE];
+    socket.setTimeout(2ms);
+    ASSERT_EQ(-1, socket.read(frame, ETH_MAX_SIZE));
+    ASSERT_EQ(ETIMEDOUT, errno);
+
+    // frames are read in order
+    inner->feed({1, 2, 3});
+    inner->feed({4, 5});
+    socket.setTimeout(1s);
+    ASSERT_EQ(3, socket.read(frame, ETH_MAX_SIZE));
+    ASSERT_EQ(1, frame[0]);
+    ASSERT_EQ(3, frame[2]);
+    nanoseconds first = socket.timestamp();
+    ASSERT_EQ(2, socket.read(frame, ETH_MAX_SIZE));
+    ASSERT_EQ(4, frame[0]);
+    ASSERT_LT(first, socket.timestamp());
+
+    ASSERT_EQ(3, socket.write(frame, 3));
+    ASSERT_EQ(0, socket.overflows());
+
+    socket.close();
+    ASSERT_FALSE(inner->is_open);
+}
+
+TEST(RxThreadSocket, overflow)
+{
+    auto inner = std::make_shared<FeedSocket>();
+    RxThreadSocket socket(inner, -1, 0, 2);
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        inner->feed({i});
+    }
+    socket.start();
+
+    // the receive thread drains the socket even if nobody reads
+    for (int32_t i = 0; (i < 1000) and (socket.overflows() < 2); ++i)
+    {
+        sleep(1ms);
+    }
+    ASSERT_EQ(2, socket.overflows());
+
+    uint8_t frame[ETH_MAX_SIZE];
+    socket.setTimeout(1s);
+    ASSERT_EQ(1, socket.read(frame, ETH_MAX_SIZE));
+    ASSERT_EQ(0, frame[0]);
+    ASSERT_EQ(1, socket.read(frame, ETH_MAX_SIZE));
+    ASSERT_EQ(1, frame[0]);
+    socket.stop();
+}
+
+
+TEST(RxThreadSocket, block_on_fd)
+{
+    auto inner = std::make_shared<PipeSocket>();
+    RxThreadSocket socket(inner);
+    socket.start();
+
+    // nothing received: the socket is not read at all
+    sleep(10ms);
+    ASSERT_EQ(0, inner->reads);
+
+    inner->feed({1, 2, 3});
+    uint8_t frame[ETH_MAX_SIZE];
+    socket.setTimeout(1s);
+    ASSERT_EQ(3, socket.read(frame, ETH_MAX_SIZE));
+    ASSERT_EQ(1, frame[0]);
+    ASSERT_EQ(1, inner->reads);
+    ASSERT_EQ(0ns, inner->read_timeout.load()); // the receive thread never waits in read()
+    socket.stop();
+}
+
+TEST(RxThreadSocket, configuration_error)
+{
+    // invalid SCHED_FIFO priority: the thread reports it before receiving anything
+    auto inner = std::make_shared<FeedSocket>();
+    RxThreadSocket socket(inner, -1, 1000);
+    ASSERT_THROW(socket.start(), std::system_error);
+}
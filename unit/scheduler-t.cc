@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <queue>
+
+#include "kickcat/Scheduler.h"
+#include "kickcat/SocketNull.h"
+#include "Mocks.h"
+
+using namespace kickcat;
+
+class SchedulerTest : public testing::Test
+{
+public:
+    std::shared_ptr<MockSocket> io_nominal{ std::make_shared<MockSocket>() };
+    std::shared_ptr<SocketNull> io_redundancy{ std::make_shared<SocketNull>() };
+    std::shared_ptr<Link> link = std::make_shared<Link>(io_nominal, io_redundancy, nullptr);
+    Bus bus{ link };
+
+    std::function<void(DatagramState const&)> error = [](DatagramState const&) {};
+};
+
+TEST_F(SchedulerTest, invalid_tasks)
+{
+    Scheduler scheduler(bus, 200);
+    ASSERT_THROW(scheduler.addProcessData(0, 0), Error);
+    ASSERT_THROW(scheduler.addTask(0, 10, [](Scheduler::Error const&) {}), Error);
+    ASSERT_THROW(scheduler.addTask(1, 0,  [](Scheduler::Error const&) {}), Error);
+    ASSERT_THROW(scheduler.addTask(1, 201, [](Scheduler::Error const&) {}), Error);
+    ASSERT_THROW(scheduler.addTask(2, 10, [](Scheduler::Error const&) {}, 2), Error);
+}
+
+TEST_F(SchedulerTest, most_urgent_first_within_budget)
+{
+    Scheduler scheduler(bus, 200);
+
+    std::string trace;
+    scheduler.addTask(1, 100, [&](Scheduler::Error const&) { trace += "A"; });
+    scheduler.addTask(2, 100, [&](Scheduler::Error const&) { trace += "B"; });
+    scheduler.addTask(2, 100, [&](Scheduler::Error const&) { trace += "C"; });
+
+    // cycle 0: everything is due, C does not fit
+    scheduler.cycle(error);
+    ASSERT_EQ("AB", trace);
+
+    // cycle 1: C is late by half its period, more urgent than A
+    trace.clear();
+    scheduler.cycle(error);
+    ASSERT_EQ("CA", trace);
+
+    // cycle 2: B is due
+    trace.clear();
+    scheduler.cycle(error);
+    ASSERT_EQ("AB", trace);
+    ASSERT_EQ(3, scheduler.cycles());
+}
+
+TEST_F(SchedulerTest, offset_alternates_tasks)
+{
+    Scheduler scheduler(bus, 200);
+
+    std::string trace;
+    scheduler.addTask(2, 100, [&](Scheduler::Error const&) { trace += "A"; });
+    scheduler.addTask(2, 100, [&](Scheduler::Error const&) { trace += "B"; }, 1);
+
+    // both tasks fit in the budget but run on alternate cycles
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        scheduler.cycle(error);
+        trace += "|";
+    }
+    ASSERT_EQ("A|B|A|B|", trace);
+}
+
+TEST_F(SchedulerTest, acyclic_fills_cyclic_frame)
+{
+    Scheduler scheduler(bus, MAX_ETHERCAT_PAYLOAD_SIZE);
+
+    int32_t nops = 0;
+    scheduler.addTask(1, datagram_size(1), [&](Scheduler::Error const& err) { bus.sendNop(err); ++nops; });
+    scheduler.addTask(1, datagram_size(1), [&](Scheduler::Error const& err) { bus.sendNop(err); ++nops; });
+
+    // both tasks share one frame
+    std::vector<DatagramCheck<uint8_t>> expecteds(2, {Command::NOP, 0, false});
+    io_nominal->checkSendFrame(expecteds);
+    io_nominal->handleReply<uint8_t>({0, 0}, 0);
+    scheduler.cycle(error);
+    ASSERT_EQ(2, nops);
+}
+
+
+// Loops every frame back as if one slave answered each datagram
+class LoopbackSocket : public AbstractSocket
+{
+public:
+    void open(std::string const&) override {}
+    void setTimeout(nanoseconds) override {}
+    void close() noexcept override {}
+
+    int32_t write(uint8_t const* data, int32_t data_size) override
+    {
+        Frame frame(data, data_size);
+        while (frame.isDatagramAvailable())
+        {
+            auto [header, payload, wkc] = frame.nextDatagram();
+            uint16_t answer_wkc = 1;
+            std::memcpy(payload + header->len, &answer_wkc, sizeof(answer_wkc));
+        }
+        frames.emplace(frame.data(), frame.data() + data_size);
+        ++written;
+        return data_size;
+    }
+
+    int32_t read(uint8_t* data, int32_t data_size) override
+    {
+        if (frames.empty())
+        {
+            return -1;
+        }
+        int32_t size = std::min(data_size, static_cast<int32_t>(frames.front().size()));
+        std::memcpy(data, frames.front().data(), size);
+        frames.pop();
+        return size;
+    }
+
+    std::queue<std::vector<uint8_t>> frames;
+    int32_t written{0};
+};
+
+TEST(Scheduler, configured_domains_share_cyclic_frames)
+{
+    auto socket = std::make_shared<LoopbackSocket>();
+    auto link = std::make_shared<Link>(socket);
+    link->configureDomains({64, 64, 64, 64});
+    Bus bus{ link };
+    for (uint16_t i = 0; i < 2; ++i)
+    {
+        Slave slave;
+        slave.address = static_cast<uint16_t>(0x1001 + i);
+        slave.supported_mailbox = eeprom::MailboxProtocol::CoE;
+        bus.slaves().push_back(slave);
+    }
+
+    // tasks writing in the user, mailbox and diagnostics domains, on distinct cycles
+    auto error = [](DatagramState const&) {};
+    Scheduler scheduler(bus, MAX_ETHERCAT_PAYLOAD_SIZE);
+    int32_t const nop = datagram_size(1);
+    int32_t const checks = 2 * datagram_size(1);
+    int32_t const counters = 2 * datagram_size(sizeof(ErrorCounters));
+    scheduler.addTask(2, nop,      [&](Scheduler::Error const& err) { bus.sendNop(err); });
+    scheduler.addTask(2, checks,   [&](Scheduler::Error const& err) { bus.sendMailboxesReadChecks(err); }, 1);
+    scheduler.addTask(3, counters, [&](Scheduler::Error const& err) { bus.sendRefreshErrorCounters(err); });
+
+    // whatever the tasks run in a cycle, the frame count stays the same
+    for (int32_t i = 0; i < 6; ++i)
+    {
+        int32_t written = socket->written;
+        scheduler.cycle(error);
+        ASSERT_EQ(written + 1, socket->written);
+    }
+}
@@ -98,3 +98,30 @@ TEST(Slave, countOpenPorts)
         ASSERT_EQ((n & mask0) + ((n & mask1) >> 1) + ((n & mask2) >> 2) + ((n & mask3) >> 3), slave.countOpenPorts());
     }
 }
+
+
+TEST(Slave, bit_accessors)
+{
+    uint8_t data[2] = {0, 0};
+
+    // two mappings sharing the first byte, one crossing bytes
+    Slave::PIMapping a{};
+    a.data = data;
+    a.bit_offset = 0;
+    Slave::PIMapping b{};
+    b.data = data;
+    b.bit_offset = 5;
+
+    a.setBits(0, 4, 0xA);
+    b.setBits(0, 6, 0x2F);
+    ASSERT_EQ(0xEA, data[0]);
+    ASSERT_EQ(0x05, data[1]);
+
+    ASSERT_EQ(0xA,  a.getBits(0, 4));
+    ASSERT_EQ(0x2F, b.getBits(0, 6));
+    ASSERT_TRUE(b.getBit(5));
+
+    b.setBit(0, false);
+    ASSERT_EQ(0xCA, data[0]);
+    ASSERT_EQ(0xA,  a.getBits(0, 4));
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "kickcat/SpscRing.h"
+
+using namespace kickcat;
+
+TEST(SpscRing, invalid_capacity)
+{
+    ASSERT_THROW(SpscRing<int>(0), Error);
+    ASSERT_THROW(SpscRing<int>(3), Error);
+}
+
+TEST(SpscRing, produce_consume)
+{
+    SpscRing<int> ring(4);
+    ASSERT_EQ(4, ring.capacity());
+    ASSERT_EQ(nullptr, ring.consume());
+
+    for (int i = 0; i < 4; ++i)
+    {
+        int* slot = ring.produce();
+        ASSERT_NE(nullptr, slot);
+        *slot = i;
+        ring.commit();
+    }
+    ASSERT_EQ(4, ring.size());
+    ASSERT_EQ(nullptr, ring.produce()); // full
+
+    for (int i = 0; i < 4; ++i)
+    {
+        int* slot = ring.consume();
+        ASSERT_NE(nullptr, slot);
+        ASSERT_EQ(i, *slot);
+        ring.release();
+    }
+    ASSERT_EQ(0, ring.size());
+    ASSERT_EQ(nullptr, ring.consume());
+}
+
+TEST(SpscRing, threads)
+{
+    constexpr int64_t ELEMENTS = 100000;
+    SpscRing<int64_t> ring(16);
+
+    std::thread producer([&]()
+    {
+        for (int64_t i = 0; i < ELEMENTS; ++i)
+        {
+            int64_t* slot;
+            while ((slot = ring.produce()) == nullptr)
+            {
+                std::this_thread::yield();
+            }
+            *slot = i;
+            ring.commit();
+        }
+    });
+
+    int64_t expected = 0;
+    while (expected < ELEMENTS)
+    {
+        int64_t* slot = ring.consume();
+        if (slot == nullptr)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(expected, *slot);
+        ring.release();
+        ++expected;
+    }
+    producer.join();
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "kickcat/TripleBuffer.h"
+
+using namespace kickcat;
+
+TEST(TripleBuffer, commit_acquire)
+{
+    uint8_t init[4] = {1, 2, 3, 4};
+    TripleBuffer buffer(sizeof(init), init);
+    ASSERT_EQ(4, buffer.size());
+    ASSERT_EQ(0, buffer.generation());
+    ASSERT_FALSE(buffer.acquire());
+    ASSERT_EQ(0, std::memcmp(init, buffer.front(), sizeof(init)));
+
+    // the back buffer starts from the last commit
+    ASSERT_EQ(0, std::memcmp(init, buffer.back(), sizeof(init)));
+    buffer.back()[0] = 10;
+    ASSERT_EQ(1, buffer.commit());
+    ASSERT_EQ(10, buffer.back()[0]);
+    buffer.back()[1] = 20;
+    ASSERT_EQ(2, buffer.commit());
+
+    // only the last commit is seen, once
+    ASSERT_TRUE(buffer.acquire());
+    ASSERT_EQ(2, buffer.generation());
+    ASSERT_EQ(10, buffer.front()[0]);
+    ASSERT_EQ(20, buffer.front()[1]);
+    ASSERT_EQ(3,  buffer.front()[2]);
+    ASSERT_FALSE(buffer.acquire());
+
+    // writing the back buffer does not change the front one
+    buffer.back()[2] = 30;
+    ASSERT_EQ(3, buffer.front()[2]);
+}
+
+TEST(TripleBuffer, threads)
+{
+    constexpr uint64_t COMMITS = 100000;
+    TripleBuffer buffer(sizeof(uint64_t) * 8);
+
+    std::thread writer([&]()
+    {
+        for (uint64_t i = 1; i <= COMMITS; ++i)
+        {
+            uint64_t* values = reinterpret_cast<uint64_t*>(buffer.back());
+            for (int32_t j = 0; j < 8; ++j)
+            {
+                values[j] = i;
+            }
+            buffer.commit();
+        }
+    });
+
+    uint64_t last = 0;
+    while (last != COMMITS)
+    {
+        if (not buffer.acquire())
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // never a partially written buffer, never an older one
+        uint64_t const* values = reinterpret_cast<uint64_t const*>(buffer.front());
+        for (int32_t j = 0; j < 8; ++j)
+        {
+            ASSERT_EQ(values[0], values[j]);
+        }
+        ASSERT_LT(last, values[0]);
+        ASSERT_EQ(values[0], buffer.generation());
+        last = values[0];
+    }
+    writer.join();
+}